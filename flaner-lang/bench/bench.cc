@@ -0,0 +1,582 @@
+#include "corpus.hh"
+#include "scripts.hh"
+#include <lexer.hh>
+#include <stream.hh>
+#include <incremental.hh>
+#include <arena.hh>
+#include <parser.hh>
+#include <compiler.hh>
+#include <vm.hh>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <random>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// 统计全局 operator new 的调用次数，算出每个 token 分配了几次内存。
+// std::pmr 的 new_delete_resource 走带 align_val_t 的重载，所以对齐、nothrow 和数组的版本都要替换
+static std::atomic<uint64_t> allocations{ 0 };
+
+static void* countedAllocate(size_t size) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+static void* countedAllocate(size_t size, std::align_val_t alignment) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    size = size ? (size + align - 1) / align * align : align;
+#ifdef _WIN32
+    return _aligned_malloc(size, align);
+#else
+    return std::aligned_alloc(align, size);
+#endif
+}
+
+static void countedFree(void* p, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(size_t size)
+{
+    if (void* p = countedAllocate(size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (void* p = countedAllocate(size, alignment))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocate(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocate(size, alignment); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t alignment) noexcept { countedFree(p, alignment); }
+void operator delete[](void* p, std::align_val_t alignment) noexcept { countedFree(p, alignment); }
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept { countedFree(p, alignment); }
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept { countedFree(p, alignment); }
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { countedFree(p, alignment); }
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { countedFree(p, alignment); }
+
+namespace flaner
+{
+namespace bench
+{
+    // 进程的峰值常驻内存，单位字节
+    static uint64_t peakResident()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.PeakWorkingSetSize;
+#elif defined(__linux__)
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmHWM:") == 0)
+            {
+                return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+            }
+        }
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+    }
+
+    // 让每种语料的峰值单独统计；只有 Linux 支持清零，其他平台报告的是到目前为止的峰值
+    static void resetPeakResident()
+    {
+#if defined(__linux__)
+        std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+    }
+
+    struct Options
+    {
+        size_t bytes = size_t(16) << 20;
+        unsigned repeat = 5;
+        uint64_t seed = 1;
+        std::string only;
+        std::string saveTo;
+        // 从反复 reset 的 Arena 分配 token，与默认的 new/delete 对比
+        bool arena = false;
+        // 词法分析之后再做语法分析，单独计时
+        bool parse = false;
+        // 不测词法分析，改为编译并运行 scripts() 中的小程序
+        bool vm = false;
+        // 只检查 StreamLexer 遇到开头的错误时不会读完整个输入
+        bool checkStream = false;
+        // 不测整体的词法分析，改为测 IncrementalLexer 每次编辑的耗时
+        bool incremental = false;
+        // 编译只有一行的长表达式，每项的耗时不应随行长增长
+        bool longLine = false;
+    };
+
+    static void usage()
+    {
+        std::printf("usage: flaner-bench [--size MB] [--repeat N] [--seed S] [--corpus NAME] [--save DIR] [--arena] [--parse]\n"
+            "       flaner-bench --vm [--repeat N] [--corpus NAME]\n"
+            "       flaner-bench --check-stream [--size MB]\n"
+            "       flaner-bench --incremental [--size MB] [--repeat N] [--seed S] [--corpus NAME]\n"
+            "       flaner-bench --long-line [--repeat N]\n");
+        for (const auto& c : corpora())
+        {
+            std::printf("  %-12s %s\n", c.name, c.description);
+        }
+        for (const auto& s : scripts())
+        {
+            std::printf("  %-12s %s (--vm)\n", s.name, s.description);
+        }
+    }
+
+    static int runScripts(const Options& options)
+    {
+        using clock = std::chrono::steady_clock;
+
+        std::printf("%-12s %12s %12s %12s %10s  %s\n", "script", "iterations", "compile ms", "run ms", "ns/iter", "result");
+        for (const auto& script : scripts())
+        {
+            if (!options.only.empty() && options.only != script.name)
+            {
+                continue;
+            }
+
+            std::string text = "const n = " + std::to_string(script.iterations) + ";\n" + script.source;
+            double bestCompile = 1e300;
+            double bestRun = 1e300;
+            std::string result;
+            try
+            {
+                lexer::Lexer lexer{ lexer::io::Source(lexer::io::Buffer::borrow(text.data(), text.size())) };
+                parser::Ast ast(lexer);
+                parser::Parser(lexer, ast).parseProgram();
+                for (unsigned i = 0; i < options.repeat; ++i)
+                {
+                    vm::VM machine;
+                    auto start = clock::now();
+                    vm::Program program = vm::Compiler(ast, machine.globalNames()).compile();
+                    auto compiled = clock::now();
+                    vm::Value value = machine.run(program);
+                    auto finished = clock::now();
+                    bestCompile = std::min(bestCompile, std::chrono::duration<double>(compiled - start).count());
+                    bestRun = std::min(bestRun, std::chrono::duration<double>(finished - compiled).count());
+                    result = vm::toString(value);
+                }
+            }
+            catch (const parser::Parser::ParseError& e)
+            {
+                std::printf("%-12s %s\n", script.name, e.info.c_str());
+                return 1;
+            }
+            catch (const vm::Compiler::CompileError& e)
+            {
+                std::printf("%-12s %s\n", script.name, e.info.c_str());
+                return 1;
+            }
+            catch (const vm::VM::RuntimeError& e)
+            {
+                std::printf("%-12s %s (line %zu)\n", script.name, e.info.c_str(), e.line);
+                return 1;
+            }
+
+            std::printf("%-12s %12u %12.3f %12.1f %10.2f  %s\n",
+                script.name, script.iterations, bestCompile * 1000, bestRun * 1000,
+                bestRun * 1e9 / script.iterations, result.c_str());
+        }
+        return 0;
+    }
+
+    // return 1 + 1 + ... + 1; 写在同一行，项数从 25k 到 400k。
+    // 编译器为每个语句和调用记行号，若连列号一起查，每次都要从行首数到结点，整体会变成平方
+    static int runLongLine(const Options& options)
+    {
+        using clock = std::chrono::steady_clock;
+
+        std::printf("%-10s %12s %12s %12s  %s\n", "terms", "parse ms", "compile ms", "ns/term", "result");
+        for (size_t terms : { 25000, 100000, 400000 })
+        {
+            std::string text = "return 1";
+            for (size_t i = 1; i < terms; ++i)
+            {
+                text += " + 1";
+            }
+            text += ";\n";
+
+            double bestParse = 1e300;
+            double bestCompile = 1e300;
+            std::string result;
+            try
+            {
+                for (unsigned i = 0; i < options.repeat; ++i)
+                {
+                    lexer::Lexer lexer{ lexer::io::Source(lexer::io::Buffer::borrow(text.data(), text.size())) };
+                    auto start = clock::now();
+                    parser::Ast ast(lexer);
+                    parser::Parser(lexer, ast).parseProgram();
+                    auto parsed = clock::now();
+                    vm::VM machine;
+                    vm::Program program = vm::Compiler(ast, machine.globalNames()).compile();
+                    auto compiled = clock::now();
+                    bestParse = std::min(bestParse, std::chrono::duration<double>(parsed - start).count());
+                    bestCompile = std::min(bestCompile, std::chrono::duration<double>(compiled - parsed).count());
+                    result = vm::toString(machine.run(program));
+                }
+            }
+            catch (const parser::Parser::ParseError& e)
+            {
+                std::printf("%-10zu %s\n", terms, e.info.c_str());
+                return 1;
+            }
+            catch (const vm::Compiler::CompileError& e)
+            {
+                std::printf("%-10zu %s\n", terms, e.info.c_str());
+                return 1;
+            }
+            catch (const vm::VM::RuntimeError& e)
+            {
+                std::printf("%-10zu %s (line %zu)\n", terms, e.info.c_str(), e.line);
+                return 1;
+            }
+
+            std::printf("%-10zu %12.3f %12.3f %12.1f  %s\n",
+                terms, bestParse * 1000, bestCompile * 1000, bestCompile * 1e9 / terms, result.c_str());
+            if (result != std::to_string(terms))
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // 第一行是没有结束的字符串，之后是 options.bytes 字节的合法源码。
+    // StreamLexer 应当立即报错，读入的字节数只有窗口大小的量级，而不是把整个输入读进窗口
+    static int checkStream(const Options& options)
+    {
+        std::FILE* file = std::tmpfile();
+        if (!file)
+        {
+            std::printf("check-stream: cannot create a temporary file\n");
+            return 1;
+        }
+        std::string text = "'unterminated\n" + corpora().front().generate(options.bytes, options.seed);
+        std::fwrite(text.data(), 1, text.size(), file);
+        std::rewind(file);
+
+        lexer::StreamLexer::Options streamOptions;
+        bool failed = false;
+        try
+        {
+            lexer::StreamLexer stream(file, streamOptions);
+            stream.next();
+        }
+        catch (const lexer::Lexer::LexError& e)
+        {
+            failed = e.line == 1;
+        }
+        long consumed = std::ftell(file);
+        std::fclose(file);
+
+        bool bounded = consumed >= 0 && static_cast<size_t>(consumed) <= 4 * streamOptions.window;
+        std::printf("check-stream: %s, read %ld of %zu bytes\n",
+            failed && bounded ? "ok" : failed ? "read too much" : "no error on line 1", consumed, text.size());
+        return failed && bounded ? 0 : 1;
+    }
+
+    // 对 1/16、1/4 和全部大小的同一种语料做同样的编辑：在随机的行首逐个字符地敲入一行，再逐个删掉。
+    // 光标换到新位置后的第一次编辑要把间隙移过去，耗时与移动的距离成正比，单独计时；
+    // 之后的每次按键只重新分析附近的几个 token，耗时不应随文件变大而增长
+    static int runIncremental(const Options& options)
+    {
+        using namespace flaner::lexer;
+        using clock = std::chrono::steady_clock;
+        constexpr size_t places = 200;
+        const std::string_view typed = "let x = f(1);";
+
+        std::printf("%-12s %10s %12s %12s %12s %12s %14s\n",
+            "corpus", "MB", "tokens", "initial ms", "us/jump", "us/key", "relexed/key");
+        for (const auto& corpus : corpora())
+        {
+            if (options.only.empty() ? std::strcmp(corpus.name, "programs") != 0 : options.only != corpus.name)
+            {
+                continue;
+            }
+            for (size_t bytes : { options.bytes / 16, options.bytes / 4, options.bytes })
+            {
+                std::string text = corpus.generate(bytes, options.seed);
+                std::vector<size_t> lineStarts;
+                for (size_t i = 0; i < text.size(); ++i)
+                {
+                    if (text[i] == '\n')
+                    {
+                        lineStarts.push_back(i + 1);
+                    }
+                }
+                std::mt19937_64 random(options.seed);
+                std::vector<size_t> at(places);
+                for (size_t& offset : at)
+                {
+                    offset = lineStarts.empty() ? 0 : lineStarts[random() % lineStarts.size()];
+                }
+
+                double initial = 0;
+                double bestJump = 1e300;
+                double bestKey = 1e300;
+                size_t tokens = 0;
+                size_t relexed = 0;
+                try
+                {
+                    for (unsigned r = 0; r < options.repeat; ++r)
+                    {
+                        auto start = clock::now();
+                        IncrementalLexer lexer(text);
+                        initial = std::chrono::duration<double>(clock::now() - start).count();
+                        double jump = 0;
+                        double key = 0;
+                        relexed = 0;
+                        for (size_t offset : at)
+                        {
+                            auto moved = clock::now();
+                            lexer.edit(offset, 0, typed.substr(0, 1));
+                            auto typing = clock::now();
+                            for (size_t i = 1; i < typed.size(); ++i)
+                            {
+                                relexed += lexer.edit(offset + i, 0, typed.substr(i, 1)).inserted;
+                            }
+                            for (size_t i = typed.size(); i > 0; --i)
+                            {
+                                relexed += lexer.edit(offset + i - 1, 1, "").inserted;
+                            }
+                            auto done = clock::now();
+                            jump += std::chrono::duration<double>(typing - moved).count();
+                            key += std::chrono::duration<double>(done - typing).count();
+                        }
+                        bestJump = std::min(bestJump, jump);
+                        bestKey = std::min(bestKey, key);
+                        tokens = lexer.size();
+                    }
+                }
+                catch (const Lexer::LexError& e)
+                {
+                    std::printf("%-12s %s\n", corpus.name, e.info.c_str());
+                    return 1;
+                }
+                size_t keys = places * (typed.size() * 2 - 1);
+                std::printf("%-12s %10.2f %12zu %12.1f %12.2f %12.2f %14.1f\n",
+                    corpus.name, text.size() / 1048576.0, tokens, initial * 1000,
+                    bestJump * 1e6 / places, bestKey * 1e6 / keys, static_cast<double>(relexed) / keys);
+            }
+        }
+        return 0;
+    }
+
+    static int run(const Options& options)
+    {
+        using namespace flaner::lexer;
+        using clock = std::chrono::steady_clock;
+
+        std::printf("%-12s %10s %12s %10s %10s %12s %10s",
+            "corpus", "MB", "tokens", "MB/s", "Mtok/s", "allocs/tok", "peak MB");
+        if (options.parse)
+        {
+            // 不是合法程序的语料（标识符、运算符的堆砌）只计词法分析，语法分析一栏为 -
+            std::printf(" %10s %10s %10s %12s", "parse MB/s", "nodes", "parse/lex", "allocs/node");
+        }
+        std::printf("\n");
+
+        Arena arena;
+        std::pmr::memory_resource* resource = options.arena ? &arena : std::pmr::get_default_resource();
+
+        for (const auto& corpus : corpora())
+        {
+            if (!options.only.empty() && options.only != corpus.name)
+            {
+                continue;
+            }
+
+            std::string text = corpus.generate(options.bytes, options.seed);
+            if (!options.saveTo.empty())
+            {
+                std::ofstream(options.saveTo + "/" + corpus.name + ".fln", std::ios::binary) << text;
+            }
+            resetPeakResident();
+
+            double best = 1e300;
+            double bestParse = 1e300;
+            bool parsed = options.parse;
+            size_t nodes = 0;
+            size_t tokens = 0;
+            uint64_t allocated = 0;
+            uint64_t parseAllocated = 0;
+            for (unsigned i = 0; i < options.repeat; ++i)
+            {
+                uint64_t before = allocations.load();
+                auto start = clock::now();
+                try
+                {
+                    Lexer lexer{ io::Source(io::Buffer::borrow(text.data(), text.size())), resource };
+                    tokens = lexer.getStream().size();
+                    best = std::min(best, std::chrono::duration<double>(clock::now() - start).count());
+                    // 语法分析的分配单独统计，不算进每个 token 的分配次数
+                    allocated = allocations.load() - before;
+
+                    if (parsed)
+                    {
+                        auto parseStart = clock::now();
+                        uint64_t beforeParse = allocations.load();
+                        try
+                        {
+                            parser::Ast ast(lexer, resource);
+                            parser::Parser(lexer, ast).parseProgram();
+                            nodes = ast.size();
+                            parseAllocated = allocations.load() - beforeParse;
+                        }
+                        catch (const parser::Parser::ParseError&)
+                        {
+                            parsed = false;
+                        }
+                        bestParse = std::min(bestParse, std::chrono::duration<double>(clock::now() - parseStart).count());
+                    }
+                }
+                catch (const Lexer::LexError& e)
+                {
+                    std::printf("%-12s %s\n", corpus.name, e.info.c_str());
+                    return 1;
+                }
+                arena.reset();
+            }
+
+            double megabytes = text.size() / 1048576.0;
+            std::printf("%-12s %10.2f %12zu %10.1f %10.2f %12.4f %10.1f",
+                corpus.name, megabytes, tokens,
+                megabytes / best, tokens / best / 1e6,
+                tokens ? static_cast<double>(allocated) / tokens : 0.0,
+                peakResident() / 1048576.0);
+            if (parsed)
+            {
+                std::printf(" %10.1f %10zu %10.2f %12.4f", megabytes / bestParse, nodes, bestParse / best,
+                    nodes ? static_cast<double>(parseAllocated) / nodes : 0.0);
+            }
+            else if (options.parse)
+            {
+                std::printf(" %10s %10s %10s %12s", "-", "-", "-", "-");
+            }
+            std::printf("\n");
+        }
+        return 0;
+    }
+}
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace flaner::bench;
+
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue)
+        {
+            options.bytes = static_cast<size_t>(std::atof(argv[++i]) * 1048576);
+        }
+        else if (arg == "--repeat" && hasValue)
+        {
+            options.repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--corpus" && hasValue)
+        {
+            options.only = argv[++i];
+        }
+        else if (arg == "--save" && hasValue)
+        {
+            options.saveTo = argv[++i];
+        }
+        else if (arg == "--arena")
+        {
+            options.arena = true;
+        }
+        else if (arg == "--parse")
+        {
+            options.parse = true;
+        }
+        else if (arg == "--vm")
+        {
+            options.vm = true;
+        }
+        else if (arg == "--check-stream")
+        {
+            options.checkStream = true;
+        }
+        else if (arg == "--incremental")
+        {
+            options.incremental = true;
+        }
+        else if (arg == "--long-line")
+        {
+            options.longLine = true;
+        }
+        else
+        {
+            usage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+    if (options.checkStream)
+    {
+        return checkStream(options);
+    }
+    if (options.incremental)
+    {
+        return runIncremental(options);
+    }
+    if (options.longLine)
+    {
+        return runLongLine(options);
+    }
+    return options.vm ? runScripts(options) : run(options);
+}
@@ -0,0 +1,367 @@
+#include "corpus.hh"
+
+namespace flaner
+{
+namespace bench
+{
+    // 不用 <random> 的分布：各标准库的实现不同，生成的内容会随平台变化
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+        uint64_t next()
+        {
+            // splitmix64
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+        size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+        template <size_t N>
+        const char* pick(const char* const (&items)[N]) { return items[below(N)]; }
+
+    private:
+        uint64_t state;
+    };
+
+    static void identifier(std::string& out, Random& r)
+    {
+        static const char head[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_$";
+        static const char tail[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+        size_t n = 1 + r.below(12);
+        out += head[r.below(sizeof(head) - 1)];
+        for (size_t i = 1; i < n; ++i)
+        {
+            out += tail[r.below(sizeof(tail) - 1)];
+        }
+    }
+
+    static void number(std::string& out, Random& r)
+    {
+        auto digits = [&](size_t max) {
+            size_t n = 1 + r.below(max);
+            for (size_t i = 0; i < n; ++i)
+            {
+                out += static_cast<char>('0' + r.below(10));
+            }
+        };
+        switch (r.below(5))
+        {
+        case 0: digits(9); break;
+        case 1: digits(4); out += '.'; digits(6); break;
+        case 2: out += '.'; digits(4); break;
+        case 3: digits(2); out += '.'; digits(3); out += 'e'; out += r.below(2) ? '+' : '-'; digits(2); break;
+        default: digits(3); out += 'e'; digits(2); break;
+        }
+    }
+
+    static std::string identifiers(size_t bytes, uint64_t seed)
+    {
+        static const char* const keywords[] = {
+            "let", "const", "if", "else", "while", "for", "in", "of", "return",
+            "break", "continue", "true", "false", "none", "class", "yield", "import", "export",
+        };
+        Random r(seed);
+        std::string out;
+        out.reserve(bytes + 64);
+        while (out.size() < bytes)
+        {
+            size_t words = 3 + r.below(6);
+            for (size_t i = 0; i < words; ++i)
+            {
+                if (r.below(3) == 0)
+                {
+                    out += r.pick(keywords);
+                }
+                else
+                {
+                    identifier(out, r);
+                }
+                out += r.below(4) == 0 ? ", " : " ";
+            }
+            out += ";\n";
+        }
+        return out;
+    }
+
+    static std::string numbers(size_t bytes, uint64_t seed)
+    {
+        Random r(seed);
+        std::string out;
+        out.reserve(bytes + 64);
+        while (out.size() < bytes)
+        {
+            out += "let ";
+            identifier(out, r);
+            out += " = [";
+            size_t n = 4 + r.below(8);
+            for (size_t i = 0; i < n; ++i)
+            {
+                number(out, r);
+                out += i + 1 < n ? ", " : "];\n";
+            }
+        }
+        return out;
+    }
+
+    static std::string strings(size_t bytes, uint64_t seed)
+    {
+        static const char* const escapes[] = { "\\n", "\\t", "\\\\", "\\\"", "\\'", "\\r", "\\b" };
+        static const char* const words[] = { "hello", "world", "flaner", "lexer", "string", "escape", "value" };
+        Random r(seed);
+        std::string out;
+        out.reserve(bytes + 128);
+        while (out.size() < bytes)
+        {
+            char mark = r.below(2) ? '"' : '\'';
+            out += "let ";
+            identifier(out, r);
+            out += " = ";
+            out += mark;
+            size_t n = 2 + r.below(10);
+            for (size_t i = 0; i < n; ++i)
+            {
+                out += r.below(3) == 0 ? r.pick(escapes) : r.pick(words);
+                out += ' ';
+            }
+            out += mark;
+            out += ";\n";
+        }
+        return out;
+    }
+
+    static void templateString(std::string& out, Random& r, size_t depth)
+    {
+        static const char* const words[] = { "Hello", "world", "value", "of", "x", "is" };
+        out += '`';
+        size_t parts = 1 + r.below(3);
+        for (size_t i = 0; i < parts; ++i)
+        {
+            out += r.pick(words);
+            out += " ${ ";
+            if (depth > 0 && r.below(2))
+            {
+                templateString(out, r, depth - 1);
+            }
+            else
+            {
+                identifier(out, r);
+                out += " + ";
+                number(out, r);
+            }
+            out += " } ";
+        }
+        out += r.pick(words);
+        out += '`';
+    }
+
+    static std::string templates(size_t bytes, uint64_t seed)
+    {
+        Random r(seed);
+        std::string out;
+        out.reserve(bytes + 256);
+        while (out.size() < bytes)
+        {
+            out += "let ";
+            identifier(out, r);
+            out += " = ";
+            templateString(out, r, 1 + r.below(4));
+            out += ";\n";
+        }
+        return out;
+    }
+
+    static std::string operators(size_t bytes, uint64_t seed)
+    {
+        static const char* const ops[] = {
+            "+", "-", "**", "/", "//", "%%", "+=", "-=", "**=", "/=", "%%=", "<<", ">>", "<<=", ">>=",
+            "==", "<=", ">=", "<", ">", "&&", "||", "=>", "...", "..", ".", "?", ":", "=",
+        };
+        Random r(seed);
+        std::string out;
+        out.reserve(bytes + 64);
+        while (out.size() < bytes)
+        {
+            identifier(out, r);
+            size_t n = 2 + r.below(8);
+            for (size_t i = 0; i < n; ++i)
+            {
+                out += ' ';
+                out += r.pick(ops);
+                out += ' ';
+                if (r.below(4) == 0)
+                {
+                    out += r.below(2) ? "(" : "[";
+                    identifier(out, r);
+                    out += r.below(2) ? ")" : "]";
+                }
+                else
+                {
+                    identifier(out, r);
+                }
+            }
+            out += ";\n";
+        }
+        return out;
+    }
+
+    // 不会与关键字相同的标识符，供需要通过语法分析的语料使用
+    static void name(std::string& out, Random& r)
+    {
+        static const char* const reserved[] = {
+            "none", "true", "false", "if", "else", "switch", "case", "default", "while", "do", "for", "in", "of",
+            "break", "continue", "throw", "return", "yield", "const", "let", "class", "import", "export", "as", "from",
+        };
+        size_t start = out.size();
+        identifier(out, r);
+        for (const char* word : reserved)
+        {
+            if (out.compare(start, std::string::npos, word) == 0)
+            {
+                out += '_';
+                break;
+            }
+        }
+    }
+
+    // 能通过语法分析的程序：函数、条件、循环和各级优先级的表达式
+    static void expression(std::string& out, Random& r, size_t depth)
+    {
+        static const char* const ops[] = {
+            "+", "-", "*", "/", "//", "%", "**", "<<", ">>", "==", "!=", "<", "<=", "&&", "||", "&", "|", "^",
+        };
+        switch (depth == 0 ? r.below(2) : r.below(7))
+        {
+        case 0: name(out, r); break;
+        case 1: number(out, r); break;
+        case 2:
+            expression(out, r, depth - 1);
+            out += ' ';
+            out += r.pick(ops);
+            out += ' ';
+            expression(out, r, depth - 1);
+            break;
+        case 3:
+            out += '(';
+            expression(out, r, depth - 1);
+            out += ')';
+            break;
+        case 4:
+        {
+            name(out, r);
+            out += '(';
+            size_t n = r.below(4);
+            for (size_t i = 0; i < n; ++i)
+            {
+                expression(out, r, depth - 1);
+                out += i + 1 < n ? ", " : "";
+            }
+            out += ')';
+            break;
+        }
+        case 5:
+            name(out, r);
+            if (r.below(2))
+            {
+                out += '.';
+                name(out, r);
+            }
+            else
+            {
+                out += '[';
+                expression(out, r, depth - 1);
+                out += ']';
+            }
+            break;
+        default:
+            expression(out, r, depth - 1);
+            out += " ? ";
+            expression(out, r, depth - 1);
+            out += " : ";
+            expression(out, r, depth - 1);
+            break;
+        }
+    }
+
+    static std::string programs(size_t bytes, uint64_t seed)
+    {
+        Random r(seed);
+        std::string out;
+        out.reserve(bytes + 1024);
+        while (out.size() < bytes)
+        {
+            out += "const ";
+            name(out, r);
+            out += " = (";
+            name(out, r);
+            out += ", ";
+            name(out, r);
+            out += " = ";
+            number(out, r);
+            out += ") => {\n";
+            size_t n = 2 + r.below(6);
+            for (size_t i = 0; i < n; ++i)
+            {
+                switch (r.below(4))
+                {
+                case 0:
+                    out += "    let ";
+                    name(out, r);
+                    out += " = ";
+                    expression(out, r, 3);
+                    out += '\n';
+                    break;
+                case 1:
+                    out += "    if (";
+                    expression(out, r, 2);
+                    out += ") {\n        ";
+                    name(out, r);
+                    out += " += ";
+                    expression(out, r, 2);
+                    out += "\n    } else {\n        return ";
+                    expression(out, r, 2);
+                    out += "\n    }\n";
+                    break;
+                case 2:
+                    out += "    for (let ";
+                    name(out, r);
+                    out += " of ";
+                    name(out, r);
+                    out += ") {\n        ";
+                    expression(out, r, 3);
+                    out += ";\n    }\n";
+                    break;
+                default:
+                    out += "    while (";
+                    expression(out, r, 2);
+                    out += ") ";
+                    name(out, r);
+                    out += " = ";
+                    expression(out, r, 2);
+                    out += '\n';
+                    break;
+                }
+            }
+            out += "    return ";
+            expression(out, r, 3);
+            out += "\n}\n";
+        }
+        return out;
+    }
+
+    const std::vector<Corpus>& corpora()
+    {
+        static const std::vector<Corpus> all = {
+            { "identifiers", "identifiers and keywords", identifiers },
+            { "numbers", "numeric literals (1.5e+10, .5)", numbers },
+            { "strings", "quoted strings with escapes", strings },
+            { "templates", "nested template strings", templates },
+            { "operators", "operator soup (**=, %%=, ..., =>)", operators },
+            { "programs", "functions, loops and nested expressions", programs },
+        };
+        return all;
+    }
+}
+}
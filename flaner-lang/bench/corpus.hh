@@ -0,0 +1,24 @@
+#ifndef _FLANER_BENCH_CORPUS_HH_
+#define _FLANER_BENCH_CORPUS_HH_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flaner
+{
+namespace bench
+{
+    // 每种语料只侧重词法分析器的一条路径，相同的种子和大小总是生成相同的内容
+    struct Corpus
+    {
+        const char* name;
+        const char* description;
+        std::string (*generate)(size_t bytes, uint64_t seed);
+    };
+
+    const std::vector<Corpus>& corpora();
+}
+}
+
+#endif // !_FLANER_BENCH_CORPUS_HH_
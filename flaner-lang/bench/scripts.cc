@@ -0,0 +1,84 @@
+#include "scripts.hh"
+
+namespace flaner
+{
+namespace bench
+{
+    const std::vector<Script>& scripts()
+    {
+        static const std::vector<Script> all = {
+            {
+                "while", "while loop with compound assignment",
+                "let i = 0;\n"
+                "let sum = 0;\n"
+                "while (i < n) { sum += i * 2; i += 1; }\n"
+                "return sum;\n",
+                20000000,
+            },
+            {
+                "range", "for-of over a range with integer operators",
+                "let sum = 0;\n"
+                "for (let i of 0 ... n) { sum += (i // 3) %% 7 + (i << 1 >> 1) - i; }\n"
+                "return sum;\n",
+                20000000,
+            },
+            {
+                "power", "** and // in a loop",
+                "let x = 0;\n"
+                "for (let i of 1 .. n) { x = (x + i ** 2) // 3; }\n"
+                "return x;\n",
+                10000000,
+            },
+            {
+                "ranges", "unspaced ranges, 0..9 is a range rather than 0. and .9",
+                "let sum = 0;\n"
+                "for (let k of 0...n) {\n"
+                "    for (let i of 0..9) { sum += i; }\n"
+                "    for (let j of 1...4) { sum += j * 10; }\n"
+                "}\n"
+                "return sum;\n",
+                1000000,
+            },
+            {
+                "fib", "recursive calls",
+                "let fib = (k) => k < 2 ? k : fib(k - 1) + fib(k - 2);\n"
+                "let total = 0;\n"
+                "for (let i of 0 ... n) { total += fib(20); }\n"
+                "return total;\n",
+                200,
+            },
+            {
+                "closure", "calls through captured variables",
+                "let counter = () => { let c = 0; return (d) => { c += d; return c; }; };\n"
+                "let add = counter();\n"
+                "let last = 0;\n"
+                "for (let i of 0 ... n) { last = add(1); }\n"
+                "return last;\n",
+                5000000,
+            },
+            {
+                "concat", "string building and templates",
+                "let total = 0;\n"
+                "for (let i of 0 ... n) {\n"
+                "    let s = \"\";\n"
+                "    for (let j of 0 ... 20) { s += \"ab\"; }\n"
+                "    total += len(`${s}-${i}`);\n"
+                "}\n"
+                "return total;\n",
+                200000,
+            },
+            {
+                "array", "array push, index and iteration",
+                "let a = [];\n"
+                "for (let i of 0 ... n) { push(a, i); }\n"
+                "let sum = 0;\n"
+                "for (let v of a) { sum += v; }\n"
+                "for (let i of 0 ... n) { a[i] = a[i] + 1; }\n"
+                "return sum + a[n - 1];\n",
+                2000000,
+            },
+        };
+        return all;
+    }
+}
+}
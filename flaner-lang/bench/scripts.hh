@@ -0,0 +1,24 @@
+#ifndef _FLANER_BENCH_SCRIPTS_HH_
+#define _FLANER_BENCH_SCRIPTS_HH_
+
+#include <vector>
+
+namespace flaner
+{
+namespace bench
+{
+    // 测量 VM 的小程序。运行前在 source 之前加上 const n = iterations;，
+    // 顶层 return 的值作为结果打印出来，用来核对不同的分发方式算出的结果相同
+    struct Script
+    {
+        const char* name;
+        const char* description;
+        const char* source;
+        unsigned iterations;
+    };
+
+    const std::vector<Script>& scripts();
+}
+}
+
+#endif // !_FLANER_BENCH_SCRIPTS_HH_
@@ -0,0 +1,63 @@
+#ifndef _FLANER_LEXER_ARENA_HH_
+#define _FLANER_LEXER_ARENA_HH_
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 单线程的指针碰撞分配器。
+    // deallocate 只在释放的恰好是最近一次分配时收回空间，其余情况什么也不做；
+    // 从中分配的 token、payload 等随 reset() 或析构一次性释放。
+    // reset() 保留已申请的内存块，连续分析多个文件时不再向上游申请内存
+    class Arena : public std::pmr::memory_resource
+    {
+    public:
+        explicit Arena(size_t blockSize = size_t(1) << 20,
+            std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        ~Arena();
+
+        // 所有从此分配的对象必须已经销毁
+        void reset();
+        // 同 reset()，并把内存块还给上游
+        void release();
+
+        // 已分配出去的字节数与向上游申请的字节数
+        size_t used() const;
+        size_t reserved() const;
+
+    private:
+        struct Block
+        {
+            char* data;
+            size_t size;
+        };
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        // 切换到能容纳 bytes 字节的下一个内存块
+        void advance(size_t bytes, size_t alignment);
+
+        std::pmr::memory_resource* upstream;
+        size_t blockSize;
+        std::vector<Block> blocks;
+        // 当前块的下标及其中未分配部分
+        size_t current;
+        char* top;
+        char* limit;
+        // 当前块之前各块已用的字节数
+        size_t usedBefore;
+        // 最近一次分配的起点，用于收回
+        void* last;
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_ARENA_HH_
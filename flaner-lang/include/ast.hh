@@ -0,0 +1,180 @@
+#ifndef _FLANER_PARSER_AST_HH_
+#define _FLANER_PARSER_AST_HH_
+
+#include <lexer.hh>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+
+namespace flaner
+{
+namespace parser
+{
+    using lexer::TokenType;
+    using lexer::TokenView;
+
+    // 结点的种类。注释中列出各子结点的含义：a、b、c 之外，
+    // 「列表」指从该子结点开始、经 next 串起来的一串结点
+    enum class NodeKind : uint8_t
+    {
+        None,
+
+        // token：标识符
+        Identifier,
+        // token：NUMBER、BIGINT 或 RATIONAL
+        Number,
+        // token：字符串字面量，或模板字符串的一段
+        String,
+        // token：true、false 或 none
+        Literal,
+        // a：依次是各段 String 和其间的表达式的列表，以 String 开始和结束
+        Template,
+        // a：元素列表
+        Array,
+        // a：Property 列表
+        Object,
+        // token：键（标识符、字符串或数字）；a：值，简写 { x } 时为空
+        Property,
+        // op：运算符；a：操作数
+        Unary,
+        // op：运算符；a、b：左右操作数。&& 和 || 也在此列，求值时短路
+        Binary,
+        // op：= 或复合赋值运算符；a：被赋值的 Identifier、Member 或 Index；b：值
+        Assign,
+        // a：条件；b、c：两个分支
+        Conditional,
+        // a：被调用的表达式；b：实参列表
+        Call,
+        // a：对象；b：下标
+        Index,
+        // a：对象；token：成员名
+        Member,
+        // a：Parameter 列表；b：函数体，表达式或 Block
+        Arrow,
+        // token：参数名；a：默认值；op 为 ... 时是剩余参数
+        Parameter,
+        // a：被展开的表达式，只出现在数组、实参中
+        Spread,
+        // a：产出的值，可以为空
+        Yield,
+
+        // a：语句列表
+        Program,
+        // a：语句列表
+        Block,
+        // op：let 或 const；a：Declarator 列表
+        Declaration,
+        // token：变量名；a：初始值
+        Declarator,
+        // a：表达式
+        ExpressionStatement,
+        // a：条件；b：then 分支；c：else 分支
+        If,
+        // a：被判断的值；b：Case 列表
+        Switch,
+        // a：case 的值，default 时为空；b：语句列表
+        Case,
+        // a：条件；b：循环体
+        While,
+        // a：循环体；b：条件
+        DoWhile,
+        // op：let、const，或为空表示不声明新变量；token：循环变量；a：被遍历的值；b：循环体
+        ForIn,
+        ForOf,
+        Break,
+        Continue,
+        // a：返回值，可以为空
+        Return,
+        // a：抛出的值
+        Throw,
+        // token：模块名字符串；a：ImportSpecifier 列表，import "m" 时为空
+        Import,
+        // token：引入的名字；op 为 default 时是默认导出，为 * 时是整个模块；a：别名 Identifier
+        ImportSpecifier,
+        // op 为 default 时 a 是导出的表达式；否则 a 是导出的声明，或 b 是 ExportSpecifier 列表，
+        // 此时 token 是 from 之后的模块名，没有 from 时是 export 本身
+        Export,
+        // token：导出的名字；a：别名 Identifier
+        ExportSpecifier,
+        // token：类名；a：Method 和 Field 列表
+        Class,
+        // token：方法名；a：Parameter 列表；b：Block
+        Method,
+        // token：字段名；a：初始值
+        Field,
+        // 单独的 ;
+        Empty,
+
+        Count,
+    };
+
+    // 结点在 Ast 中的编号，0 表示没有
+    using NodeId = uint32_t;
+    constexpr NodeId none = 0;
+
+    // 24 字节的结点，子结点以编号而不是指针相连，整棵树可以一次释放，也可以原样复制
+    struct Node
+    {
+        NodeKind kind;
+        // 运算符、声明的种类等，没有时为 UNKNOWN
+        TokenType op;
+        // 结点的主 token 在 Lexer 的序列中的下标，用于取出文本和报告位置
+        uint32_t token;
+        NodeId a, b, c;
+        // 列表中的下一个结点
+        NodeId next;
+    };
+
+    // 一棵语法树的全部结点。
+    // 结点按块从 resource（例如一个 Arena）分配，块不随结点增多而搬动；
+    // 树随 Ast 析构或 Arena::reset() 一次性释放。结点的文本引用 lexer，lexer 须比 Ast 活得长
+    class Ast
+    {
+    public:
+        explicit Ast(const lexer::Lexer& lexer, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+        Ast(const Ast&) = delete;
+        Ast& operator=(const Ast&) = delete;
+        ~Ast();
+
+        NodeId add(NodeKind kind, uint32_t token, TokenType op = TokenType::UNKNOWN,
+            NodeId a = none, NodeId b = none, NodeId c = none);
+
+        Node& operator[](NodeId id) { return blocks[id >> blockShift][id & (blockSize - 1)]; }
+        const Node& operator[](NodeId id) const { return blocks[id >> blockShift][id & (blockSize - 1)]; }
+
+        // 结点个数，不含表示没有的 0 号
+        size_t size() const { return count - 1; }
+        size_t memoryUsage() const { return blocks.size() * blockSize * sizeof(Node); }
+        NodeId root() const { return top; }
+        void setRoot(NodeId id) { top = id; }
+
+        const lexer::Lexer& source() const { return lexer; }
+        // 结点的主 token
+        TokenView text(NodeId id) const;
+        lexer::Position position(NodeId id) const;
+        // 结点的主 token 所在的行，不数列
+        size_t line(NodeId id) const;
+
+        static const char* nameOf(NodeKind kind);
+        // 以缩进表示层次，每个结点一行，用于调试和比较。
+        // 超过 maxIndent 层的结点不再加深缩进，而是在行首写出 [深度]
+        void dump(std::string& out, NodeId id) const;
+
+    private:
+        static constexpr size_t blockShift = 12;
+        static constexpr size_t blockSize = size_t(1) << blockShift;
+        static constexpr size_t maxIndent = 64;
+
+        // 只写出 id 本身的一行
+        void dump(std::string& out, NodeId id, size_t depth) const;
+
+        const lexer::Lexer& lexer;
+        std::pmr::memory_resource* resource;
+        std::pmr::vector<Node*> blocks;
+        uint32_t count;
+        NodeId top;
+    };
+}
+}
+
+#endif // !_FLANER_PARSER_AST_HH_
@@ -0,0 +1,42 @@
+#ifndef _FLANER_LEXER_BATCH_HH_
+#define _FLANER_LEXER_BATCH_HH_
+
+#include <lexer.hh>
+#include <pool.hh>
+#include <cache.hh>
+
+namespace flaner
+{
+namespace lexer
+{
+    struct FileError
+    {
+        std::string info;
+        size_t line = 0, column = 0;
+    };
+
+    // 批量词法分析中单个文件的结果
+    struct FileReport
+    {
+        std::string path;
+        size_t bytes = 0;
+        size_t tokens = 0;
+        double seconds = 0;
+
+        bool ok = true;
+        // 出错时的第一个错误；recover 时是全部错误，tokens 仍是完整的个数
+        std::vector<FileError> errors;
+    };
+
+    // 在线程池上并行地分析多个文件，结果的顺序与 paths 一致，与调度无关。
+    // 给出 cache 时先查缓存；给出 interner 时所有文件的标识符和字符串共用它的编号空间；
+    // recover 时每个文件都分析到底，报告其中所有的错误
+    std::vector<FileReport> lexFiles(const std::vector<std::string>& paths, ThreadPool& pool,
+        TokenCache* cache = nullptr, Interner* interner = nullptr, bool recover = false);
+
+    // 读取文件列表，每行一个路径，忽略空行
+    std::vector<std::string> readFileList(const std::string& path);
+}
+}
+
+#endif // !_FLANER_LEXER_BATCH_HH_
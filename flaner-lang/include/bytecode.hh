@@ -0,0 +1,156 @@
+#ifndef _FLANER_VM_BYTECODE_HH_
+#define _FLANER_VM_BYTECODE_HH_
+
+#include <value.hh>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flaner
+{
+namespace vm
+{
+    // 指令为 32 位：低 8 位是操作码，之后依次是 A、B、C 各 8 位；
+    // Bx 是 B、C 合成的 16 位无符号数，sBx 是同样位置的有符号数。
+    // R(x) 是当前函数的第 x 个寄存器，K(x) 是常量，U(x) 是捕获的变量，G(x) 是内建的全局变量。
+    // 标 * 的跳转指令之后跟一个 32 位有符号偏移，相对于偏移之后的下一条指令
+#define FLANER_OPCODES(X) \
+    X(MOVE)      /* R(A) = R(B) */ \
+    X(LOADK)     /* R(A) = K(Bx) */ \
+    X(LOADINT)   /* R(A) = sBx */ \
+    X(LOADBOOL)  /* R(A) = B != 0 */ \
+    X(LOADNONE)  /* R(A) ... R(A+B-1) = none */ \
+    X(GETUPVAL)  /* R(A) = U(B) */ \
+    X(SETUPVAL)  /* U(B) = R(A) */ \
+    X(GETGLOBAL) /* R(A) = G(Bx) */ \
+    X(NEWARRAY)  /* R(A) = [R(B), ..., R(B+C-1)] */ \
+    X(APPEND)    /* R(A) 追加 R(B), ..., R(B+C-1) */ \
+    X(NEWTABLE)  /* R(A) = {} */ \
+    X(GETFIELD)  /* R(A) = R(B)[K(C)] */ \
+    X(SETFIELD)  /* R(A)[K(B)] = R(C) */ \
+    X(GETINDEX)  /* R(A) = R(B)[R(C)] */ \
+    X(SETINDEX)  /* R(A)[R(B)] = R(C) */ \
+    X(ADD)       /* R(A) = R(B) + R(C)，有字符串时拼接 */ \
+    X(SUB)       /* R(A) = R(B) - R(C) */ \
+    X(MUL)       /* R(A) = R(B) * R(C) */ \
+    X(DIV)       /* R(A) = R(B) / R(C) */ \
+    X(INTDIV)    /* R(A) = floor(R(B) / R(C)) */ \
+    X(MOD)       /* R(A) = R(B) % R(C)，符号与被除数相同 */ \
+    X(QUOTE)     /* R(A) = R(B) %% R(C)，符号与除数相同 */ \
+    X(POW)       /* R(A) = R(B) ** R(C) */ \
+    X(SHL)       /* R(A) = R(B) << R(C) */ \
+    X(SHR)       /* R(A) = R(B) >> R(C) */ \
+    X(BAND)      /* R(A) = R(B) & R(C) */ \
+    X(BOR)       /* R(A) = R(B) | R(C) */ \
+    X(BXOR)      /* R(A) = R(B) ^ R(C) */ \
+    X(ADDK)      /* R(A) = R(B) + K(C)，以下至 SHRK 是右操作数为常量的形式 */ \
+    X(SUBK) \
+    X(MULK) \
+    X(DIVK) \
+    X(INTDIVK) \
+    X(MODK) \
+    X(QUOTEK) \
+    X(POWK) \
+    X(SHLK) \
+    X(SHRK) \
+    X(NEG)       /* R(A) = -R(B) */ \
+    X(NOT)       /* R(A) = !R(B) */ \
+    X(BNOT)      /* R(A) = ~R(B) */ \
+    X(TONUMBER)  /* R(A) = +R(B) */ \
+    X(EQ)        /* R(A) = R(B) == R(C) */ \
+    X(NE)        /* R(A) = R(B) != R(C) */ \
+    X(LT)        /* R(A) = R(B) < R(C) */ \
+    X(LE)        /* R(A) = R(B) <= R(C) */ \
+    X(IN)        /* R(A) = R(B) in R(C) */ \
+    X(CONCAT)    /* R(A) = R(B) 到 R(B+C-1) 的文本依次拼接 */ \
+    X(JMP)       /* * 跳转 */ \
+    X(TEST)      /* * R(A) 的真假与 C 相同时跳转 */ \
+    X(TESTNONE)  /* * R(A) 是否为 none 与 C 相同时跳转 */ \
+    X(JEQ)       /* * (R(B) == R(C)) 与 A 相同时跳转，以下同理 */ \
+    X(JLT)       /* * R(B) < R(C) */ \
+    X(JLE)       /* * R(B) <= R(C) */ \
+    X(JEQK)      /* * R(B) == K(C) */ \
+    X(JLTK)      /* * R(B) < K(C) */ \
+    X(JLEK)      /* * R(B) <= K(C) */ \
+    X(JGTK)      /* * R(B) > K(C) */ \
+    X(JGEK)      /* * R(B) >= K(C) */ \
+    X(FORPREP)   /* * 区间 [R(A), R(A+1)) 为空时跳转，否则 R(A+2) = R(A)；C 为 1 时包含 R(A+1) */ \
+    X(FORLOOP)   /* * R(A) 加 1，仍在区间内时 R(A+2) = R(A) 并跳转 */ \
+    X(ITER)      /* * R(A) 的第 R(A+1) 项（C 为 1 时是键）放进 R(A+2)，R(A+1) 加 1；已遍历完时跳转 */ \
+    X(CLOSURE)   /* R(A) = 以第 Bx 个子函数和捕获的变量构造的函数 */ \
+    X(CLOSE)     /* 关闭指向 R(A) 及之后的寄存器的 Upvalue */ \
+    X(CALL)      /* R(A) = R(A)(R(A+1), ..., R(A+B)) */ \
+    X(RETURN)    /* 返回 R(A)，B 为 0 时返回 none */ \
+    X(THROW)     /* 以 R(A) 的文本报告运行时错误 */
+
+    enum class Opcode : uint8_t
+    {
+#define FLANER_OPCODE_ENUM(name) name,
+        FLANER_OPCODES(FLANER_OPCODE_ENUM)
+#undef FLANER_OPCODE_ENUM
+        Count,
+    };
+
+    using Instruction = uint32_t;
+
+    constexpr Instruction encode(Opcode op, uint8_t a, uint8_t b = 0, uint8_t c = 0)
+    {
+        return static_cast<uint32_t>(op) | uint32_t(a) << 8 | uint32_t(b) << 16 | uint32_t(c) << 24;
+    }
+    constexpr Instruction encodeBx(Opcode op, uint8_t a, uint16_t bx)
+    {
+        return static_cast<uint32_t>(op) | uint32_t(a) << 8 | uint32_t(bx) << 16;
+    }
+
+    constexpr Opcode opcodeOf(Instruction i) { return static_cast<Opcode>(i & 0xFF); }
+    constexpr uint32_t argA(Instruction i) { return (i >> 8) & 0xFF; }
+    constexpr uint32_t argB(Instruction i) { return (i >> 16) & 0xFF; }
+    constexpr uint32_t argC(Instruction i) { return i >> 24; }
+    constexpr uint32_t argBx(Instruction i) { return i >> 16; }
+    constexpr int32_t argSBx(Instruction i) { return static_cast<int16_t>(i >> 16); }
+
+    const char* nameOf(Opcode op);
+    // 之后跟着跳转偏移的指令
+    bool isJump(Opcode op);
+
+    // 一个函数编译后的代码
+    struct Proto
+    {
+        // 函数名，来自声明它的变量；顶层代码为 main
+        std::string name;
+        std::vector<Instruction> code;
+        // 每个指令字对应的源码行号
+        std::vector<uint32_t> lines;
+        std::vector<Value> constants;
+        std::vector<std::unique_ptr<Proto>> protos;
+
+        // 构造函数时捕获的变量：local 为真时是外层函数的寄存器 index，否则是外层函数的第 index 个 Upvalue
+        struct Capture
+        {
+            bool local;
+            uint8_t index;
+        };
+        std::vector<Capture> captures;
+
+        // 具名参数的个数，它们在 R(0) 起的寄存器中
+        uint8_t params = 0;
+        // 有剩余参数时，多出的实参组成数组放在 R(params)
+        bool rest = false;
+        // 用到的寄存器数
+        uint8_t registers = 0;
+
+        // 逐条列出指令，子函数跟在后面
+        void disassemble(std::string& out) const;
+    };
+
+    // 一个源文件编译的结果。常量表中的字符串属于它，须比运行它的 VM 活得长
+    struct Program
+    {
+        std::unique_ptr<Proto> main;
+        std::vector<std::unique_ptr<String>> strings;
+    };
+}
+}
+
+#endif // !_FLANER_VM_BYTECODE_HH_
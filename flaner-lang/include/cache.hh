@@ -0,0 +1,63 @@
+#ifndef _FLANER_LEXER_CACHE_HH_
+#define _FLANER_LEXER_CACHE_HH_
+
+#include <lexer.hh>
+#include <atomic>
+#include <mutex>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 源码内容的 64 位哈希，用作缓存的键
+    uint64_t contentHash(const char* data, size_t size);
+
+    // 磁盘上的 token 缓存。
+    // 每个文件按内容哈希和长度存成一个 token 映像，布局与 TokenStream 的各列相同，可以直接映射；
+    // 映像头记录 Lexer::version，版本不同的映像视为不存在。
+    // 写入时先写临时文件再原子地改名，多个进程同时写同一个目录是安全的
+    class TokenCache
+    {
+    public:
+        // capacity 为目录中映像的总字节数上限，超出时删除最久未使用的映像
+        explicit TokenCache(std::string directory, uint64_t capacity = uint64_t(256) << 20);
+        TokenCache(const TokenCache&) = delete;
+
+        // 命中时直接载入 token，否则分析源码并写入缓存。token 从 resource 分配。
+        // 映像中不存 Interner 的编号，载入后按 token 的文本重新驻留。
+        // recover 时以 Lexer::Options::recover 分析，有错误的结果不写入缓存，下次仍会报告
+        Lexer lex(io::Source source, std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+            Interner* interner = nullptr, bool recover = false);
+
+        uint64_t hits() const { return hitCount; }
+        uint64_t misses() const { return missCount; }
+
+    private:
+        struct Header
+        {
+            char magic[4];
+            uint32_t version;
+            uint64_t sourceSize;
+            uint64_t hash;
+            uint64_t count;
+            uint64_t payloadSize;
+            uint64_t reserved;
+        };
+
+        std::string pathOf(uint64_t hash, uint64_t size) const;
+        bool load(const std::string& path, uint64_t hash, Lexer& lexer) const;
+        void store(const std::string& path, uint64_t hash, const Lexer& lexer);
+        void evict();
+
+        std::string directory;
+        uint64_t capacity;
+
+        std::atomic<uint64_t> hitCount, missCount;
+        // 目录中映像的总字节数，只在构造和淘汰时精确统计，其间按写入量累加
+        std::atomic<uint64_t> usage;
+        std::mutex evicting;
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_CACHE_HH_
@@ -0,0 +1,111 @@
+#ifndef _FLANER_LEXER_CHARS_HH_
+#define _FLANER_LEXER_CHARS_HH_
+
+#include <operator.hh>
+#include <cstdint>
+
+namespace flaner
+{
+namespace lexer
+{
+namespace chars
+{
+    // 单个字节的类别，可以同时属于几类
+    enum : uint8_t
+    {
+        // \t \n \v \f \r 和空格
+        Blank = 1,
+        Digit = 2,
+        // [A-Za-z_$]
+        IdentStart = 4,
+        // [A-Za-z0-9_$]
+        IdentPart = 8,
+        // 0x80 及以上，属于某个多字节序列
+        NonAscii = 16,
+    };
+
+    // 以这个字节开头的 token，Lexer::step() 据此分派
+    enum class Start : uint8_t
+    {
+        Unknown,
+        Digit,
+        // 之后是数字时开始数字字面量，否则是运算符
+        Dot,
+        Identifier,
+        Quote,
+        Template,
+        BraceBegin,
+        BraceEnd,
+        Operator,
+        NonAscii,
+    };
+
+    // 256 项的字节类别表，在编译期生成，不受 locale 影响
+    class Table
+    {
+    public:
+        constexpr Table()
+            : classes(), starts()
+        {
+            for (unsigned c = 0; c < 256; ++c)
+            {
+                bool digit = c >= '0' && c <= '9';
+                bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$';
+                if (c == ' ' || (c >= '\t' && c <= '\r'))
+                {
+                    classes[c] |= Blank;
+                }
+                if (digit)
+                {
+                    classes[c] |= Digit | IdentPart;
+                    starts[c] = Start::Digit;
+                }
+                if (letter)
+                {
+                    classes[c] |= IdentStart | IdentPart;
+                    starts[c] = Start::Identifier;
+                }
+                if (c >= 0x80)
+                {
+                    classes[c] |= NonAscii;
+                    starts[c] = Start::NonAscii;
+                }
+            }
+            for (const auto& o : operators)
+            {
+                starts[static_cast<unsigned char>(o.spelling[0])] = Start::Operator;
+            }
+            starts[static_cast<unsigned char>('.')] = Start::Dot;
+            starts[static_cast<unsigned char>('{')] = Start::BraceBegin;
+            starts[static_cast<unsigned char>('}')] = Start::BraceEnd;
+            starts[static_cast<unsigned char>('\'')] = Start::Quote;
+            starts[static_cast<unsigned char>('"')] = Start::Quote;
+            starts[static_cast<unsigned char>('`')] = Start::Template;
+        }
+
+        constexpr uint8_t classOf(char c) const
+        {
+            return classes[static_cast<unsigned char>(c)];
+        }
+
+        constexpr Start startOf(char c) const
+        {
+            return starts[static_cast<unsigned char>(c)];
+        }
+
+    private:
+        uint8_t classes[256];
+        Start starts[256];
+    };
+
+    constexpr Table table{};
+
+    constexpr bool isBlank(char c) { return (table.classOf(c) & Blank) != 0; }
+    constexpr bool isDigit(char c) { return (table.classOf(c) & Digit) != 0; }
+    constexpr bool isIdentStart(char c) { return (table.classOf(c) & IdentStart) != 0; }
+    constexpr bool isIdentPart(char c) { return (table.classOf(c) & IdentPart) != 0; }
+}
+}
+}
+
+#endif // !_FLANER_LEXER_CHARS_HH_
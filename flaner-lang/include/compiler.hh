@@ -0,0 +1,178 @@
+#ifndef _FLANER_VM_COMPILER_HH_
+#define _FLANER_VM_COMPILER_HH_
+
+#include <ast.hh>
+#include <bytecode.hh>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace flaner
+{
+namespace vm
+{
+    // 把 Ast 编译成寄存器式的字节码。
+    // 局部变量固定占用寄存器，表达式的中间结果放在其上的临时寄存器中，按栈的方式分配和释放；
+    // 块中的 let 和 const 在块开始时一并声明，函数可以引用之后声明的变量，也可以递归。
+    // 被内层函数捕获的变量在离开作用域时关闭，循环的每一轮各有一份
+    class Compiler
+    {
+    public:
+        // globals 是 VM 提供的内建变量名，按槽位排列
+        Compiler(const parser::Ast& ast, const std::vector<std::string>& globals);
+        Compiler(const Compiler&) = delete;
+
+        // 编译 ast 的根结点，一个 Program
+        Program compile();
+
+        struct CompileError
+        {
+            std::string info;
+            size_t line, column;
+            CompileError(std::string s, size_t a, size_t b)
+                : info("(from Compiler) " + s),
+                line(a), column(b)
+            {
+            }
+        };
+
+    private:
+        using NodeId = parser::NodeId;
+        using NodeKind = parser::NodeKind;
+        using TokenType = lexer::TokenType;
+        // 待回填的跳转偏移所在的位置
+        using JumpList = std::vector<size_t>;
+
+        static constexpr unsigned maxRegisters = 250;
+        // 表达式的嵌套层数上限，&& 和比较组成的长链也计在内
+        static constexpr unsigned maxDepth = 4000;
+
+        struct Local
+        {
+            // 空名字的变量是编译器使用的隐藏变量，不会被找到
+            std::string_view name;
+            uint8_t reg;
+            unsigned depth;
+            bool isConst;
+            bool captured;
+        };
+
+        // 循环或 switch，break 和 continue 跳到这里
+        struct Loop
+        {
+            bool isSwitch;
+            // 循环中最低的寄存器，其上的变量被捕获时每一轮结束都要关闭
+            uint8_t base;
+            bool captured;
+            JumpList breaks;
+            JumpList continues;
+        };
+
+        struct Function
+        {
+            Function(Function* e, Proto* p) : enclosing(e), proto(p) {}
+
+            Function* enclosing;
+            Proto* proto;
+            std::vector<Local> locals;
+            // 与 proto->captures 一一对应
+            std::vector<std::string_view> captureNames;
+            std::vector<bool> captureConst;
+            std::vector<Loop> loops;
+            unsigned depth = 0;
+            uint8_t freeReg = 0;
+            std::unordered_map<uint64_t, uint32_t> numbers;
+            std::unordered_map<std::string_view, uint32_t> strings;
+        };
+
+        enum class Where
+        {
+            Local,
+            Capture,
+            Global,
+        };
+
+        struct Variable
+        {
+            Where where;
+            uint32_t index;
+            bool isConst;
+        };
+
+        [[noreturn]] void error(NodeId at, const std::string& info);
+        void at(NodeId id);
+        // 进入一层表达式，超过 maxDepth 时报错
+        void nest(NodeId id);
+        std::string_view nameOf(NodeId id) const;
+        TokenType tokenType(NodeId id) const;
+
+        size_t emit(Instruction i);
+        size_t here() const { return fn->proto->code.size(); }
+        // 发出跳转指令和待回填的偏移，返回偏移的位置
+        size_t emitJump(Opcode op, uint8_t a = 0, uint8_t b = 0, uint8_t c = 0);
+        // 发出跳回 target 的跳转指令
+        void emitLoop(Opcode op, uint8_t a, uint8_t c, size_t target);
+        void patch(size_t at, size_t target);
+        void patchHere(const JumpList& list);
+
+        uint8_t reserve(unsigned n = 1);
+        // 局部变量占用的寄存器之上，都是临时寄存器
+        uint8_t localsTop() const;
+        uint32_t constant(double number);
+        uint32_t constant(std::string_view text);
+        // Number 结点（或其取负）是数字常量时取出它的值
+        bool numberOf(NodeId id, double& value) const;
+
+        Local& declare(NodeId at, std::string_view name, bool isConst);
+        void hoist(NodeId list);
+        void beginScope();
+        void endScope();
+        Variable resolve(NodeId at, std::string_view name);
+        int findLocal(Function& f, std::string_view name);
+        int findCapture(Function& f, std::string_view name);
+        void markCaptured(Function& f, Local& local);
+        // 把 src 存进名为 name 的变量
+        void store(NodeId at, std::string_view name, uint8_t src);
+
+        void statement(NodeId id);
+        void statements(NodeId list);
+        void declaration(NodeId id);
+        void ifStatement(NodeId id);
+        void whileStatement(NodeId id);
+        void doWhileStatement(NodeId id);
+        void forStatement(NodeId id);
+        void switchStatement(NodeId id);
+        void jumpOut(NodeId id, bool isBreak);
+        // 循环体结束处：关闭本轮捕获的变量，回填 continue
+        void endIteration(Loop& loop);
+        // 回填 break 并弹出最内层的循环
+        void endLoop();
+
+        // 把表达式的值放进 dst
+        void into(NodeId id, uint8_t dst);
+        // 表达式的值所在的寄存器：局部变量直接返回它的寄存器，其余放进新的临时寄存器
+        uint8_t any(NodeId id);
+        // 计算表达式并丢弃结果
+        void effect(NodeId id);
+        // 表达式在写入 dst 之后还可能读取 dst 原来的值，写入局部变量时要先放进临时寄存器
+        static bool writesEarly(const parser::Node& node);
+        void assignment(NodeId id, int dst);
+        void binary(NodeId id, uint8_t dst);
+        void call(NodeId id, uint8_t dst);
+        void function(NodeId id, uint8_t dst, std::string_view name);
+        // 表达式的真假等于 when 时跳转，跳转位置加入 out
+        void branch(NodeId id, bool when, JumpList& out);
+
+        const parser::Ast& ast;
+        const lexer::Lexer& lexer;
+        std::unordered_map<std::string_view, uint32_t> globals;
+        Program program;
+        Function* fn;
+        uint32_t line;
+        unsigned depth;
+    };
+}
+}
+
+#endif // !_FLANER_VM_COMPILER_HH_
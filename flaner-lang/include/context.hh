@@ -1,53 +1,132 @@
-#ifndef _FLANER_LEXER_CONTEXT_HH_
-#define _FLANER_LEXER_CONTEXT_HH_
-
-#include <io.hh>
-
-namespace flaner
-{
-namespace lexer
-{
-    class Context
-    {
-    public:
-        Context(std::string path)
-            : source(path),
-            lineOffset(0), charOffset(0)
-        {
-
-        }
-
-        Context(std::wstreambuf* buf)
-            : source(buf),
-            lineOffset(0), charOffset(0)
-        {
-
-        }
-
-        Context(const Context& c)
-            : source(c.source),
-            lineOffset(c.lineOffset), charOffset(c.charOffset)
-        {
-
-        }
-
-
-        ~Context() {}
-
-    public:
-
-        char thischar();
-        char getNextchar(size_t offset = 1);
-        char lookNextchar(size_t offset = 1);
-        char getLastchar();
-        char lookLastchar();
-        bool isEnd();
-
-    public:
-        io::Source source;
-        size_t lineOffset, charOffset;
-    };
-}
-}
-
-#endif // !_FLANER_LEXER_CONTEXT_HH_
+#ifndef _FLANER_LEXER_CONTEXT_HH_
+#define _FLANER_LEXER_CONTEXT_HH_
+
+#include <io.hh>
+#include <stats.hh>
+#include <cstdio>
+
+namespace flaner
+{
+namespace lexer
+{
+    class Context
+    {
+    public:
+        Context(std::string path)
+            : source(path),
+            lineOffset(0), charOffset(0),
+            begin(source.begin()), cursor(begin), end(source.end())
+        {
+
+        }
+
+        Context(io::Source s)
+            : source(s),
+            lineOffset(0), charOffset(0),
+            begin(source.begin()), cursor(begin), end(source.end())
+        {
+
+        }
+
+        Context(std::wstreambuf* buf)
+            : source(buf),
+            lineOffset(0), charOffset(0),
+            begin(source.begin()), cursor(begin), end(source.end())
+        {
+
+        }
+
+        Context(const Context& c)
+            : source(c.source),
+            lineOffset(c.lineOffset), charOffset(c.charOffset),
+            begin(source.begin()), cursor(begin + (c.cursor - c.begin)), end(source.end())
+        {
+
+        }
+
+
+        ~Context() {}
+
+    public:
+
+        char thischar();
+        char getNextchar(size_t offset = 1);
+        char lookNextchar(size_t offset = 1);
+        char getLastchar();
+        char lookLastchar();
+        bool isEnd();
+
+        size_t position() const { return static_cast<size_t>(cursor - begin); }
+        // at 的行列号，从 begin 数起，只在报错等偶尔的场合使用
+        Position locate(const char* at) const;
+
+    public:
+        io::Source source;
+        // begin 之前已经滑出窗口的行数，以及 begin 所在的行在 begin 之前的字符数。
+        // 只有分析滑动窗口的 StreamLexer 等会改变它们，其余情况都是 0
+        size_t lineOffset, charOffset;
+
+        // 读取位置直接在源码缓冲区上移动，cursor 指向下一个未读的字符
+        const char* begin;
+        const char* cursor;
+        const char* end;
+    };
+
+    inline char Context::thischar()
+    {
+        FLANER_STATS(stats::local().streamCalls += 1;)
+        return cursor < end ? *cursor : EOF;
+    }
+
+    inline char Context::getNextchar(size_t offset)
+    {
+        FLANER_STATS(stats::local().streamCalls += 1;)
+        if (static_cast<size_t>(end - cursor) < offset)
+        {
+            cursor = end;
+            return EOF;
+        }
+        cursor += offset;
+        return cursor[-1];
+    }
+
+    inline char Context::lookNextchar(size_t offset)
+    {
+        FLANER_STATS(stats::local().streamCalls += 1;)
+        if (static_cast<size_t>(end - cursor) < offset)
+        {
+            return EOF;
+        }
+        return cursor[offset - 1];
+    }
+
+    inline char Context::getLastchar()
+    {
+        FLANER_STATS(stats::local().ungets += 1;)
+        return cursor > begin ? cursor[-1] : EOF;
+    }
+
+    inline char Context::lookLastchar()
+    {
+        return getLastchar();
+    }
+
+    inline bool Context::isEnd()
+    {
+        return cursor >= end;
+    }
+
+    inline Position Context::locate(const char* at) const
+    {
+        Position p = LineIndex::scan(begin, at);
+        if (p.line == 1)
+        {
+            p.column += charOffset;
+        }
+        p.line += lineOffset;
+        return p;
+    }
+}
+}
+
+#endif // !_FLANER_LEXER_CONTEXT_HH_
@@ -0,0 +1,50 @@
+#ifndef _FLANER_LEXER_DUMP_HH_
+#define _FLANER_LEXER_DUMP_HH_
+
+#include <lexer.hh>
+#include <cstdio>
+
+namespace flaner
+{
+namespace lexer
+{
+    enum class DumpFormat
+    {
+        // [type: 1, value: foo]，字符串加双引号，与原来的输出相同
+        Text,
+        // 每行一个 {"type":1,"value":"foo"}
+        JsonLines,
+        // "FLND" 和 4 字节的 Lexer::version，之后每个 token 为
+        // 2 字节类型、LEB128 编码的长度和原样的文本，整数都是小端序
+        Binary,
+    };
+
+    // 把 token 格式化到一块大缓冲区，攒满后整块写出，格式化时不分配内存
+    class Dumper
+    {
+    public:
+        static constexpr size_t blockSize = 1 << 20;
+
+        Dumper(std::FILE* out, DumpFormat format);
+        Dumper(const Dumper&) = delete;
+        ~Dumper();
+
+        void write(TokenView token);
+        void write(const Lexer& lexer);
+        void flush();
+
+    private:
+        void append(std::string_view s);
+        void writeJsonString(std::string_view s);
+
+        std::FILE* out;
+        DumpFormat format;
+        std::vector<char> buffer;
+    };
+
+    // "text"、"json" 或 "binary"，无法识别时返回 false
+    bool parseDumpFormat(std::string_view name, DumpFormat& format);
+}
+}
+
+#endif // !_FLANER_LEXER_DUMP_HH_
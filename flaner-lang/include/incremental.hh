@@ -0,0 +1,115 @@
+#ifndef _FLANER_LEXER_INCREMENTAL_HH_
+#define _FLANER_LEXER_INCREMENTAL_HH_
+
+#include <lexer.hh>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 供编辑器使用的增量词法分析器。
+    // 每个 token 记录产生它的那一步的起点和当时的词法状态，编辑后从受影响的那一步重新分析，
+    // 直到新 token 与旧 token 在同一位置、同一状态下重合为止。
+    // 源码和 token 序列都是以上次重新分析的起点为间隙的缓冲区，
+    // 一次编辑的代价只与间隙移动的距离和重新分析的字符数有关，与文件大小无关
+    class IncrementalLexer
+    {
+    public:
+        using TokenType = Lexer::TokenType;
+        using Token = Lexer::Token;
+        using TokenView = Lexer::TokenView;
+
+        // 一次编辑中旧的 [first, first + removed) 个 token 被换成了新的 [first, first + inserted)
+        struct Change
+        {
+            size_t first = 0;
+            size_t removed = 0;
+            size_t inserted = 0;
+        };
+
+        explicit IncrementalLexer(std::string text);
+        IncrementalLexer(const IncrementalLexer&) = delete;
+
+        // 把源码的 [offset, offset + removed) 替换为 inserted。
+        // 重新分析时出错会抛出 LexError，此时出错位置之后的 token 被丢弃，下次编辑时重新分析
+        Change edit(size_t offset, size_t removed, std::string_view inserted);
+
+        size_t size() const { return before.tokens.size() + after.tokens.size(); }
+        Token token(size_t i) const;
+        TokenView operator[](size_t i) const;
+        TokenType type(size_t i) const;
+        // 第 i 个 token 是左括号时，与之配对的右括号的下标，没有配对时为 0。
+        // 括号的 attribute 不随编辑维护，查询时才从 i 向后扫描，规则与 TokenStream::matchBrackets() 相同
+        size_t closerOf(size_t i) const;
+        // 第 i 个 token 是数字字面量时，解码后的值
+        Number number(size_t i) const { return core.numberOf(token(i)); }
+        // 拼接出完整的源码，要复制整个文件
+        std::string text() const;
+
+    private:
+        // 一步最多读到它结束位置之后 3 个字符，离编辑位置更近的步骤都要重新分析
+        static constexpr size_t lookaround = 4;
+
+        // 间隙一侧的 token，以及产生每个 token 的那一步的起点（包括前导空白）和那一步开始前的状态在 states 中的下标。
+        // after 按从后往前的顺序存放，源码位置（payload 中的除外）记为到源码末尾的距离，编辑不必移动它们
+        struct Side
+        {
+            TokenStream tokens;
+            std::vector<uint32_t> starts;
+            std::vector<uint32_t> checkpoints;
+
+            void push(const Token& t, uint32_t start, uint32_t checkpoint)
+            {
+                tokens.push_back(t);
+                starts.push_back(start);
+                checkpoints.push_back(checkpoint);
+            }
+            void pop()
+            {
+                tokens.pop_back();
+                starts.pop_back();
+                checkpoints.pop_back();
+            }
+            void clear()
+            {
+                tokens.clear();
+                starts.clear();
+                checkpoints.clear();
+            }
+        };
+
+        Change relex(size_t first, size_t from, size_t editEnd);
+        void moveGap(size_t to);
+        void moveTextGap(size_t to);
+        // 把间隙之后的 [at, at + removed) 替换为 inserted，at 之前的部分向间隙内移动
+        void replaceAfterGap(size_t at, size_t removed, std::string_view inserted);
+        size_t textSize() const { return buffer.size() - (gapEnd - gapStart); }
+        char charAt(size_t i) const { return buffer[i < gapStart ? i : i - gapStart + gapEnd]; }
+        // 间隙所在的行列号，只在报错时使用
+        Position gapPosition() const;
+        size_t restartBefore(size_t position) const;
+        size_t startOf(size_t i) const;
+        uint32_t checkpointOf(size_t i) const;
+        bool isStepStart(size_t i) const;
+        uint32_t checkpoint(const Lexer::State& s);
+        void compact();
+        void attach();
+
+        // [0, gapStart) 和 [gapEnd, buffer.size()) 依次相连是当前的源码。
+        // 间隙停在上次重新分析的起点，core 从间隙之后开始分析，那里的文本是连续的
+        std::vector<char> buffer;
+        size_t gapStart, gapEnd;
+        // 间隙之前的换行数
+        size_t linesBefore;
+        Lexer core;
+
+        Side before, after;
+        // states[0] 是顶层状态，其余按出现顺序追加
+        std::vector<Lexer::State> states;
+
+        size_t compactedPayload, compactedStates;
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_INCREMENTAL_HH_
@@ -0,0 +1,72 @@
+#ifndef _FLANER_LEXER_INTERACTIVE_HH_
+#define _FLANER_LEXER_INTERACTIVE_HH_
+
+#include <lexer.hh>
+#include <string_view>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 交互式（REPL）词法分析器，输入一行分析一行。
+    // 模板字符串、${ ... } 的嵌套等词法状态跨行保留；
+    // 只保留尚未完成的那部分输入，每行的开销与会话已经输入了多少无关
+    class InteractiveLexer
+    {
+    public:
+        using TokenType = Lexer::TokenType;
+        using Token = Lexer::Token;
+        using TokenView = Lexer::TokenView;
+
+        // 一行分析完之后还缺什么
+        enum class Pending
+        {
+            None,
+            // 字符串在行末用反斜杠续行
+            String,
+            // 模板字符串或其中的 ${ ... } 还没有结束
+            Template,
+            // 行末的 . 会让下一行开头的关键字成为标识符，暂不交出
+            Token,
+            // 还有未闭合的 (、[ 或 {，token 已全部交出
+            Bracket,
+        };
+
+        // 给出 interner 时标识符和字符串在整个会话中编号一致
+        explicit InteractiveLexer(Interner* interner = nullptr);
+        InteractiveLexer(const InteractiveLexer&) = delete;
+
+        // 送入一行（末尾的换行可有可无），分析出其中已经完整的 token。
+        // 上一行交出的 token 随之作废。出错时抛出 LexError 并丢弃尚未完成的输入，会话可以继续
+        Pending feed(std::string_view line);
+        Pending pending() const { return status; }
+        bool needsMore() const { return status != Pending::None; }
+        // 放弃尚未完成的输入和跨行的状态，例如用户按下 Ctrl-C 时
+        void reset();
+
+        // 最近一次 feed() 交出的 token
+        size_t size() const { return delivered; }
+        Token token(size_t i) const { return core.sequence[i]; }
+        TokenView operator[](size_t i) const { return core.view(core.sequence[i]); }
+        Number number(size_t i) const { return core.numberOf(core.sequence[i]); }
+        // 尚未闭合的 (、[、{ 的个数
+        size_t depth() const { return brackets; }
+
+    private:
+        void attach(size_t position);
+        void discard(size_t n);
+
+        // 从尚未完成的那一步（或暂不交出的 token）开始的输入
+        std::string buffer;
+        Lexer core;
+
+        // 下一次 feed() 时 buffer 开头可以丢弃的长度，以及丢弃后继续分析的位置
+        size_t consumed, resume;
+        size_t delivered;
+        size_t brackets;
+        Pending status;
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_INTERACTIVE_HH_
@@ -0,0 +1,75 @@
+#ifndef _FLANER_LEXER_INTERNER_HH_
+#define _FLANER_LEXER_INTERNER_HH_
+
+#include <arena.hh>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 字符串驻留表，给每个不同的标识符和字符串字面量一个 32 位的编号。
+    // 可以被多个线程同时使用：同一个表在并行分析多个文件时共享一个编号空间。
+    // 编号在表的生命周期内不变，但并行分析时分配的先后与调度有关
+    class Interner
+    {
+    public:
+        using Symbol = uint32_t;
+        // 不对应任何字符串，没有编号的 token 用它
+        static constexpr Symbol none = 0;
+
+        Interner();
+        Interner(const Interner&) = delete;
+        Interner& operator=(const Interner&) = delete;
+        ~Interner();
+
+        // 返回 s 的编号，第一次见到时分配新编号
+        Symbol intern(std::string_view s);
+        // 只查找，s 不在表中时返回 none
+        Symbol find(std::string_view s) const;
+        // 编号对应的字符串，在表的生命周期内有效。不加锁
+        std::string_view name(Symbol id) const;
+
+        size_t size() const { return next.load(std::memory_order_acquire) - 1; }
+
+    private:
+        // 按哈希值的高位分片，各片独立加锁
+        static constexpr unsigned shardBits = 6;
+        // 按编号查字符串的表分段存放，第 k 段有 2^(firstSegmentBits + k) 项，段一经分配不再移动
+        static constexpr unsigned firstSegmentBits = 10;
+        static constexpr unsigned segmentCount = 32 - firstSegmentBits + 1;
+
+        struct Slot
+        {
+            uint64_t hash;
+            Symbol id;
+        };
+
+        struct Shard
+        {
+            mutable std::shared_mutex mutex;
+            // 开放寻址的哈希表，id 为 none 的格子是空的
+            std::vector<Slot> slots;
+            size_t count = 0;
+            // 驻留的字符串的副本
+            Arena storage{ 4096 };
+        };
+
+        Symbol lookup(const Shard& shard, uint64_t hash, std::string_view s) const;
+        void insert(Shard& shard, Slot slot);
+        void publish(Symbol id, std::string_view s);
+
+        std::atomic<std::string_view*> segments[segmentCount];
+        std::mutex growing;
+        std::atomic<Symbol> next;
+        Shard shards[size_t(1) << shardBits];
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_INTERNER_HH_
@@ -1,72 +1,154 @@
-#ifndef _FLANER_LEXER_IO_HH_
-#define _FLANER_LEXER_IO_HH_
-
-#include <string>
-#include <iostream>
-#include <fstream>
-#include <memory>
-
-namespace flaner
-{
-namespace lexer
-{
-namespace io
-{
-    enum class Encoding
-    {
-        UTF_8,
-        UTF_16,
-        UTF_32,
-    };
-
-    enum class OpenMode
-    {
-        Interactive,
-        OpenExisting,
-    };
-
-    class Source
-    {
-    public:
-        Source(std::string path, Encoding encoding = Encoding::UTF_8)
-            : path(path),
-            encoding(encoding),
-            openMode(OpenMode::OpenExisting)
-        {
-            object.open(path, std::ios::in | std::ios::binary);
-        }
-        Source(const Source& s)
-            : path(s.path),
-            encoding(s.encoding),
-            openMode(s.openMode)
-        {
-
-        }
-        Source(std::wstreambuf* buf, Encoding encoding = Encoding::UTF_8)
-            : path(""),
-            encoding(Encoding::UTF_8),
-            openMode(OpenMode::Interactive)
-        {
-            object << buf;
-        }
-
-        ~Source()
-        {
-            if (openMode == OpenMode::Interactive)
-            {
-                return;
-            }
-            object.close();
-        }
-    public:
-        std::string path;
-        Encoding encoding;
-        OpenMode openMode;
-
-        std::basic_fstream<char> object;
-    };
-}
-}
-}
-
-#endif // !_FLANER_LEXER_IO_HH_
+#ifndef _FLANER_LEXER_IO_HH_
+#define _FLANER_LEXER_IO_HH_
+
+#include <lines.hh>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace flaner
+{
+namespace lexer
+{
+namespace io
+{
+    enum class Encoding
+    {
+        UTF_8,
+        UTF_16,
+        UTF_32,
+    };
+
+    inline const char* nameOf(Encoding encoding)
+    {
+        switch (encoding)
+        {
+        case Encoding::UTF_16:
+            return "UTF-16";
+        case Encoding::UTF_32:
+            return "UTF-32";
+        default:
+            return "UTF-8";
+        }
+    }
+
+    enum class OpenMode
+    {
+        Interactive,
+        OpenExisting,
+    };
+
+    // 一段连续、只读的 UTF-8 源码。
+    // 普通文件直接映射到内存，管道、标准输入等无法映射的来源则整体读入。
+    // 开头的 BOM 决定编码，没有 BOM 时按声明的编码（UTF-16 和 UTF-32 默认小端）；
+    // UTF-16 和 UTF-32 转成 UTF-8，UTF-8 的 BOM 被跳过。
+    // 内容同时被校验，第一处非法序列的位置由 malformedAt() 给出
+    class Buffer
+    {
+    public:
+        static constexpr size_t npos = static_cast<size_t>(-1);
+
+        Buffer() : data(nullptr), size(0), bom(0), mapping(nullptr), encoding(Encoding::UTF_8), malformed(npos) {}
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        ~Buffer();
+
+        // path 为 "-" 时读取标准输入
+        static std::shared_ptr<const Buffer> open(const std::string& path, Encoding declared = Encoding::UTF_8);
+        // 原样映射或读入文件，不识别 BOM、不转码也不校验，用于 token 缓存等二进制文件
+        static std::shared_ptr<const Buffer> openRaw(const std::string& path);
+        static std::shared_ptr<const Buffer> read(std::wstreambuf* buf);
+        // 引用调用者持有的内存，不拷贝也不负责释放；内容需要转码时才复制
+        static std::shared_ptr<const Buffer> borrow(const char* data, size_t size, Encoding declared = Encoding::UTF_8);
+
+        const char* begin() const { return data + bom; }
+        const char* end() const { return data + size; }
+        size_t length() const { return size - bom; }
+        bool isMapped() const { return mapping != nullptr; }
+
+        // 源码原本的编码
+        Encoding sourceEncoding() const { return encoding; }
+        bool isValid() const { return malformed == npos; }
+        // 第一处非法序列相对 begin() 的位置，合法时为 npos
+        size_t malformedAt() const { return malformed; }
+        // 行索引，第一次调用时建立，可以在多个线程中同时调用
+        const LineIndex& lines() const;
+
+    private:
+        // 映射或读入 path 的内容，文件无法打开时返回 false
+        bool fetch(const std::string& path);
+        bool map(const std::string& path);
+        void unmap();
+        void decode(Encoding declared);
+
+        const char* data;
+        size_t size;
+        // data 开头被跳过的 UTF-8 BOM 的长度
+        size_t bom;
+        void* mapping;
+        std::string storage;
+        Encoding encoding;
+        size_t malformed;
+        mutable std::once_flag indexed;
+        mutable std::unique_ptr<LineIndex> lineIndex;
+    };
+
+    class Source
+    {
+    public:
+        Source(std::string path, Encoding encoding = Encoding::UTF_8)
+            : path(path),
+            encoding(encoding),
+            openMode(OpenMode::OpenExisting),
+            buffer(Buffer::open(path, encoding))
+        {
+            this->encoding = buffer->sourceEncoding();
+        }
+        Source(const Source& s)
+            : path(s.path),
+            encoding(s.encoding),
+            openMode(s.openMode),
+            buffer(s.buffer)
+        {
+
+        }
+        Source(std::shared_ptr<const Buffer> b, std::string path = "")
+            : path(path),
+            encoding(b->sourceEncoding()),
+            openMode(OpenMode::OpenExisting),
+            buffer(b)
+        {
+        }
+        // 宽字符按平台的 wchar_t 解释（UTF-16 或 UTF-32），encoding 不起作用
+        Source(std::wstreambuf* buf, Encoding encoding = Encoding::UTF_8)
+            : path(""),
+            encoding(encoding),
+            openMode(OpenMode::Interactive),
+            buffer(Buffer::read(buf))
+        {
+            this->encoding = buffer->sourceEncoding();
+        }
+
+        ~Source() {}
+
+        const char* begin() const { return buffer->begin(); }
+        const char* end() const { return buffer->end(); }
+        size_t size() const { return buffer->length(); }
+        bool isValid() const { return buffer->isValid(); }
+
+    public:
+        std::string path;
+        // 源码原本的编码：有 BOM 时以 BOM 为准，缓冲区中总是 UTF-8
+        Encoding encoding;
+        OpenMode openMode;
+
+        // 拷贝出的 Source 共享同一份缓冲区
+        std::shared_ptr<const Buffer> buffer;
+    };
+}
+}
+}
+
+#endif // !_FLANER_LEXER_IO_HH_
@@ -0,0 +1,126 @@
+#ifndef _FLANER_LEXER_KEYWORD_HH_
+#define _FLANER_LEXER_KEYWORD_HH_
+
+#include <token.hh>
+
+namespace flaner
+{
+namespace lexer
+{
+    struct Keyword
+    {
+        std::string_view name{};
+        TokenType type = TokenType::IDENTIFIER;
+    };
+
+    constexpr Keyword keywords[] = {
+        { "none", TokenType::KEYWORD_NONE },
+        { "true", TokenType::KEYWORD_TRUE },
+        { "false", TokenType::KEYWORD_FALSE },
+        { "if", TokenType::KEYWORD_IF },
+        { "else", TokenType::KEYWORD_ELSE },
+        { "switch", TokenType::KEYWORD_SWITCH },
+        { "case", TokenType::KEYWORD_CASE },
+        { "default", TokenType::KEYWORD_DEFAULT },
+        { "while", TokenType::KEYWORD_WHILE },
+        { "do", TokenType::KEYWORD_DO },
+        { "for", TokenType::KEYWORD_FOR },
+        { "in", TokenType::KEYWORD_IN },
+        { "of", TokenType::KEYWORD_OF },
+        { "break", TokenType::KEYWORD_BREAK },
+        { "continue", TokenType::KEYWORD_CONTINUE },
+        { "throw", TokenType::KEYWORD_THROW },
+        { "return", TokenType::KEYWORD_RETURN },
+        { "yield", TokenType::KEYWORD_YIELD },
+        { "const", TokenType::KEYWORD_CONST },
+        { "let", TokenType::KEYWORD_LET },
+        { "class", TokenType::KEYWORD_CLASS },
+        { "import", TokenType::KEYWORD_IMPORT },
+        { "export", TokenType::KEYWORD_EXPORT },
+        { "as", TokenType::KEYWORD_AS },
+        { "from", TokenType::KEYWORD_FROM },
+    };
+
+    // 关键字的完美哈希表，在编译期生成。
+    // 哈希只用到长度、首字符和末字符，乘数在编译期搜索，保证关键字之间没有冲突
+    class KeywordTable
+    {
+    public:
+        static constexpr size_t size = 64;
+        static constexpr size_t minLength = 2;
+        static constexpr size_t maxLength = 8;
+
+        constexpr KeywordTable()
+            : slots(), first(0), last(0)
+        {
+            for (unsigned a = 1; a < 256; ++a)
+            {
+                for (unsigned b = 1; b < 256; ++b)
+                {
+                    if (tryBuild(a, b))
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+
+        constexpr bool isPerfect() const
+        {
+            return first != 0;
+        }
+
+        constexpr TokenType lookup(std::string_view s) const
+        {
+            if (s.size() < minLength || s.size() > maxLength)
+            {
+                return TokenType::IDENTIFIER;
+            }
+            const Keyword& slot = slots[hash(s, first, last)];
+            return slot.name == s ? slot.type : TokenType::IDENTIFIER;
+        }
+
+    private:
+        static constexpr size_t hash(std::string_view s, unsigned a, unsigned b)
+        {
+            return (static_cast<unsigned char>(s[0]) * a
+                + static_cast<unsigned char>(s[s.size() - 1]) * b
+                + s.size()) % size;
+        }
+
+        constexpr bool tryBuild(unsigned a, unsigned b)
+        {
+            for (auto& slot : slots)
+            {
+                slot = { {}, TokenType::IDENTIFIER };
+            }
+            for (const auto& k : keywords)
+            {
+                Keyword& slot = slots[hash(k.name, a, b)];
+                if (!slot.name.empty())
+                {
+                    return false;
+                }
+                slot = k;
+            }
+            first = a;
+            last = b;
+            return true;
+        }
+
+        Keyword slots[size];
+        unsigned first, last;
+    };
+
+    constexpr KeywordTable keywordTable{};
+    static_assert(keywordTable.isPerfect(), "no collision-free multipliers for the keyword table");
+
+    // 不分配内存、不抛异常地区分关键字和标识符
+    constexpr TokenType keywordOf(std::string_view s)
+    {
+        return keywordTable.lookup(s);
+    }
+}
+}
+
+#endif // !_FLANER_LEXER_KEYWORD_HH_
@@ -1,326 +1,253 @@
-#ifndef _FLANER_LEXER_LEXER_HH_
-#define _FLANER_LEXER_LEXER_HH_
-
-#include <context.hh>
-#include <vector>
-#include <unordered_map>
-#include <unordered_set>
-#include <functional>
-
-namespace flaner
-{
-	namespace lexer
-	{
-		class Lexer
-		{
-		public:
-			Lexer(std::string path)
-				: context(path),
-				sequence()
-			{
-				process();
-				location = sequence.begin();
-			}
-
-			Lexer(const Lexer& l)
-				: context(l.context),
-				sequence(l.sequence), location(l.location), cursor(l.cursor)
-			{
-				std::cout << "In Lexer(const Lexer& l)\n";
-			}
-
-			Lexer(std::wstreambuf* buf)
-				: context(buf),
-				sequence()
-			{
-				std::cout << "Hi\n";
-				process();
-				location = sequence.begin();
-			}
-
-			~Lexer() {}
-
-		private:
-			Context context;
-
-		public:
-			enum class TokenType : uint16_t
-			{
-				UNKNOWN,
-				END_OF_FILE,
-
-				KEYWORD_NONE,
-				KEYWORD_TRUE,
-				KEYWORD_FALSE,
-				NUMBER,
-				STRING,
-				BIGINT,
-				RATIONAL,
-
-				IDENTIFIER,
-
-				KEYWORD_IF,
-				KEYWORD_ELSE,
-				KEYWORD_SWITCH,
-				KEYWORD_CASE,
-				KEYWORD_DEFAULT,
-				KEYWORD_WHILE,
-				KEYWORD_DO,
-				KEYWORD_FOR,
-				KEYWORD_IN,
-				KEYWORD_OF,
-				KEYWORD_BREAK,
-				KEYWORD_CONTINUE,
-				KEYWORD_RETURN,
-				KEYWORD_THROW,
-				KEYWORD_YIELD,
-
-				KEYWORD_LET,
-				KEYWORD_CONST,
-				KEYWORD_CLASS,
-				KEYWORD_IMPORT,
-				KEYWORD_EXPORT,
-				KEYWORD_FROM,
-				KEYWORD_AS,
-
-				FUNCTION_ARROW,
-
-				OP_ADD,
-				OP_MINUS,
-				OP_MUL,
-				OP_INTDIV,
-				OP_DIV,
-				OP_MOD,
-				OP_QUOTE,
-				OP_POW,
-
-				OP_ADD_ASSIGN,
-				OP_MINUS_ASSIGN,
-				OP_MUL_ASSIGN,
-				OP_INTDIV_ASSIGN,
-				OP_DIV_ASSIGN,
-				OP_MOD_ASSIGN,
-				OP_QUOTE_ASSIGN,
-				OP_POW_ASSIGN,
-
-				OP_LOGIC_NEGATE,
-				OP_LOGIC_OR,
-				OP_LOGIC_AND,
-
-				OP_BIT_NEGATE,
-				OP_BIT_OR,
-				OP_BIT_AND,
-				OP_BIT_XOR,
-
-				OP_BIT_OR_ASSIGN,
-				OP_BIT_AND_ASSIGN,
-				OP_BIT_XOR_ASSIGN,
-
-				OP_SHIFT_LEFT,
-				OP_SHIFT_RIGHT,
-				OP_SHIFT_LEFT_ASSIGN,
-				OP_SHIFT_RIGHT_ASSIGN,
-
-				OP_LESS_THAN,
-				OP_GREATER_THAN,
-				OP_LESS_EQUAL,
-				OP_GREATER_EQUAL,
-				OP_EQUAL,
-				OP_NOT_EQUAL,
-
-				OP_ASSIGN,
-				OP_COLON,
-				OP_QUESTION,
-				OP_COMMA,
-				OP_DOT,
-				OP_DOT_DOT,
-				OP_DOT_DOT_DOT,
-
-				OP_PAREN_BEGIN,
-				OP_PAREN_END,
-				OP_BRACKET_BEGIN,
-				OP_BRACKET_END,
-				OP_BRACE_BEGIN,
-				OP_BRACE_END,
-				
-				OP_SEMICOLON,
-
-			};
-
-			friend std::unordered_set<TokenType> operator|(TokenType t1, TokenType t2)
-			{
-				return std::unordered_set<TokenType> { t1, t2 };
-			}
-
-			friend std::unordered_set<TokenType> operator|(std::unordered_set<TokenType> s, TokenType t2)
-			{
-				s.insert(t2);
-				return s;
-			}
-
-			struct Token
-			{
-				TokenType type;
-				std::string value;
-				Token(TokenType a, std::string b) : type(a), value(b) {}
-				bool operator==(TokenType t)
-				{
-					return type == t;
-				}
-				bool operator==(std::string& s)
-				{
-					return value == s;
-				}
-				operator TokenType()
-				{
-					return type;
-				}
-			};
-
-		private:
-			std::vector<Token> sequence;
-			size_t cursor;
-			std::vector<Token>::iterator location;
-#define MAP(s, v) { s, TokenType::KEYWORD_##v },
-			std::unordered_map<std::string, TokenType> keywordMap
-			{
-				MAP("none", NONE)
-				MAP("true", TRUE)
-				MAP("false", FALSE)
-				MAP("if", IF)
-				MAP("else", ELSE)
-				MAP("switch", SWITCH)
-				MAP("case", CASE)
-				MAP("default", DEFAULT)
-				MAP("while", WHILE)
-				MAP("do", DO)
-				MAP("for", FOR)
-				MAP("in", IN)
-				MAP("of", OF)
-				MAP("break", BREAK)
-				MAP("continue", CONTINUE)
-				MAP("throw", THROW)
-				MAP("return", RETURN)
-				MAP("const", CONST)
-				MAP("let", LET)
-				MAP("import", IMPORT)
-				MAP("export", EXPORT)
-				MAP("as", AS)
-				MAP("from", FROM)
-			};
-#undef MAP
-
-			std::unordered_set<TokenType> operatorSet
-			{
-				TokenType::KEYWORD_IN,
-				TokenType::KEYWORD_OF,
-
-				TokenType::OP_ADD,
-				TokenType::OP_MINUS,
-				TokenType::OP_MUL,
-				TokenType::OP_INTDIV,
-				TokenType::OP_DIV,
-				TokenType::OP_MOD,
-				TokenType::OP_QUOTE,
-				TokenType::OP_POW,
-
-				TokenType::OP_ADD_ASSIGN,
-				TokenType::OP_MINUS_ASSIGN,
-				TokenType::OP_MUL_ASSIGN,
-				TokenType::OP_INTDIV_ASSIGN,
-				TokenType::OP_DIV_ASSIGN,
-				TokenType::OP_MOD_ASSIGN,
-				TokenType::OP_QUOTE_ASSIGN,
-				TokenType::OP_POW_ASSIGN,
-
-				TokenType::OP_LOGIC_NEGATE,
-				TokenType::OP_LOGIC_OR,
-				TokenType::OP_LOGIC_AND,
-
-				TokenType::OP_BIT_NEGATE,
-				TokenType::OP_BIT_OR,
-				TokenType::OP_BIT_AND,
-				TokenType::OP_BIT_XOR,
-
-				TokenType::OP_BIT_OR_ASSIGN,
-				TokenType::OP_BIT_AND_ASSIGN,
-				TokenType::OP_BIT_XOR_ASSIGN,
-
-				TokenType::OP_SHIFT_LEFT,
-				TokenType::OP_SHIFT_RIGHT,
-				TokenType::OP_SHIFT_LEFT_ASSIGN,
-				TokenType::OP_SHIFT_RIGHT_ASSIGN,
-
-				TokenType::OP_LESS_THAN,
-				TokenType::OP_GREATER_THAN,
-				TokenType::OP_LESS_EQUAL,
-				TokenType::OP_GREATER_EQUAL,
-				TokenType::OP_EQUAL,
-				TokenType::OP_NOT_EQUAL,
-
-				TokenType::OP_ASSIGN,
-				TokenType::OP_COLON,
-				TokenType::OP_QUESTION,
-				TokenType::OP_COMMA,
-				TokenType::OP_DOT,
-				TokenType::OP_DOT_DOT,
-				TokenType::OP_DOT_DOT_DOT,
-
-				TokenType::OP_PAREN_BEGIN,
-				TokenType::OP_PAREN_END,
-				TokenType::OP_BRACKET_BEGIN,
-				TokenType::OP_BRACKET_END,
-				TokenType::OP_BRACE_BEGIN,
-				TokenType::OP_BRACE_END,
-			};
-
-			void process();
-			std::string getNumber();
-			inline char getEscapeCharacter();
-			std::string getString(char mark);
-			void processTemplateString(std::function<void(TokenType, std::string)>);
-			unsigned int levelOfTemplateNesting;
-			unsigned int levelOfParanthesesNestingInTemplateInnerEvaluation;
-
-		public:
-			bool isBlank(char ch);
-			TokenType getKeywordOrID(std::string s);
-
-		public:
-			std::vector<Token> getSequence();
-			Token forwards(size_t n = 1);
-			Token backwards(size_t n = 1);
-			Token go(size_t n = 1);
-			Token last(size_t n = 1);
-			Token now();
-
-			// 当接下来的 token 与模式相匹配时，
-			// 若找到 t1 且其后跟随 t2，
-			// 则返回最先找到 t2 的位置相对于当前位置的偏移量
-			size_t tryFindingAfter(std::unordered_set<TokenType> patterns, TokenType t1, TokenType t2);
-
-			// 当接下来的 token 与模式相匹配时，
-			// 若找到 t2
-			// 则返回最先找到 t2 的位置相对于当前位置的偏移量
-			size_t tryFinding(std::unordered_set<TokenType> patterns, TokenType t);
-
-			bool isEnd();
-			std::unordered_map<std::string, TokenType> getKeywordMap();
-			std::unordered_set<TokenType> getOperatorSet();
-
-			struct LexError
-			{
-				std::string info;
-				size_t line, offset;
-				LexError(std::string s, size_t a, size_t b)
-					: info("(from Lexer) " + s),
-					line(a), offset(b)
-				{
-				}
-			};
-			void error(std::string info);
-		};
-	}
-}
-
-#endif // !_FLANER_LEXER_LEXER_HH_
+#ifndef _FLANER_LEXER_LEXER_HH_
+#define _FLANER_LEXER_LEXER_HH_
+
+#include <context.hh>
+#include <token.hh>
+#include <keyword.hh>
+#include <scan.hh>
+#include <interner.hh>
+#include <number.hh>
+#include <memory_resource>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+namespace flaner
+{
+	namespace lexer
+	{
+		class Lexer
+		{
+		public:
+			// 词法规则或 token 的表示改变时递增，已缓存的 token 据此失效
+			static constexpr uint32_t version = 6;
+
+			struct Options
+			{
+				// 把模板字符串展开成 STRING + ( ... ) + STRING，得到版本 5 之前的 token 序列
+				bool desugarTemplates = false;
+				// 出错时不抛出 LexError，而是记入 getDiagnostics()，从行尾或结束的引号处接着分析；
+				// 出错的部分成为一个 UNKNOWN token。源码过大和编码错误仍然抛出。
+				// 只对 Lexer 和 ParallelLexer 有效，其余的分析器依靠异常判断输入是否完整
+				bool recover = false;
+			};
+
+			// recover 模式下记下的一个错误
+			struct Diagnostic
+			{
+				// 出错处在源码中的字节偏移，与抛出 LexError 时报告的位置相同
+				uint32_t offset;
+				// 静态的说明文字，不含 SyntaxError 前缀
+				const char* message;
+			};
+
+			Lexer(std::string path)
+				: context(path),
+				sequence(), cursor(0), interner(nullptr)
+			{
+				process();
+			}
+
+			Lexer(io::Source source)
+				: context(source),
+				sequence(), cursor(0), interner(nullptr)
+			{
+				process();
+			}
+
+			// token 序列和 payload 从 resource 分配，例如一个 Arena，
+			// 分析完的文件随 Arena::reset() 一次性释放。resource 须比 Lexer 活得长。
+			// 给出 interner 时标识符和字符串字面量的 token 带有它分配的编号
+			Lexer(io::Source source, std::pmr::memory_resource* resource, Interner* interner = nullptr)
+				: context(source),
+				sequence(resource), cursor(0), payload(resource), interner(interner), diagnostics(resource)
+			{
+				process();
+			}
+
+			Lexer(io::Source source, Options options,
+				std::pmr::memory_resource* resource = std::pmr::get_default_resource(), Interner* interner = nullptr)
+				: context(source),
+				sequence(resource), cursor(0), payload(resource), interner(interner), options(options), diagnostics(resource)
+			{
+				process();
+			}
+
+			Lexer(const Lexer& l)
+				: context(l.context),
+				sequence(l.sequence), cursor(l.cursor), payload(l.payload), interner(l.interner), options(l.options),
+				diagnostics(l.diagnostics)
+			{
+			}
+
+			Lexer(std::wstreambuf* buf)
+				: context(buf),
+				sequence(), cursor(0), interner(nullptr)
+			{
+				process();
+			}
+
+			~Lexer() {}
+
+		private:
+			friend class StreamLexer;
+			friend class ParallelLexer;
+			friend class IncrementalLexer;
+			friend class TokenCache;
+			friend class InteractiveLexer;
+
+			// 不立即处理，由友元通过 step() 逐个产生 token
+			explicit Lexer(Context c, std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+				Interner* interner = nullptr)
+				: context(c),
+				sequence(resource), cursor(0), payload(resource), interner(interner), diagnostics(resource)
+			{
+			}
+
+			Context context;
+
+		public:
+			using TokenType = lexer::TokenType;
+			using Token = lexer::Token;
+			using TokenView = lexer::TokenView;
+
+			// getSequence() 返回的只读区间，遍历时逐个给出 TokenView
+			class Sequence
+			{
+			public:
+				class iterator
+				{
+				public:
+					iterator(const Lexer* l, size_t i) : lexer(l), index(i) {}
+					TokenView operator*() const { return lexer->view(lexer->sequence[index]); }
+					iterator& operator++() { ++index; return *this; }
+					bool operator!=(const iterator& o) const { return index != o.index; }
+					bool operator==(const iterator& o) const { return index == o.index; }
+				private:
+					const Lexer* lexer;
+					size_t index;
+				};
+
+				Sequence(const Lexer* l) : lexer(l) {}
+				iterator begin() const { return { lexer, 0 }; }
+				iterator end() const { return { lexer, lexer->sequence.size() }; }
+				size_t size() const { return lexer->sequence.size(); }
+				TokenView operator[](size_t i) const { return lexer->view(lexer->sequence[i]); }
+
+			private:
+				const Lexer* lexer;
+			};
+
+		private:
+			TokenStream sequence;
+			// 当前 token 在 sequence 中的下标，forwards/go/last 等都相对于它
+			size_t cursor;
+			// 含转义的字符串解码后存放于此，带 Token::Payload 的 token 的 offset 指向这里
+			std::pmr::string payload;
+			Interner* interner;
+			Options options;
+			std::pmr::vector<Diagnostic> diagnostics;
+
+			void process();
+			// 词法错误：recover 模式下记下当前位置并返回，由调用者跳到同步点；否则抛出 LexError
+			void diagnose(const char* message);
+			// 源码含有非法的 UTF-8（或转码前非法的 UTF-16、UTF-32）时报错
+			void checkEncoding();
+			// 跳过空白后处理一个 token（模板字符串可能一次产生多个），已到末尾时返回 false
+			bool step();
+			// type 之后的 token 是否会因它而改变：. 之后的关键字当作标识符
+			static bool affectsNext(TokenType type);
+			Token slice(TokenType type, const char* from, const char* to);
+			Token synthetic(TokenType type);
+			// 标识符和字符串字面量的 attribute 是 interner 中的编号
+			static bool hasSymbol(TokenType type) { return type == TokenType::IDENTIFIER || type == TokenType::STRING; }
+			uint32_t symbolOf(const Token& token) const;
+			// 第 i 个 token 开头在源码中的偏移
+			size_t startOf(size_t i) const;
+			// 读取并解码数字字面量，n 和 r 后缀分别给出 BIGINT 和 RATIONAL
+			Token getNumber();
+			// 从 start 开始的标识符或关键字，首字符已经确认；非 ASCII 的字符按 Unicode 的 XID 类别
+			Token getIdentifier(const char* start);
+			inline char getEscapeCharacter();
+			Token getString(char mark);
+			void processTemplateString(std::function<void(Token)>);
+
+			// 需要跨 token 保留的词法状态
+			struct State
+			{
+				unsigned int levelOfTemplateNesting = 0;
+				// 当前模板表达式 ${ ... } 中尚未闭合的 { 的个数
+				unsigned int levelOfParanthesesNestingInTemplateInnerEvaluation = 0;
+				// 进入内层模板表达式时，外层尚未闭合的 { 的个数依次压入这里
+				std::vector<unsigned int> outerLevels;
+
+				bool operator==(const State& s) const;
+				bool operator!=(const State& s) const { return !(*this == s); }
+			};
+			State state;
+
+		public:
+			bool isBlank(char ch);
+			TokenType getKeywordOrID(std::string_view s);
+
+		public:
+			Sequence getSequence();
+			TokenView view(const Token& token) const;
+			// NUMBER、BIGINT、RATIONAL token 解码后的值
+			Number numberOf(const Token& token) const;
+			// 源码中第 offset 个字节的行列号，第一次查询时建立行索引
+			Position positionAt(size_t offset) const;
+			// 第 i 个 token 开头的行列号
+			Position positionOf(size_t i) const;
+			// 只要行号时用这两个，不数列，长行上的查询不随行长变慢
+			size_t lineAt(size_t offset) const;
+			size_t lineOf(size_t i) const;
+			TokenView forwards(size_t n = 1);
+			TokenView backwards(size_t n = 1);
+			TokenView go(size_t n = 1);
+			TokenView last(size_t n = 1);
+			TokenView now();
+			// 当前 token 在序列中的下标
+			size_t index() const { return cursor; }
+
+			// 当接下来的 token 与模式相匹配时，
+			// 若找到 t1 且其后跟随 t2，
+			// 则返回最先找到 t2 的位置相对于当前位置的偏移量
+			size_t tryFindingAfter(TokenSet patterns, TokenType t1, TokenType t2);
+
+			// 当接下来的 token 与模式相匹配时，
+			// 若找到 t2
+			// 则返回最先找到 t2 的位置相对于当前位置的偏移量
+			size_t tryFinding(TokenSet patterns, TokenType t);
+
+			// 第 i 个 token 是 ( [ { 时，与之配对的右括号的下标，没有配对时为 0。
+			// 整个序列分析完后记录，向前查看括号之后的 token 不必逐个扫描
+			size_t closerOf(size_t i) const { return sequence.closerOf(i); }
+
+			bool isEnd();
+			const TokenStream& getStream() const { return sequence; }
+			// recover 模式下按出现顺序记下的错误
+			const std::pmr::vector<Diagnostic>& getDiagnostics() const { return diagnostics; }
+			Interner* getInterner() const { return interner; }
+			std::unordered_map<std::string, TokenType> getKeywordMap();
+			TokenSet getOperatorSet();
+
+			struct LexError
+			{
+				std::string info;
+				// 出错位置，从 1 开始
+				size_t line, column;
+				LexError(std::string s, size_t a, size_t b)
+					: info("(from Lexer) " + s),
+					line(a), column(b)
+				{
+				}
+			};
+			[[noreturn]] void error(std::string info);
+			// 与 diagnostic 对应的 LexError，即不开启 recover 时会抛出的那个
+			LexError errorOf(const Diagnostic& diagnostic) const;
+		};
+	}
+}
+
+#endif // !_FLANER_LEXER_LEXER_HH_
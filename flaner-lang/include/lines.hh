@@ -0,0 +1,66 @@
+#ifndef _FLANER_LEXER_LINES_HH_
+#define _FLANER_LEXER_LINES_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 源码中的位置，行号和列号都从 1 开始，列按 UTF-8 字符计
+    struct Position
+    {
+        size_t line = 1;
+        size_t column = 1;
+    };
+
+    // 每行起点的索引，把字节偏移换算成行列号时二分查找。
+    // 每 64 行为一块：块内各行相对块起点的偏移用 2 字节存放，
+    // 块中有超过 64 KiB 的行时整块改用 4 字节，平均每行约 2 字节
+    class LineIndex
+    {
+    public:
+        LineIndex() : begin(nullptr), end(nullptr), lines(0) {}
+        // 向量化地扫描一遍 [begin, end) 中的换行建立索引，源码须比索引活得长
+        LineIndex(const char* begin, const char* end);
+
+        Position locate(size_t offset) const;
+        // 只查行号，不数列，代价与行的长度无关
+        size_t lineOf(size_t offset) const;
+        size_t lineCount() const { return lines; }
+        // 第 line 行（从 1 开始）的起点
+        size_t lineStart(size_t line) const;
+        size_t memoryUsage() const;
+
+        // 不建索引，直接从 begin 数到 at，适合只查询一次的场合，例如报错
+        static Position scan(const char* begin, const char* at);
+
+    private:
+        static constexpr size_t blockLines = 64;
+        // 块内偏移按 4 字节存放的块，at 带有这个标志
+        static constexpr uint32_t wideBlock = 0x80000000u;
+
+        struct Block
+        {
+            uint64_t base;
+            // 块内偏移在 narrow 或 wide 中的起点
+            uint32_t at;
+        };
+
+        void addBlock(const uint64_t* starts, size_t count);
+        // 从 line 的起点数到 offset 的字符数
+        size_t columnOf(size_t lineStart, size_t offset) const;
+
+        const char* begin;
+        const char* end;
+        size_t lines;
+        std::vector<Block> blocks;
+        std::vector<uint16_t> narrow;
+        std::vector<uint32_t> wide;
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_LINES_HH_
@@ -0,0 +1,82 @@
+#ifndef _FLANER_LEXER_NUMBER_HH_
+#define _FLANER_LEXER_NUMBER_HH_
+
+#include <token.hh>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 数字字面量解码后的值。
+    // NUMBER 是 Integer（没有小数点和指数且不超过 64 位）或 Float，
+    // BIGINT（后缀 n）是 BigInt，RATIONAL（后缀 r）是约分后的 Rational
+    struct Number
+    {
+        enum class Kind : uint8_t
+        {
+            Integer,
+            Float,
+            BigInt,
+            Rational,
+        };
+
+        // 任意精度整数按 32 位分段，低位在前。直接引用 payload，不一定对齐
+        class Limbs
+        {
+        public:
+            Limbs() : data(nullptr), count(0) {}
+            Limbs(const char* d, uint32_t n) : data(d), count(n) {}
+
+            uint32_t size() const { return count; }
+            uint32_t operator[](size_t i) const
+            {
+                uint32_t v;
+                std::memcpy(&v, data + i * sizeof(v), sizeof(v));
+                return v;
+            }
+
+        private:
+            const char* data;
+            uint32_t count;
+        };
+
+        Kind kind = Kind::Integer;
+        uint64_t integer = 0;
+        // 超出 double 范围的字面量为 inf，过小的为 0
+        double real = 0;
+        Limbs numerator, denominator;
+
+        // 最接近的 double，BigInt 和 Rational 可能损失精度
+        double approximate() const;
+        // 十进制表示，Rational 写作 分子/分母
+        std::string toString() const;
+    };
+
+namespace number
+{
+    // 小于 2^32 的整数直接存在 token 的 attribute 中，其余的值以记录的形式追加到 payload
+    struct Decoded
+    {
+        bool spilled;
+        uint32_t attribute;
+    };
+
+    // 解码不带符号的字面量 text，type 为 NUMBER、BIGINT 或 RATIONAL。
+    // 字面量不合法时返回错误信息，否则返回 nullptr
+    const char* decode(std::string_view text, TokenType type, std::pmr::string& payload, Decoded& out);
+
+    // 读取 payload 中 offset 处的记录
+    Number read(const char* payload, uint32_t offset);
+    // 记录占用的字节数
+    size_t recordSize(const char* payload, uint32_t offset);
+}
+}
+}
+
+#endif // !_FLANER_LEXER_NUMBER_HH_
@@ -0,0 +1,184 @@
+#ifndef _FLANER_LEXER_OPERATOR_HH_
+#define _FLANER_LEXER_OPERATOR_HH_
+
+#include <token.hh>
+#include <cstdint>
+
+namespace flaner
+{
+namespace lexer
+{
+    struct Operator
+    {
+        std::string_view spelling{};
+        TokenType type = TokenType::UNKNOWN;
+    };
+
+    // 所有运算符和标点的写法，词法分析的自动机和 spellingOf() 都由它生成
+    constexpr Operator operators[] = {
+        { "=>", TokenType::FUNCTION_ARROW },
+
+        { "+", TokenType::OP_ADD },
+        { "-", TokenType::OP_MINUS },
+        { "*", TokenType::OP_MUL },
+        { "//", TokenType::OP_INTDIV },
+        { "/", TokenType::OP_DIV },
+        { "%", TokenType::OP_MOD },
+        { "%%", TokenType::OP_QUOTE },
+        { "**", TokenType::OP_POW },
+
+        { "+=", TokenType::OP_ADD_ASSIGN },
+        { "-=", TokenType::OP_MINUS_ASSIGN },
+        { "*=", TokenType::OP_MUL_ASSIGN },
+        { "//=", TokenType::OP_INTDIV_ASSIGN },
+        { "/=", TokenType::OP_DIV_ASSIGN },
+        { "%=", TokenType::OP_MOD_ASSIGN },
+        { "%%=", TokenType::OP_QUOTE_ASSIGN },
+        { "**=", TokenType::OP_POW_ASSIGN },
+
+        { "!", TokenType::OP_LOGIC_NEGATE },
+        { "||", TokenType::OP_LOGIC_OR },
+        { "&&", TokenType::OP_LOGIC_AND },
+
+        { "~", TokenType::OP_BIT_NEGATE },
+        { "|", TokenType::OP_BIT_OR },
+        { "&", TokenType::OP_BIT_AND },
+        { "^", TokenType::OP_BIT_XOR },
+
+        { "|=", TokenType::OP_BIT_OR_ASSIGN },
+        { "&=", TokenType::OP_BIT_AND_ASSIGN },
+        { "^=", TokenType::OP_BIT_XOR_ASSIGN },
+
+        { "<<", TokenType::OP_SHIFT_LEFT },
+        { ">>", TokenType::OP_SHIFT_RIGHT },
+        { "<<=", TokenType::OP_SHIFT_LEFT_ASSIGN },
+        { ">>=", TokenType::OP_SHIFT_RIGHT_ASSIGN },
+
+        { "<", TokenType::OP_LESS_THAN },
+        { ">", TokenType::OP_GREATER_THAN },
+        { "<=", TokenType::OP_LESS_EQUAL },
+        { ">=", TokenType::OP_GREATER_EQUAL },
+        { "==", TokenType::OP_EQUAL },
+        { "!=", TokenType::OP_NOT_EQUAL },
+
+        { "=", TokenType::OP_ASSIGN },
+        { ":", TokenType::OP_COLON },
+        { "?", TokenType::OP_QUESTION },
+        { ",", TokenType::OP_COMMA },
+        { ".", TokenType::OP_DOT },
+        { "..", TokenType::OP_DOT_DOT },
+        { "...", TokenType::OP_DOT_DOT_DOT },
+
+        { "(", TokenType::OP_PAREN_BEGIN },
+        { ")", TokenType::OP_PAREN_END },
+        { "[", TokenType::OP_BRACKET_BEGIN },
+        { "]", TokenType::OP_BRACKET_END },
+        { "{", TokenType::OP_BRACE_BEGIN },
+        { "}", TokenType::OP_BRACE_END },
+
+        { ";", TokenType::OP_SEMICOLON },
+    };
+
+    // 运算符的最长匹配自动机，在编译期由 operators 生成。
+    // 状态是各写法构成的前缀树的结点；出现在运算符中的字节先映射成列号，
+    // 其余字节都映射到第 0 列，那一列没有转移，所以每读一个字节只查一次表
+    class OperatorTable
+    {
+    public:
+        static constexpr size_t maxStates = 64;
+        static constexpr size_t maxColumns = 32;
+
+        constexpr OperatorTable()
+            : columns(), transitions(), accepts(), states(1), width(1), longest(0)
+        {
+            for (const auto& o : operators)
+            {
+                if (!add(o))
+                {
+                    states = 0;
+                    return;
+                }
+            }
+        }
+
+        constexpr bool isValid() const
+        {
+            return states != 0;
+        }
+
+        // 最长的写法的长度，匹配时最多读到它之后一个字节
+        constexpr size_t maxLength() const
+        {
+            return longest;
+        }
+
+        // 从 p 开始最长的运算符的长度，类型存入 type；p 处不是运算符时返回 0
+        constexpr size_t match(const char* p, const char* end, TokenType& type) const
+        {
+            size_t length = 0;
+            uint8_t s = 0;
+            for (const char* q = p; q < end; ++q)
+            {
+                s = transitions[s][columns[static_cast<unsigned char>(*q)]];
+                if (s == 0)
+                {
+                    break;
+                }
+                if (accepts[s] != TokenType::UNKNOWN)
+                {
+                    length = static_cast<size_t>(q - p) + 1;
+                    type = accepts[s];
+                }
+            }
+            return length;
+        }
+
+    private:
+        constexpr bool add(const Operator& o)
+        {
+            uint8_t s = 0;
+            for (char ch : o.spelling)
+            {
+                uint8_t& column = columns[static_cast<unsigned char>(ch)];
+                if (column == 0)
+                {
+                    if (width == maxColumns)
+                    {
+                        return false;
+                    }
+                    column = width++;
+                }
+                uint8_t& target = transitions[s][column];
+                if (target == 0)
+                {
+                    if (states == maxStates)
+                    {
+                        return false;
+                    }
+                    target = states++;
+                }
+                s = target;
+            }
+            // 写法重复或为空
+            if (s == 0 || accepts[s] != TokenType::UNKNOWN)
+            {
+                return false;
+            }
+            accepts[s] = o.type;
+            longest = o.spelling.size() > longest ? o.spelling.size() : longest;
+            return true;
+        }
+
+        uint8_t columns[256];
+        uint8_t transitions[maxStates][maxColumns];
+        TokenType accepts[maxStates];
+        uint8_t states, width;
+        size_t longest;
+    };
+
+    constexpr OperatorTable operatorTable{};
+    static_assert(operatorTable.isValid(), "too many operator spellings, or a duplicate one");
+}
+}
+
+#endif // !_FLANER_LEXER_OPERATOR_HH_
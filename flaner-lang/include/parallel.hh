@@ -0,0 +1,52 @@
+#ifndef _FLANER_LEXER_PARALLEL_HH_
+#define _FLANER_LEXER_PARALLEL_HH_
+
+#include <lexer.hh>
+#include <pool.hh>
+#include <exception>
+#include <memory>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 单个大文件的并行词法分析。
+    // 源码在换行处切成若干块，每块假定从顶层开始（不在字符串、模板中）并行分析；
+    // 之后按顺序检查每块真实的入口状态，猜错的块再串行重新分析。结果与 Lexer 完全相同
+    class ParallelLexer
+    {
+    public:
+        // 源码不到两块大小或线程池只有一个线程时直接串行分析。
+        // 各块共用 interner，编号与串行分析时一一对应，但数值可能不同；
+        // 猜错而丢弃的块驻留过的字符串仍留在表中
+        static Lexer lex(io::Source source, ThreadPool& pool, size_t chunkSize = 1 << 20, Interner* interner = nullptr,
+            Lexer::Options options = {});
+
+    private:
+        struct Chunk
+        {
+            const char* from;
+            const char* to;
+            Lexer lexer;
+
+            // 第一个 token 的位置，以及分析到块末尾后的位置和状态
+            const char* entry;
+            const char* exit;
+            std::exception_ptr failure;
+
+            Chunk(const Context& c, Interner* interner, Lexer::Options options, const char* from, const char* to)
+                : from(from), to(to), lexer(c, std::pmr::get_default_resource(), interner),
+                entry(from), exit(from)
+            {
+                lexer.options = options;
+            }
+        };
+
+        static void speculate(Chunk& chunk);
+        // 从 at 开始按给定状态串行分析，直到下一个 token 不在 to 之前
+        static const char* resume(Lexer& lexer, const char* at, const char* to);
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_PARALLEL_HH_
@@ -0,0 +1,95 @@
+#ifndef _FLANER_PARSER_PARSER_HH_
+#define _FLANER_PARSER_PARSER_HH_
+
+#include <ast.hh>
+#include <string>
+
+namespace flaner
+{
+namespace parser
+{
+    // 在 Lexer 的 token 序列上做语法分析，结果放进 Ast。
+    // 表达式用优先级爬升：每个二元运算符查一次表得到优先级和结合性。
+    // 向前最多看一个 token；箭头函数的参数表由 Lexer 记录的配对括号一步判断。
+    // 语句之间的 ; 可以省略，换行不影响分析
+    class Parser
+    {
+    public:
+        // 从 lexer 的游标处开始分析，分析时游标随之前进
+        Parser(lexer::Lexer& lexer, Ast& ast);
+        Parser(const Parser&) = delete;
+
+        // 分析到输入结束，返回 Program 结点并设为 ast 的根
+        NodeId parseProgram();
+        NodeId parseStatement();
+        NodeId parseExpression();
+
+        struct ParseError
+        {
+            std::string info;
+            // 出错的 token 的位置，从 1 开始
+            size_t line, column;
+            ParseError(std::string s, size_t a, size_t b)
+                : info("(from Parser) " + s),
+                line(a), column(b)
+            {
+            }
+        };
+
+    private:
+        // 嵌套过深的输入报错，而不是耗尽栈
+        static constexpr unsigned maxDepth = 1000;
+
+        // 列表的首尾，追加时只改尾结点的 next
+        struct List
+        {
+            NodeId first = none;
+            NodeId last = none;
+        };
+        void append(List& list, NodeId id);
+
+        TokenType peek();
+        uint32_t index() const;
+        uint32_t advance();
+        bool accept(TokenType type);
+        uint32_t expect(TokenType type, const char* what);
+        uint32_t expectName(const char* what);
+        // 当前 token 能否开始一个表达式，用于判断 return 等之后是否跟着值
+        bool startsExpression();
+        [[noreturn]] void error(const std::string& info);
+        [[noreturn]] void errorAt(uint32_t token, const std::string& info);
+        [[noreturn]] void unexpected();
+
+        NodeId block();
+        NodeId declaration();
+        NodeId ifStatement();
+        NodeId switchStatement();
+        NodeId whileStatement();
+        NodeId doWhileStatement();
+        NodeId forStatement();
+        NodeId importDeclaration();
+        NodeId exportDeclaration();
+        NodeId classDeclaration();
+        // 以 , 分隔、以 close 结束的表达式列表，元素可以是 ...x
+        NodeId elements(TokenType close);
+
+        NodeId expression(unsigned precedence);
+        NodeId prefix();
+        NodeId postfix(NodeId left);
+        NodeId templateLiteral();
+        NodeId objectLiteral();
+        // 以 ( 开始：括号中的表达式，或箭头函数
+        NodeId parenthesized();
+        // 当前 token 是 =>，之后是函数体
+        NodeId arrow(NodeId parameters);
+        // ( 之后的参数表，直到并包括 )
+        NodeId parameters();
+
+        lexer::Lexer& lexer;
+        Ast& ast;
+        unsigned depth;
+    };
+}
+}
+
+#endif // !_FLANER_PARSER_PARSER_HH_
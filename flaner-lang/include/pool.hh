@@ -0,0 +1,61 @@
+#ifndef _FLANER_LEXER_POOL_HH_
+#define _FLANER_LEXER_POOL_HH_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 工作窃取线程池。每个线程有自己的任务队列，从队尾取任务；
+    // 自己的队列空了就从别的队列队首窃取，耗时不均的任务也能分摊开
+    class ThreadPool
+    {
+    public:
+        // threads 为 0 时使用硬件线程数，调用 parallelFor 的线程也算一个
+        explicit ThreadPool(unsigned threads = 0);
+        ThreadPool(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+        // 并行执行 f(0) 到 f(n - 1)，全部完成后返回。
+        // 任务抛出的第一个异常会在全部任务结束后重新抛出
+        void parallelFor(size_t n, const std::function<void(size_t)>& f);
+
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<size_t> items;
+        };
+
+        void work(unsigned self);
+        bool runOne(unsigned self);
+
+        std::vector<std::thread> workers;
+        // 最后一个队列属于调用 parallelFor 的线程
+        std::vector<std::unique_ptr<Queue>> queues;
+
+        const std::function<void(size_t)>* job;
+        std::atomic<size_t> remaining;
+        std::exception_ptr failure;
+
+        std::mutex mutex;
+        std::condition_variable wake, done;
+        unsigned long long generation;
+        unsigned active;
+        bool stopping;
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_POOL_HH_
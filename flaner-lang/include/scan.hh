@@ -0,0 +1,54 @@
+#ifndef _FLANER_LEXER_SCAN_HH_
+#define _FLANER_LEXER_SCAN_HH_
+
+#include <cstddef>
+
+namespace flaner
+{
+namespace lexer
+{
+namespace scan
+{
+    // 成段扫描源码的内核。每个函数都返回第一个不属于该段的位置，到达 end 时返回 end
+    struct Kernels
+    {
+        const char* name;
+        // 跳过 ASCII 空白：\t \n \v \f \r 和空格
+        const char* (*skipAsciiBlank)(const char* p, const char* end);
+        // 跳过 [A-Za-z0-9_$]
+        const char* (*skipIdentifier)(const char* p, const char* end);
+        // 字符串内部：找下一个 mark、反斜杠、\r 或 \n
+        const char* (*findStringSpecial)(const char* p, const char* end, char mark);
+        // 模板字符串内部：找下一个 `、反斜杠或 $
+        const char* (*findTemplateSpecial)(const char* p, const char* end);
+        // 跳过合法的 UTF-8，返回第一个非法或被 end 截断的序列的起点。整块都是 ASCII 时不逐字节解码
+        const char* (*skipUtf8)(const char* p, const char* end);
+    };
+
+    // 按 CPU 支持的指令集（AVX2、SSE2 或纯标量）选出的实现，第一次调用时确定
+    const Kernels& kernels();
+    const Kernels& scalarKernels();
+
+    // p 处若是 Unicode 空白（U+00A0、U+2000 至 U+200B、U+2028、U+2029、U+3000），
+    // 返回它的 UTF-8 字节数，否则返回 0
+    size_t unicodeBlank(const char* p, const char* end);
+
+    inline const char* skipBlank(const char* p, const char* end)
+    {
+        const Kernels& k = kernels();
+        while (true)
+        {
+            p = k.skipAsciiBlank(p, end);
+            size_t n = p < end ? unicodeBlank(p, end) : 0;
+            if (n == 0)
+            {
+                return p;
+            }
+            p += n;
+        }
+    }
+}
+}
+}
+
+#endif // !_FLANER_LEXER_SCAN_HH_
@@ -0,0 +1,122 @@
+#ifndef _FLANER_LEXER_STATS_HH_
+#define _FLANER_LEXER_STATS_HH_
+
+#include <token.hh>
+#include <chrono>
+#include <string>
+
+// 编译时定义 FLANER_LEXER_STATS=1 开启词法分析器内部的统计，
+// 否则 FLANER_STATS(...) 展开为空，热路径上没有任何额外代码
+#ifndef FLANER_LEXER_STATS
+#define FLANER_LEXER_STATS 0
+#endif
+
+#if FLANER_LEXER_STATS
+#define FLANER_STATS(...) __VA_ARGS__
+#else
+#define FLANER_STATS(...)
+#endif
+
+namespace flaner
+{
+namespace lexer
+{
+namespace stats
+{
+    // step() 的分支，按 token 的第一个字符划分
+    enum class Branch
+    {
+        Blank,
+        Number,
+        Identifier,
+        String,
+        Template,
+        Operator,
+        Count,
+    };
+
+    enum class Phase
+    {
+        Open,
+        Read,
+        Decode,
+        Lex,
+        Parse,
+        Compile,
+        Run,
+        Dump,
+        Count,
+    };
+
+    struct Stats
+    {
+        uint64_t tokens[tokenTypeCount] = {};
+        uint64_t branchBytes[static_cast<size_t>(Branch::Count)] = {};
+
+        // Context 上逐字符的读取、直接移动 cursor 的次数，以及回看前一个字符的次数
+        uint64_t streamCalls = 0;
+        uint64_t seeks = 0;
+        uint64_t ungets = 0;
+
+        double phaseSeconds[static_cast<size_t>(Phase::Count)] = {};
+
+        void merge(const Stats& s);
+        std::string toJson() const;
+    };
+
+    // 当前线程的统计
+    Stats& local();
+    // 所有线程（包括已退出的线程）的统计之和，调用时其他线程不应在分析
+    Stats total();
+    constexpr bool enabled() { return FLANER_LEXER_STATS != 0; }
+
+    // 记录一个阶段的耗时，Trace 开启时同时记下一个事件
+    class PhaseTimer
+    {
+    public:
+        explicit PhaseTimer(Phase phase);
+        PhaseTimer(const PhaseTimer&) = delete;
+        ~PhaseTimer();
+
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // 离开作用域时把 [from, cursor) 的字节数记到分支上
+    class BranchScope
+    {
+    public:
+        BranchScope(Branch branch, const char* from, const char* const& cursor)
+            : branch(branch), from(from), cursor(cursor)
+        {
+        }
+        ~BranchScope()
+        {
+            local().branchBytes[static_cast<size_t>(branch)] += static_cast<uint64_t>(cursor - from);
+        }
+
+    private:
+        Branch branch;
+        const char* from;
+        const char* const& cursor;
+    };
+
+    // Chrome trace_event 格式的事件记录，写出的文件可以在 chrome://tracing 或 Perfetto 中打开。
+    // 不受 FLANER_LEXER_STATS 影响，驱动程序可以总是记录每个文件的耗时
+    class Trace
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static void start();
+        static bool active();
+        // 记录一个完整的事件（ph 为 X），detail 放在 args 中
+        static void complete(const char* name, const std::string& detail, Clock::time_point begin, Clock::time_point end);
+        static bool write(const std::string& path);
+    };
+}
+}
+}
+
+#endif // !_FLANER_LEXER_STATS_HH_
@@ -0,0 +1,82 @@
+#ifndef _FLANER_LEXER_STREAM_HH_
+#define _FLANER_LEXER_STREAM_HH_
+
+#include <lexer.hh>
+#include <cstdio>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 按需拉取 token 的词法分析器。
+    // 源码通过一个滑动窗口读入，token 放在固定容量的环形缓冲区里，
+    // 内存占用与文件大小无关，读到第一个 token 就可以开始消费
+    class StreamLexer
+    {
+    public:
+        struct Options
+        {
+            // 源码窗口的初始大小，单个 token 比它大时窗口会扩大
+            size_t window = 1 << 16;
+            // 最多可以向前查看的 token 数，即 peek() 和 tryFinding() 的范围
+            size_t lookahead = 256;
+            // 与 Lexer::Options 的同名选项相同
+            bool desugarTemplates = false;
+        };
+
+        using TokenType = Lexer::TokenType;
+        using TokenView = Lexer::TokenView;
+
+        StreamLexer(std::string path);
+        StreamLexer(std::string path, Options options);
+        StreamLexer(std::FILE* file);
+        StreamLexer(std::FILE* file, Options options);
+        StreamLexer(const StreamLexer&) = delete;
+        ~StreamLexer();
+
+        // 消费并返回下一个 token，结束后返回 END_OF_FILE。
+        // 窗口滑动时源码会被移动，返回的文本只在下一次调用本类的成员函数之前有效
+        TokenView next();
+        // 查看之后第 k 个 token 而不消费，k 从 0 开始，不能超过 lookahead
+        TokenView peek(size_t k = 0);
+        bool isEnd();
+        // 当前 token（上一次 next() 返回的）是数字字面量时，解码后的值
+        Number number() const;
+
+        // 与 Lexer 的同名函数相同，从当前 token 开始，只在 lookahead 个 token 之内查找
+        size_t tryFindingAfter(TokenSet patterns, TokenType t1, TokenType t2);
+        size_t tryFinding(TokenSet patterns, TokenType t);
+
+    private:
+        bool fill(size_t n);
+        const Token& at(size_t k) const;
+        bool lexMore();
+        bool readMore();
+        void compact();
+        void rebase(size_t position);
+        TokenView view(const Token& t) const;
+
+        Options options;
+        std::FILE* file;
+        bool ownsFile;
+        bool eof;
+
+        // 源码窗口，window[0] 对应输入中的 windowBase
+        std::vector<char> window;
+        size_t filled;
+        uint64_t windowBase;
+        // window 中已确认是合法 UTF-8 的字节数
+        size_t checked;
+
+        // 实际做词法分析的 Lexer，它的 context 指向窗口
+        Lexer core;
+
+        // 环形缓冲区，ring[head] 是当前 token，其后 count - 1 个是尚未消费的 token
+        std::vector<Token> ring;
+        size_t head, count;
+        bool started;
+    };
+}
+}
+
+#endif // !_FLANER_LEXER_STREAM_HH_
@@ -0,0 +1,318 @@
+#ifndef _FLANER_LEXER_TOKEN_HH_
+#define _FLANER_LEXER_TOKEN_HH_
+
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace flaner
+{
+namespace lexer
+{
+    enum class TokenType : uint16_t
+    {
+        UNKNOWN,
+        END_OF_FILE,
+
+        KEYWORD_NONE,
+        KEYWORD_TRUE,
+        KEYWORD_FALSE,
+        NUMBER,
+        STRING,
+        BIGINT,
+        RATIONAL,
+
+        IDENTIFIER,
+
+        KEYWORD_IF,
+        KEYWORD_ELSE,
+        KEYWORD_SWITCH,
+        KEYWORD_CASE,
+        KEYWORD_DEFAULT,
+        KEYWORD_WHILE,
+        KEYWORD_DO,
+        KEYWORD_FOR,
+        KEYWORD_IN,
+        KEYWORD_OF,
+        KEYWORD_BREAK,
+        KEYWORD_CONTINUE,
+        KEYWORD_RETURN,
+        KEYWORD_THROW,
+        KEYWORD_YIELD,
+
+        KEYWORD_LET,
+        KEYWORD_CONST,
+        KEYWORD_CLASS,
+        KEYWORD_IMPORT,
+        KEYWORD_EXPORT,
+        KEYWORD_FROM,
+        KEYWORD_AS,
+
+        FUNCTION_ARROW,
+
+        OP_ADD,
+        OP_MINUS,
+        OP_MUL,
+        OP_INTDIV,
+        OP_DIV,
+        OP_MOD,
+        OP_QUOTE,
+        OP_POW,
+
+        OP_ADD_ASSIGN,
+        OP_MINUS_ASSIGN,
+        OP_MUL_ASSIGN,
+        OP_INTDIV_ASSIGN,
+        OP_DIV_ASSIGN,
+        OP_MOD_ASSIGN,
+        OP_QUOTE_ASSIGN,
+        OP_POW_ASSIGN,
+
+        OP_LOGIC_NEGATE,
+        OP_LOGIC_OR,
+        OP_LOGIC_AND,
+
+        OP_BIT_NEGATE,
+        OP_BIT_OR,
+        OP_BIT_AND,
+        OP_BIT_XOR,
+
+        OP_BIT_OR_ASSIGN,
+        OP_BIT_AND_ASSIGN,
+        OP_BIT_XOR_ASSIGN,
+
+        OP_SHIFT_LEFT,
+        OP_SHIFT_RIGHT,
+        OP_SHIFT_LEFT_ASSIGN,
+        OP_SHIFT_RIGHT_ASSIGN,
+
+        OP_LESS_THAN,
+        OP_GREATER_THAN,
+        OP_LESS_EQUAL,
+        OP_GREATER_EQUAL,
+        OP_EQUAL,
+        OP_NOT_EQUAL,
+
+        OP_ASSIGN,
+        OP_COLON,
+        OP_QUESTION,
+        OP_COMMA,
+        OP_DOT,
+        OP_DOT_DOT,
+        OP_DOT_DOT_DOT,
+
+        OP_PAREN_BEGIN,
+        OP_PAREN_END,
+        OP_BRACKET_BEGIN,
+        OP_BRACKET_END,
+        OP_BRACE_BEGIN,
+        OP_BRACE_END,
+
+        OP_SEMICOLON,
+
+        // 含有 ${ ... } 的模板字符串按段给出，`a ${x} b ${y} c` 即
+        // TEMPLATE_HEAD x TEMPLATE_MIDDLE y TEMPLATE_TAIL，各段的文本是 "a "、" b "、" c"。
+        // 段的文本与字符串字面量一样引用源码或 payload，拼接前就能算出结果的长度
+        TEMPLATE_HEAD,
+        TEMPLATE_MIDDLE,
+        TEMPLATE_TAIL,
+
+    };
+
+    // 新增的类型放在枚举末尾，并让这里指向最后一个
+    constexpr size_t tokenTypeCount = static_cast<size_t>(TokenType::TEMPLATE_TAIL) + 1;
+
+    // token 类型的集合，128 位的位图，可以在编译期构造。
+    // 查询和合并都只是位运算，tryFinding() 等向前查看的模式不必分配内存
+    class TokenSet
+    {
+    public:
+        constexpr TokenSet() : bits{ 0, 0 } {}
+        constexpr TokenSet(TokenType t) : bits{ 0, 0 }
+        {
+            bits[index(t) / 64] = uint64_t(1) << (index(t) % 64);
+        }
+
+        constexpr bool contains(TokenType t) const
+        {
+            return index(t) < 128 && (bits[index(t) / 64] >> (index(t) % 64) & 1) != 0;
+        }
+        constexpr bool empty() const { return (bits[0] | bits[1]) == 0; }
+
+        constexpr TokenSet& operator|=(TokenSet s)
+        {
+            bits[0] |= s.bits[0];
+            bits[1] |= s.bits[1];
+            return *this;
+        }
+        constexpr TokenSet operator|(TokenSet s) const
+        {
+            return TokenSet(*this) |= s;
+        }
+        constexpr bool operator==(TokenSet s) const
+        {
+            return bits[0] == s.bits[0] && bits[1] == s.bits[1];
+        }
+
+    private:
+        static constexpr size_t index(TokenType t) { return static_cast<size_t>(t); }
+
+        uint64_t bits[2];
+    };
+
+    static_assert(tokenTypeCount <= 128, "TokenSet holds at most 128 token types");
+
+    constexpr TokenSet operator|(TokenType t1, TokenType t2)
+    {
+        return TokenSet(t1) | t2;
+    }
+
+    // 紧凑的 token：只记录类型和它在源码中的位置，共 16 字节。
+    // 文本由 Lexer 按需取出，只有含转义的字符串才把解码后的内容放进 payload
+    struct Token
+    {
+        // 文本位于 Lexer 的 payload 中，而不是源码中
+        static constexpr uint16_t Payload = 1;
+        // 源码中没有对应的文本（如模板字符串展开出的 + ( )），文本即类型的固定写法
+        static constexpr uint16_t Synthetic = 2;
+        // 数字字面量的值存放在 payload 中，attribute 是记录的偏移
+        static constexpr uint16_t Spilled = 4;
+
+        TokenType type;
+        uint16_t flags;
+        uint32_t offset;
+        uint32_t length;
+        // 标识符和字符串字面量：在 Interner 中的编号，未驻留时为 0；
+        // 数字字面量：小于 2^32 的整数本身，带 Spilled 时为 payload 中记录的偏移；
+        // ( [ {：与之配对的右括号在序列中的下标，没有配对时为 0
+        uint32_t attribute = 0;
+
+        bool operator==(TokenType t) const
+        {
+            return type == t;
+        }
+        operator TokenType() const
+        {
+            return type;
+        }
+    };
+
+    static_assert(sizeof(Token) == 16, "Token is meant to stay 16 bytes");
+
+    // 交给调用者的 token，value 引用源码或 payload，不做拷贝
+    struct TokenView
+    {
+        TokenType type;
+        std::string_view value;
+        // 标识符和字符串字面量在 Interner 中的编号
+        uint32_t symbol = 0;
+
+        bool operator==(TokenType t) const
+        {
+            return type == t;
+        }
+        bool operator==(std::string_view s) const
+        {
+            return value == s;
+        }
+        operator TokenType() const
+        {
+            return type;
+        }
+    };
+
+    // 按列存放的 token 序列。
+    // 类型单独存成紧凑的 uint16_t 数组，只比较类型的扫描不会触及位置信息，
+    // 可以一次比较一整个向量寄存器的 token。
+    // 各列从构造时给出的 memory_resource 分配
+    class TokenStream
+    {
+    public:
+        explicit TokenStream(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : types(resource), flags(resource), offsets(resource), lengths(resource), attributes(resource)
+        {
+        }
+
+        std::pmr::memory_resource* resource() const { return types.get_allocator().resource(); }
+
+        size_t size() const { return types.size(); }
+        bool empty() const { return types.empty(); }
+
+        TokenType type(size_t i) const { return static_cast<TokenType>(types[i]); }
+        Token operator[](size_t i) const
+        {
+            return { static_cast<TokenType>(types[i]), flags[i], offsets[i], lengths[i], attributes[i] };
+        }
+        Token back() const { return (*this)[size() - 1]; }
+
+        void push_back(const Token& t)
+        {
+            types.push_back(static_cast<uint16_t>(t.type));
+            flags.push_back(t.flags);
+            offsets.push_back(t.offset);
+            lengths.push_back(t.length);
+            attributes.push_back(t.attribute);
+        }
+        void pop_back()
+        {
+            types.pop_back();
+            flags.pop_back();
+            offsets.pop_back();
+            lengths.pop_back();
+            attributes.pop_back();
+        }
+        void clear()
+        {
+            types.clear();
+            flags.clear();
+            offsets.clear();
+            lengths.clear();
+            attributes.clear();
+        }
+        void reserve(size_t n)
+        {
+            types.reserve(n);
+            flags.reserve(n);
+            offsets.reserve(n);
+            lengths.reserve(n);
+            attributes.reserve(n);
+        }
+
+        // 用 s 中的 token 替换 [from, to)
+        void splice(size_t from, size_t to, const TokenStream& s)
+        {
+            auto column = [&](auto& v, const auto& w) {
+                v.erase(v.begin() + from, v.begin() + to);
+                v.insert(v.begin() + from, w.begin(), w.end());
+            };
+            column(types, s.types);
+            column(flags, s.flags);
+            column(offsets, s.offsets);
+            column(lengths, s.lengths);
+            column(attributes, s.attributes);
+        }
+
+        // 在 [from, to) 中找第一个类型为 t 的 token，找不到时返回 to
+        size_t find(TokenType t, size_t from, size_t to) const;
+
+        // 为每个 ( [ { 记下配对的右括号的下标，存进它的 attribute。
+        // 只扫描一遍类型列；序列整体生成或拼接之后调用一次
+        void matchBrackets();
+        // 左括号 i 配对的右括号的下标，没有配对时为 0
+        size_t closerOf(size_t i) const { return attributes[i]; }
+
+    public:
+        std::pmr::vector<uint16_t> types;
+        std::pmr::vector<uint16_t> flags;
+        std::pmr::vector<uint32_t> offsets;
+        std::pmr::vector<uint32_t> lengths;
+        std::pmr::vector<uint32_t> attributes;
+    };
+
+    // 运算符、关键字等文本固定的 token 的写法，其余类型返回空串
+    std::string_view spellingOf(TokenType type);
+}
+}
+
+#endif // !_FLANER_LEXER_TOKEN_HH_
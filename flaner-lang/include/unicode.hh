@@ -0,0 +1,42 @@
+#ifndef _FLANER_LEXER_UNICODE_HH_
+#define _FLANER_LEXER_UNICODE_HH_
+
+#include <cstddef>
+#include <string>
+
+namespace flaner
+{
+namespace lexer
+{
+namespace unicode
+{
+    constexpr char32_t replacement = 0xfffd;
+    constexpr size_t npos = static_cast<size_t>(-1);
+
+    // p 处完整、合法的 UTF-8 序列的字节数，码点存入 c；
+    // 过长编码、代理码点、超出 U+10FFFF 或被 end 截断时返回 0
+    size_t decode(const char* p, const char* end, char32_t& c);
+    void encode(std::string& s, char32_t c);
+
+    // 去掉末尾被截断的多字节序列后的结尾，用于校验还没读完的输入
+    const char* completePrefix(const char* p, const char* end);
+
+    // 标识符的首字符和后续字符：ASCII 之外按 Unicode 的 XID_Start 和 XID_Continue，
+    // 后续字符另外允许 U+200C 和 U+200D
+    bool isIdentifierStart(char32_t c);
+    bool isIdentifierPart(char32_t c);
+
+    // p 处的 UTF-8 序列可以开始或延续标识符时返回它的字节数，否则返回 0
+    size_t identifierStart(const char* p, const char* end);
+    size_t identifierPart(const char* p, const char* end);
+
+    // 把 n 字节的 UTF-16 或 UTF-32 转成 UTF-8 追加到 out。
+    // 不成对的代理、超出范围的码点和末尾多余的字节换成 U+FFFD，
+    // 返回第一处替换在 out 中的位置，没有时返回 npos
+    size_t fromUtf16(const char* p, size_t n, bool bigEndian, std::string& out);
+    size_t fromUtf32(const char* p, size_t n, bool bigEndian, std::string& out);
+}
+}
+}
+
+#endif // !_FLANER_LEXER_UNICODE_HH_
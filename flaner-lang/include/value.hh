@@ -0,0 +1,186 @@
+#ifndef _FLANER_VM_VALUE_HH_
+#define _FLANER_VM_VALUE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace flaner
+{
+namespace vm
+{
+    class VM;
+    struct Proto;
+
+    enum class Type : uint8_t
+    {
+        None,
+        Bool,
+        Number,
+        String,
+        Array,
+        Table,
+        Function,
+        Native,
+        // 只在堆上，不会出现在 Value 中
+        Upvalue,
+    };
+
+    // 堆上对象的公共头部。VM 分配的对象串成一条链表，由标记清除回收；
+    // 常量表中的字符串属于 Program，不在链表中
+    struct Object
+    {
+        Type type;
+        bool marked = false;
+        Object* next = nullptr;
+
+        explicit Object(Type t) : type(t) {}
+        Object(const Object&) = delete;
+        virtual ~Object() = default;
+    };
+
+    // 16 字节的值，数字都是 double
+    struct Value
+    {
+        Type type;
+        union
+        {
+            bool boolean;
+            double number;
+            Object* object;
+        };
+
+        Value() : type(Type::None), number(0) {}
+
+        static Value fromBool(bool b)
+        {
+            Value v;
+            v.type = Type::Bool;
+            v.boolean = b;
+            return v;
+        }
+        static Value fromNumber(double n)
+        {
+            Value v;
+            v.type = Type::Number;
+            v.number = n;
+            return v;
+        }
+        static Value fromObject(Object* o)
+        {
+            Value v;
+            v.type = o->type;
+            v.object = o;
+            return v;
+        }
+
+        bool isNone() const { return type == Type::None; }
+        bool isNumber() const { return type == Type::Number; }
+        bool isString() const { return type == Type::String; }
+        bool isObject() const { return type >= Type::String; }
+    };
+
+    struct String : Object
+    {
+        std::string value;
+
+        explicit String(std::string s) : Object(Type::String), value(std::move(s)) {}
+    };
+
+    struct Array : Object
+    {
+        std::vector<Value> items;
+
+        Array() : Object(Type::Array) {}
+    };
+
+    // 以字符串为键的表，按插入顺序保存，for-in 按此顺序遍历
+    struct Table : Object
+    {
+        std::vector<std::pair<String*, Value>> entries;
+        // 键引用 entries 中的 String，String 不会移动
+        std::unordered_map<std::string_view, uint32_t> slots;
+
+        Table() : Object(Type::Table) {}
+
+        Value* find(std::string_view key)
+        {
+            auto it = slots.find(key);
+            return it == slots.end() ? nullptr : &entries[it->second].second;
+        }
+        void set(String* key, Value value)
+        {
+            auto [it, added] = slots.emplace(key->value, static_cast<uint32_t>(entries.size()));
+            if (added)
+            {
+                entries.emplace_back(key, value);
+            }
+            else
+            {
+                entries[it->second].second = value;
+            }
+        }
+    };
+
+    // 函数捕获的变量。变量所在的函数仍在运行时指向寄存器，返回或离开作用域后把值搬进 closed
+    struct Upvalue : Object
+    {
+        Value* location;
+        Value closed;
+        // 仍指向寄存器的 Upvalue 按寄存器地址从高到低串起来
+        Upvalue* nextOpen = nullptr;
+
+        explicit Upvalue(Value* slot) : Object(Type::Upvalue), location(slot) {}
+    };
+
+    struct Closure : Object
+    {
+        const Proto* proto;
+        std::vector<Upvalue*> upvalues;
+
+        explicit Closure(const Proto* p) : Object(Type::Function), proto(p) {}
+    };
+
+    // 内建函数，参数在 args 中，返回值即调用的结果
+    using NativeFunction = Value (*)(VM& vm, Value* args, size_t count);
+
+    struct Native : Object
+    {
+        const char* name;
+        NativeFunction function;
+
+        Native(const char* n, NativeFunction f) : Object(Type::Native), name(n), function(f) {}
+    };
+
+    // none、false、0、NaN 和空串为假，其余为真
+    inline bool truthy(const Value& v)
+    {
+        switch (v.type)
+        {
+        case Type::None:
+            return false;
+        case Type::Bool:
+            return v.boolean;
+        case Type::Number:
+            return v.number == v.number && v.number != 0;
+        case Type::String:
+            return !static_cast<String*>(v.object)->value.empty();
+        default:
+            return true;
+        }
+    }
+
+    // 数字按值、字符串按内容比较，其余对象比较是否为同一个
+    bool equals(const Value& a, const Value& b);
+    const char* typeName(Type type);
+    // print 和字符串拼接使用的文本
+    void appendTo(std::string& out, const Value& v);
+    std::string toString(const Value& v);
+}
+}
+
+#endif // !_FLANER_VM_VALUE_HH_
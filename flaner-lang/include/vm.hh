@@ -0,0 +1,114 @@
+#ifndef _FLANER_VM_VM_HH_
+#define _FLANER_VM_VM_HH_
+
+#include <bytecode.hh>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace flaner
+{
+namespace vm
+{
+    // 运行 Compiler 产生的字节码。
+    // 寄存器是一整块预先分配的栈上的窗口，调用时被调用者的窗口从实参处开始，不复制参数；
+    // GCC 和 Clang 下以 computed goto 分发指令，定义 FLANER_VM_SWITCH 时退回到 switch
+    class VM
+    {
+    public:
+        VM();
+        VM(const VM&) = delete;
+        VM& operator=(const VM&) = delete;
+        ~VM();
+
+        // 内建变量的名字，按槽位排列，交给 Compiler
+        const std::vector<std::string>& globalNames() const { return names; }
+        // 增加一个内建函数，须在编译之前
+        void define(const char* name, NativeFunction function);
+
+        // 运行 program 的顶层代码，返回它的返回值。program 须比返回值活得长
+        Value run(const Program& program);
+
+        // 供内建函数分配对象
+        String* newString(std::string value);
+        Array* newArray();
+        // 以当前指令的行号报告运行时错误
+        [[noreturn]] void error(const std::string& info) const;
+
+        struct RuntimeError
+        {
+            std::string info;
+            size_t line;
+            RuntimeError(std::string s, size_t a)
+                : info("(from VM) " + s),
+                line(a)
+            {
+            }
+        };
+
+    private:
+        static constexpr size_t stackSize = size_t(1) << 18;
+        static constexpr size_t maxFrames = 10000;
+        static constexpr size_t initialThreshold = size_t(1) << 20;
+
+        struct Frame
+        {
+            Closure* closure;
+            // 下一条指令，只在调用和可能报错、回收之前写回
+            const Instruction* pc;
+            Value* base;
+        };
+
+        template <typename T, typename... Args>
+        T* allocate(size_t extra, Args&&... args)
+        {
+            T* object = new T(std::forward<Args>(args)...);
+            object->next = objects;
+            objects = object;
+            allocated += sizeof(T) + extra;
+            return object;
+        }
+
+        Value execute();
+        Upvalue* capture(Value* slot);
+        void close(Value* level);
+
+        // 分配较多的指令在开始前调用，此时所有活着的值都在根中
+        void collectIfNeeded()
+        {
+            if (allocated > threshold)
+            {
+                collect();
+            }
+        }
+        void collect();
+        void mark(Object* object);
+        void mark(const Value& v)
+        {
+            if (v.isObject())
+            {
+                mark(v.object);
+            }
+        }
+        static size_t sizeOf(const Object* object);
+
+        // 数字快速路径之外的算术：字符串拼接，或报告类型错误
+        void arithmetic(Opcode op, Value& dst, const Value& b, const Value& c);
+        bool less(const Value& b, const Value& c, bool orEqual) const;
+
+        std::vector<std::string> names;
+        std::vector<Value> globals;
+        std::unique_ptr<Value[]> stack;
+        std::vector<Frame> frames;
+        Upvalue* openUpvalues;
+
+        Object* objects;
+        std::vector<Object*> gray;
+        size_t allocated;
+        size_t threshold;
+    };
+}
+}
+
+#endif // !_FLANER_VM_VM_HH_
@@ -1,26 +1,327 @@
-﻿#include <lexer.hh>
-
-int main(int argc, char* argv[])
-{
-    using namespace flaner::lexer;
-    std::cout << "\nFlaner Programming Language.\n--------\n\n";
-
-    try
-    {
-        Lexer lexer{ std::string{ argv[1] } };
-
-        auto tokens = lexer.getSequence();
-        for (auto i : tokens)
-        {
-            if (i.type == Lexer::TokenType::STRING)
-            {
-                i.value = '"' + i.value + '"';
-            }
-            std::cout << "[type: " << static_cast<int>(i.type) << ", value: " << i.value << "]\n";
-        }
-    }
-    catch (const Lexer::LexError& e)
-    {
-        std::cout << "Error! " << e.info << "\nline " << e.line << ", offset " << e.offset << ".";
-    }
-}
+﻿#include <lexer.hh>
+#include <batch.hh>
+#include <interactive.hh>
+#include <parallel.hh>
+#include <dump.hh>
+#include <parser.hh>
+#include <compiler.hh>
+#include <vm.hh>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+
+// 分析结束后写出 --stats 指定的 JSON 报告和 --trace 指定的 Chrome trace 文件
+static void writeReports(const std::string& statsPath, const std::string& tracePath)
+{
+    using namespace flaner::lexer;
+
+    if (!statsPath.empty())
+    {
+        std::ofstream(statsPath) << stats::total().toJson() << '\n';
+    }
+    if (!tracePath.empty() && !stats::Trace::write(tracePath))
+    {
+        std::cerr << "cannot write " << tracePath << '\n';
+    }
+}
+
+// flaner-lang --batch [-j N] [--cache DIR] [--intern] [--recover] [--stats FILE] [--trace FILE] <path | @list>...
+// 并行分析多个文件，按参数顺序输出每个文件的 token 数、耗时和错误。
+// 给出 --cache 时内容未变的文件直接从缓存目录载入；
+// 给出 --intern 时所有文件共用一个驻留表，并报告不同的标识符和字符串的个数；
+// 给出 --recover 时出错的文件也分析到底，列出其中所有的错误
+static int batch(int argc, char* argv[])
+{
+    using namespace flaner::lexer;
+
+    unsigned threads = 0;
+    bool intern = false;
+    bool recover = false;
+    std::string cacheDirectory, statsPath, tracePath;
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc)
+        {
+            threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        }
+        else if (arg == "--cache" && i + 1 < argc)
+        {
+            cacheDirectory = argv[++i];
+        }
+        else if (arg == "--intern")
+        {
+            intern = true;
+        }
+        else if (arg == "--recover")
+        {
+            recover = true;
+        }
+        else if (arg == "--stats" && i + 1 < argc)
+        {
+            statsPath = argv[++i];
+        }
+        else if (arg == "--trace" && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (arg.size() > 1 && arg[0] == '@')
+        {
+            auto list = readFileList(arg.substr(1));
+            paths.insert(paths.end(), list.begin(), list.end());
+        }
+        else
+        {
+            paths.push_back(arg);
+        }
+    }
+
+    if (!tracePath.empty())
+    {
+        stats::Trace::start();
+    }
+    ThreadPool pool(threads);
+    std::unique_ptr<TokenCache> cache;
+    if (!cacheDirectory.empty())
+    {
+        cache = std::make_unique<TokenCache>(cacheDirectory);
+    }
+    std::unique_ptr<Interner> interner;
+    if (intern)
+    {
+        interner = std::make_unique<Interner>();
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto reports = lexFiles(paths, pool, cache.get(), interner.get(), recover);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t tokens = 0, bytes = 0, failed = 0, errors = 0;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto& r : reports)
+    {
+        std::cout << r.path << ": ";
+        if (r.ok)
+        {
+            std::cout << r.tokens << " tokens, " << r.bytes << " bytes, " << r.seconds * 1000 << " ms\n";
+        }
+        else if (r.errors.size() == 1)
+        {
+            const auto& e = r.errors.front();
+            std::cout << "Error! " << e.info << " (line " << e.line << ", column " << e.column << ")\n";
+            failed += 1;
+        }
+        else
+        {
+            std::cout << r.errors.size() << " errors\n";
+            for (const auto& e : r.errors)
+            {
+                std::cout << "    Error! " << e.info << " (line " << e.line << ", column " << e.column << ")\n";
+            }
+            failed += 1;
+        }
+        errors += r.errors.size();
+        tokens += r.tokens;
+        bytes += r.bytes;
+    }
+    std::cout << "--------\n" << reports.size() << " files, " << failed << " failed, " << errors << " errors, "
+        << tokens << " tokens, " << bytes << " bytes, " << wall * 1000 << " ms on "
+        << pool.size() << " threads\n";
+    if (cache)
+    {
+        std::cout << "cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+    }
+    if (interner)
+    {
+        std::cout << "symbols: " << interner->size() << '\n';
+    }
+    writeReports(statsPath, tracePath);
+    return failed == 0 ? 0 : 1;
+}
+
+// flaner-lang --repl
+// 逐行读入标准输入，每读完一行立即输出其中的 token；输入还不完整时提示符变为 "..."
+static int repl()
+{
+    using namespace flaner::lexer;
+
+    InteractiveLexer lexer;
+    Dumper dumper(stdout, DumpFormat::Text);
+    std::string line;
+    std::cout << "> " << std::flush;
+    while (std::getline(std::cin, line))
+    {
+        try
+        {
+            lexer.feed(line);
+            for (size_t i = 0; i < lexer.size(); ++i)
+            {
+                dumper.write(lexer[i]);
+            }
+            dumper.flush();
+        }
+        catch (const Lexer::LexError& e)
+        {
+            std::cout << "Error! " << e.info << " (line " << e.line << ", column " << e.column << ")\n";
+        }
+        std::cout << (lexer.needsMore() ? "... " : "> ") << std::flush;
+    }
+    std::cout << '\n';
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace flaner::lexer;
+
+    if (argc > 1 && std::string(argv[1]) == "--batch")
+    {
+        return batch(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--repl")
+    {
+        return repl();
+    }
+
+    // flaner-lang [--parallel] [--desugar-templates] [--recover] [--ast | --bytecode | --run] [--format text|json|binary] [--stats FILE] [--trace FILE] <path>
+    // --parallel 把大文件分块并行分析，输出与串行相同；
+    // --desugar-templates 把模板字符串展开成 STRING + ( ... ) + STRING，与旧版本的输出相同；
+    // --recover 遇到词法错误时继续分析，输出 token 之后列出所有的错误；
+    // --ast 继续做语法分析，输出语法树而不是 token；
+    // --bytecode 编译成字节码并列出指令，--run 编译后运行
+    bool parallel = false;
+    bool ast = false;
+    bool bytecode = false;
+    bool run = false;
+    Lexer::Options options;
+    DumpFormat format = DumpFormat::Text;
+    std::string path, statsPath, tracePath;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--parallel")
+        {
+            parallel = true;
+        }
+        else if (arg == "--ast")
+        {
+            ast = true;
+        }
+        else if (arg == "--bytecode")
+        {
+            bytecode = true;
+        }
+        else if (arg == "--run")
+        {
+            run = true;
+        }
+        else if (arg == "--desugar-templates")
+        {
+            options.desugarTemplates = true;
+        }
+        else if (arg == "--recover")
+        {
+            options.recover = true;
+        }
+        else if (arg == "--format" && i + 1 < argc && parseDumpFormat(argv[i + 1], format))
+        {
+            ++i;
+        }
+        else if (arg == "--stats" && i + 1 < argc)
+        {
+            statsPath = argv[++i];
+        }
+        else if (arg == "--trace" && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+            stats::Trace::start();
+        }
+        else
+        {
+            path = arg;
+        }
+    }
+
+    if (format == DumpFormat::Text && !run)
+    {
+        std::cout << "\nFlaner Programming Language.\n--------\n\n" << std::flush;
+    }
+
+    int status = 0;
+    try
+    {
+        ThreadPool pool(parallel ? 0 : 1);
+        Lexer lexer = ParallelLexer::lex(io::Source(path), pool, 1 << 20, nullptr, options);
+
+        if (bytecode || run)
+        {
+            flaner::parser::Ast tree(lexer);
+            flaner::parser::Parser(lexer, tree).parseProgram();
+            flaner::vm::VM vm;
+            flaner::vm::Program program = flaner::vm::Compiler(tree, vm.globalNames()).compile();
+            if (bytecode)
+            {
+                std::string out;
+                program.main->disassemble(out);
+                std::cout << out;
+            }
+            else
+            {
+                vm.run(program);
+            }
+        }
+        else if (ast)
+        {
+            flaner::parser::Ast tree(lexer);
+            flaner::parser::Parser(lexer, tree).parseProgram();
+            std::string out;
+            tree.dump(out, tree.root());
+            std::cout << out;
+        }
+        else
+        {
+            Dumper dumper(stdout, format);
+            dumper.write(lexer);
+        }
+        for (const auto& d : lexer.getDiagnostics())
+        {
+            Lexer::LexError e = lexer.errorOf(d);
+            std::cerr << "Error! " << e.info << " (line " << e.line << ", column " << e.column << ")\n";
+        }
+    }
+    catch (const Lexer::LexError& e)
+    {
+        std::cout << "Error! " << e.info << "\nline " << e.line << ", column " << e.column << ".";
+        status = 1;
+    }
+    catch (const flaner::parser::Parser::ParseError& e)
+    {
+        std::cout << "Error! " << e.info << "\nline " << e.line << ", column " << e.column << ".";
+        status = 1;
+    }
+    catch (const flaner::vm::Compiler::CompileError& e)
+    {
+        std::cout << "Error! " << e.info << "\nline " << e.line << ", column " << e.column << ".";
+        status = 1;
+    }
+    catch (const flaner::vm::VM::RuntimeError& e)
+    {
+        std::cout << "Error! " << e.info << "\nline " << e.line << ".";
+        status = 1;
+    }
+    // 内存不足等其他异常（例如超长的输入），同样报错并返回非零值
+    catch (const std::bad_alloc&)
+    {
+        std::cout << "Error! out of memory.";
+        status = 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Error! " << e.what() << ".";
+        status = 1;
+    }
+    writeReports(statsPath, tracePath);
+    return status;
+}
@@ -0,0 +1,117 @@
+#include <arena.hh>
+#include <cstdint>
+
+namespace flaner
+{
+namespace lexer
+{
+    Arena::Arena(size_t size, std::pmr::memory_resource* up)
+        : upstream(up), blockSize(size ? size : 4096),
+        current(0), top(nullptr), limit(nullptr), usedBefore(0), last(nullptr)
+    {
+    }
+
+    Arena::~Arena()
+    {
+        release();
+    }
+
+    void Arena::reset()
+    {
+        current = 0;
+        top = blocks.empty() ? nullptr : blocks[0].data;
+        limit = blocks.empty() ? nullptr : blocks[0].data + blocks[0].size;
+        usedBefore = 0;
+        last = nullptr;
+    }
+
+    void Arena::release()
+    {
+        for (const Block& b : blocks)
+        {
+            upstream->deallocate(b.data, b.size, alignof(std::max_align_t));
+        }
+        blocks.clear();
+        reset();
+    }
+
+    size_t Arena::used() const
+    {
+        return blocks.empty() ? 0 : usedBefore + static_cast<size_t>(top - blocks[current].data);
+    }
+
+    size_t Arena::reserved() const
+    {
+        size_t total = 0;
+        for (const Block& b : blocks)
+        {
+            total += b.size;
+        }
+        return total;
+    }
+
+    static char* alignUp(char* p, size_t alignment)
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(p);
+        return p + ((alignment - address % alignment) % alignment);
+    }
+
+    void Arena::advance(size_t bytes, size_t alignment)
+    {
+        size_t needed = bytes + alignment;
+        if (!blocks.empty())
+        {
+            usedBefore += static_cast<size_t>(top - blocks[current].data);
+        }
+
+        // 先复用 reset() 之前申请的块，放不下的大块跳过
+        size_t next = blocks.empty() ? 0 : current + 1;
+        while (next < blocks.size() && blocks[next].size < needed)
+        {
+            ++next;
+        }
+        if (next == blocks.size())
+        {
+            // 块的大小随总量翻倍，token 很多时上游申请的次数是对数级的
+            size_t size = blocks.empty() ? blockSize : blocks.back().size * 2;
+            while (size < needed)
+            {
+                size *= 2;
+            }
+            char* data = static_cast<char*>(upstream->allocate(size, alignof(std::max_align_t)));
+            blocks.push_back({ data, size });
+        }
+        current = next;
+        top = blocks[current].data;
+        limit = top + blocks[current].size;
+    }
+
+    void* Arena::do_allocate(size_t bytes, size_t alignment)
+    {
+        char* p = alignUp(top, alignment);
+        if (top == nullptr || p + bytes > limit)
+        {
+            advance(bytes, alignment);
+            p = alignUp(top, alignment);
+        }
+        top = p + bytes;
+        last = p;
+        return p;
+    }
+
+    void Arena::do_deallocate(void* p, size_t bytes, size_t)
+    {
+        // vector 增长时新的缓冲区在旧的之后分配，能收回的通常只有临时对象
+        if (p == last && static_cast<char*>(p) + bytes == top)
+        {
+            top = static_cast<char*>(p);
+            last = nullptr;
+        }
+    }
+
+    bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+    {
+        return this == &other;
+    }
+}
+}
@@ -0,0 +1,98 @@
+#include <batch.hh>
+#include <arena.hh>
+#include <chrono>
+#include <fstream>
+
+namespace flaner
+{
+namespace lexer
+{
+    static FileReport lexFile(const std::string& path, TokenCache* cache, Interner* interner, bool recover)
+    {
+        // 每个线程一个 Arena，只统计 token 数，分析完一个文件就整体回收给下一个文件用
+        thread_local Arena arena;
+
+        FileReport report;
+        report.path = path;
+
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            io::Source source(path);
+            report.bytes = source.size();
+            if (source.size() == 0 && path != "-")
+            {
+                // Buffer::open 打不开文件时给出空的源码，这里区分真正的空文件
+                std::ifstream probe(path, std::ios::binary);
+                if (!probe)
+                {
+                    report.ok = false;
+                    report.errors.push_back({ "cannot open file" });
+                }
+            }
+            if (report.ok)
+            {
+                Lexer::Options options;
+                options.recover = recover;
+                Lexer lexer = cache ? cache->lex(source, &arena, interner, recover) : Lexer{ source, options, &arena, interner };
+                report.tokens = lexer.getStream().size();
+                for (const auto& d : lexer.getDiagnostics())
+                {
+                    Lexer::LexError e = lexer.errorOf(d);
+                    report.errors.push_back({ std::move(e.info), e.line, e.column });
+                }
+                report.ok = report.errors.empty();
+            }
+        }
+        catch (const Lexer::LexError& e)
+        {
+            report.ok = false;
+            report.errors.push_back({ e.info, e.line, e.column });
+        }
+        catch (const std::exception& e)
+        {
+            report.ok = false;
+            report.errors.push_back({ e.what() });
+        }
+        // 出错时 lexer 同样已经析构，Arena 中的内存都可以复用
+        arena.reset();
+        auto end = std::chrono::steady_clock::now();
+        report.seconds = std::chrono::duration<double>(end - start).count();
+        if (stats::Trace::active())
+        {
+            stats::Trace::complete("file", path, start, end);
+        }
+        return report;
+    }
+
+    std::vector<FileReport> lexFiles(const std::vector<std::string>& paths, ThreadPool& pool,
+        TokenCache* cache, Interner* interner, bool recover)
+    {
+        // 每个任务只写自己的那一格，不需要加锁
+        std::vector<FileReport> reports(paths.size());
+        pool.parallelFor(paths.size(), [&](size_t i) {
+            reports[i] = lexFile(paths[i], cache, interner, recover);
+        });
+        return reports;
+    }
+
+    std::vector<std::string> readFileList(const std::string& path)
+    {
+        std::vector<std::string> paths;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!line.empty())
+            {
+                paths.push_back(line);
+            }
+        }
+        return paths;
+    }
+}
+}
@@ -0,0 +1,334 @@
+#include <cache.hh>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <thread>
+
+namespace flaner
+{
+namespace lexer
+{
+    namespace fs = std::filesystem;
+
+    // 映像中每个 token 的字节数：type、flags 各 2 字节，offset、length、attribute 各 4 字节
+    static constexpr uint64_t bytesPerToken = 16;
+
+    static inline uint64_t load64(const char* p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint64_t mix(uint64_t h, uint64_t v)
+    {
+        h ^= v * 0x9E3779B97F4A7C15ull;
+        h = (h << 31 | h >> 33) * 0xBF58476D1CE4E5B9ull;
+        return h;
+    }
+
+    uint64_t contentHash(const char* data, size_t size)
+    {
+        // 两路交替处理 8 字节的块，减少乘法之间的依赖
+        uint64_t a = 0x243F6A8885A308D3ull ^ size, b = 0x13198A2E03707344ull;
+        const char* p = data;
+        const char* end = data + size;
+        for (; end - p >= 16; p += 16)
+        {
+            a = mix(a, load64(p));
+            b = mix(b, load64(p + 8));
+        }
+        if (end - p >= 8)
+        {
+            a = mix(a, load64(p));
+            p += 8;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, p, static_cast<size_t>(end - p));
+        b = mix(b, tail);
+
+        uint64_t h = mix(a, b);
+        h ^= h >> 32;
+        h *= 0xD6E8FEB86659FD93ull;
+        h ^= h >> 32;
+        return h;
+    }
+
+    TokenCache::TokenCache(std::string directory, uint64_t capacity)
+        : directory(std::move(directory)), capacity(capacity),
+        hitCount(0), missCount(0), usage(0)
+    {
+        std::error_code ec;
+        fs::create_directories(this->directory, ec);
+        evict();
+    }
+
+    std::string TokenCache::pathOf(uint64_t hash, uint64_t size) const
+    {
+        char name[48];
+        std::snprintf(name, sizeof(name), "%016llx-%llx.tok",
+            static_cast<unsigned long long>(hash), static_cast<unsigned long long>(size));
+        return (fs::path(directory) / name).string();
+    }
+
+    Lexer TokenCache::lex(io::Source source, std::pmr::memory_resource* resource, Interner* interner, bool recover)
+    {
+        Lexer lexer{ Context(source), resource, interner };
+        lexer.options.recover = recover;
+        uint64_t hash = contentHash(source.begin(), source.size());
+        std::string path = pathOf(hash, source.size());
+
+        if (load(path, hash, lexer))
+        {
+            hitCount += 1;
+            return lexer;
+        }
+        missCount += 1;
+        lexer.process();
+        if (lexer.diagnostics.empty())
+        {
+            store(path, hash, lexer);
+        }
+        return lexer;
+    }
+
+    // payload 中 offset 处的数字记录是否完整地落在 payload 之内，各字段按 number::recordSize 的布局读取
+    static bool recordFits(const std::pmr::string& payload, uint32_t offset)
+    {
+        uint64_t size = payload.size();
+        auto field = [&](uint64_t at) {
+            uint32_t v;
+            std::memcpy(&v, payload.data() + at, sizeof(v));
+            return uint64_t(v);
+        };
+        if (uint64_t(offset) + 3 * sizeof(uint32_t) > size)
+        {
+            return false;
+        }
+        switch (field(offset))
+        {
+        case static_cast<uint32_t>(Number::Kind::Integer):
+        case static_cast<uint32_t>(Number::Kind::Float):
+            return true;
+        case static_cast<uint32_t>(Number::Kind::BigInt):
+            return offset + (2 + field(offset + 4)) * sizeof(uint32_t) <= size;
+        case static_cast<uint32_t>(Number::Kind::Rational):
+            return offset + (3 + field(offset + 4) + field(offset + 8)) * sizeof(uint32_t) <= size;
+        default:
+            return false;
+        }
+    }
+
+    // 映像可能被截断、改写或来自别的程序，哈希只能说明源码相同。
+    // 逐个检查 token 引用的源码和 payload 范围，任何一处越界都当作未命中
+    static bool isConsistent(const TokenStream& sequence, const std::pmr::string& payload, uint64_t sourceSize)
+    {
+        for (size_t i = 0, n = sequence.size(); i < n; ++i)
+        {
+            Token t = sequence[i];
+            uint64_t end = uint64_t(t.offset) + t.length;
+            if (static_cast<size_t>(t.type) >= tokenTypeCount
+                || ((t.flags & Token::Payload) ? end > payload.size()
+                    : (t.flags & Token::Synthetic) ? t.offset > sourceSize
+                    : end > sourceSize)
+                || ((t.flags & Token::Spilled) && !recordFits(payload, t.attribute)))
+            {
+                return false;
+            }
+            if ((t.type == TokenType::OP_PAREN_BEGIN || t.type == TokenType::OP_BRACKET_BEGIN || t.type == TokenType::OP_BRACE_BEGIN)
+                && t.attribute != 0 && (t.attribute <= i || t.attribute >= n))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool TokenCache::load(const std::string& path, uint64_t hash, Lexer& lexer) const
+    {
+        // 映像是二进制数据，不能按源码的方式识别 BOM 和转码
+        auto image = io::Buffer::openRaw(path);
+        if (image->length() < sizeof(Header))
+        {
+            return false;
+        }
+
+        // count 来自文件，先用除法判断，避免 count * bytesPerToken 溢出
+        Header header;
+        std::memcpy(&header, image->begin(), sizeof(header));
+        uint64_t body = image->length() - sizeof(Header);
+        if (std::memcmp(header.magic, "FLNT", 4) != 0
+            || header.version != Lexer::version
+            || header.sourceSize != lexer.context.source.size()
+            || header.hash != hash
+            || header.count > body / bytesPerToken
+            || body - header.count * bytesPerToken != header.payloadSize)
+        {
+            return false;
+        }
+
+        // 各列整块拷贝，不逐个构造 token
+        size_t count = static_cast<size_t>(header.count);
+        const char* p = image->begin() + sizeof(Header);
+        auto column = [&](auto& v) {
+            v.resize(count);
+            std::memcpy(v.data(), p, count * sizeof(v[0]));
+            p += count * sizeof(v[0]);
+        };
+        TokenStream& sequence = lexer.sequence;
+        column(sequence.types);
+        column(sequence.flags);
+        column(sequence.offsets);
+        column(sequence.lengths);
+        column(sequence.attributes);
+        lexer.payload.assign(p, static_cast<size_t>(header.payloadSize));
+        if (!isConsistent(sequence, lexer.payload, header.sourceSize))
+        {
+            sequence.clear();
+            lexer.payload.clear();
+            return false;
+        }
+        // 没有 Interner 时同样清零，不留下文件中的编号
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (Lexer::hasSymbol(sequence.type(i)))
+            {
+                sequence.attributes[i] = lexer.symbolOf(sequence[i]);
+            }
+        }
+
+        // 更新修改时间，淘汰时按它判断最近是否用过
+        std::error_code ec;
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+        return true;
+    }
+
+    void TokenCache::store(const std::string& path, uint64_t hash, const Lexer& lexer)
+    {
+        const TokenStream& sequence = lexer.sequence;
+        Header header{};
+        std::memcpy(header.magic, "FLNT", 4);
+        header.version = Lexer::version;
+        header.sourceSize = lexer.context.source.size();
+        header.hash = hash;
+        header.count = sequence.size();
+        header.payloadSize = lexer.payload.size();
+
+        thread_local std::mt19937_64 random{ std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id()) };
+        std::string temporary = path + "." + std::to_string(random()) + ".tmp";
+
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return;
+        }
+        // Interner 的编号只在本进程中有意义，写入时清零，载入后重新驻留
+        size_t count = sequence.size();
+        const uint32_t* attributes = sequence.attributes.data();
+        std::vector<uint32_t> cleared;
+        if (lexer.interner)
+        {
+            cleared.assign(attributes, attributes + count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (Lexer::hasSymbol(sequence.type(i)))
+                {
+                    cleared[i] = Interner::none;
+                }
+            }
+            attributes = cleared.data();
+        }
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+            && std::fwrite(sequence.types.data(), sizeof(uint16_t), count, file) == count
+            && std::fwrite(sequence.flags.data(), sizeof(uint16_t), count, file) == count
+            && std::fwrite(sequence.offsets.data(), sizeof(uint32_t), count, file) == count
+            && std::fwrite(sequence.lengths.data(), sizeof(uint32_t), count, file) == count
+            && std::fwrite(attributes, sizeof(uint32_t), count, file) == count
+            && std::fwrite(lexer.payload.data(), 1, lexer.payload.size(), file) == lexer.payload.size();
+        ok = std::fclose(file) == 0 && ok;
+
+        // 其他进程可能同时写入了同样的内容，改名失败时丢弃自己的副本即可
+        std::error_code ec;
+        if (ok)
+        {
+            fs::rename(temporary, path, ec);
+        }
+        if (!ok || ec)
+        {
+            fs::remove(temporary, ec);
+            return;
+        }
+
+        usage += sizeof(Header) + count * bytesPerToken + lexer.payload.size();
+        if (usage > capacity)
+        {
+            evict();
+        }
+    }
+
+    void TokenCache::evict()
+    {
+        std::unique_lock<std::mutex> lock(evicting, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            return;
+        }
+
+        struct Entry
+        {
+            fs::file_time_type time;
+            uint64_t size;
+            fs::path path;
+        };
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+
+        std::error_code ec;
+        for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            std::error_code e;
+            if (it->path().extension() == ".tmp")
+            {
+                // 写到一半就退出的进程留下的临时文件
+                if (it->last_write_time(e) < fs::file_time_type::clock::now() - std::chrono::hours(1))
+                {
+                    fs::remove(it->path(), e);
+                }
+                continue;
+            }
+            if (it->path().extension() != ".tok")
+            {
+                continue;
+            }
+            Entry entry{ it->last_write_time(e), it->file_size(e), it->path() };
+            if (!e)
+            {
+                total += entry.size;
+                entries.push_back(std::move(entry));
+            }
+        }
+
+        // 删到容量的四分之三，避免每次写入都要扫描目录
+        if (total > capacity)
+        {
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+                return a.time < b.time;
+            });
+            for (const auto& entry : entries)
+            {
+                if (total <= capacity / 4 * 3)
+                {
+                    break;
+                }
+                if (fs::remove(entry.path, ec))
+                {
+                    total -= entry.size;
+                }
+            }
+        }
+        usage = total;
+    }
+}
+}
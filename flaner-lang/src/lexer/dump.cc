@@ -0,0 +1,163 @@
+#include <dump.hh>
+#include <fmt/format.h>
+#include <iterator>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace flaner
+{
+namespace lexer
+{
+    Dumper::Dumper(std::FILE* out, DumpFormat format)
+        : out(out), format(format)
+    {
+        buffer.reserve(blockSize + 256);
+        if (format == DumpFormat::Binary)
+        {
+#ifdef _WIN32
+            // 文本模式会把 \n 换成 \r\n
+            _setmode(_fileno(out), _O_BINARY);
+#endif
+            uint32_t v = Lexer::version;
+            const char header[8] = { 'F', 'L', 'N', 'D',
+                static_cast<char>(v), static_cast<char>(v >> 8), static_cast<char>(v >> 16), static_cast<char>(v >> 24) };
+            buffer.insert(buffer.end(), header, header + sizeof(header));
+        }
+    }
+
+    Dumper::~Dumper()
+    {
+        flush();
+    }
+
+    void Dumper::flush()
+    {
+        if (!buffer.empty())
+        {
+            std::fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
+        }
+        std::fflush(out);
+    }
+
+    void Dumper::writeJsonString(std::string_view s)
+    {
+        buffer.push_back('"');
+        const char* run = s.data();
+        const char* end = s.data() + s.size();
+        for (const char* p = run; p < end; ++p)
+        {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c >= 0x20 && c != '"' && c != '\\')
+            {
+                continue;
+            }
+            buffer.insert(buffer.end(), run, p);
+            switch (c)
+            {
+            case '"': buffer.insert(buffer.end(), { '\\', '"' }); break;
+            case '\\': buffer.insert(buffer.end(), { '\\', '\\' }); break;
+            case '\n': buffer.insert(buffer.end(), { '\\', 'n' }); break;
+            case '\r': buffer.insert(buffer.end(), { '\\', 'r' }); break;
+            case '\t': buffer.insert(buffer.end(), { '\\', 't' }); break;
+            default:
+                fmt::format_to(std::back_inserter(buffer), "\\u{:04x}", c);
+                break;
+            }
+            run = p + 1;
+        }
+        buffer.insert(buffer.end(), run, end);
+        buffer.push_back('"');
+    }
+
+    void Dumper::append(std::string_view s)
+    {
+        buffer.insert(buffer.end(), s.begin(), s.end());
+    }
+
+    void Dumper::write(TokenView token)
+    {
+        int type = static_cast<int>(token.type);
+        // 格式固定，直接拼接片段，省去每次解析格式串
+        fmt::format_int number(type);
+        std::string_view digits{ number.data(), number.size() };
+
+        switch (format)
+        {
+        case DumpFormat::Text:
+        {
+            bool quoted = token.type == TokenType::STRING || token.type == TokenType::TEMPLATE_HEAD
+                || token.type == TokenType::TEMPLATE_MIDDLE || token.type == TokenType::TEMPLATE_TAIL;
+            append("[type: ");
+            append(digits);
+            append(quoted ? ", value: \"" : ", value: ");
+            append(token.value);
+            append(quoted ? "\"]\n" : "]\n");
+            break;
+        }
+
+        case DumpFormat::JsonLines:
+            append("{\"type\":");
+            append(digits);
+            append(",\"value\":");
+            writeJsonString(token.value);
+            append("}\n");
+            break;
+
+        case DumpFormat::Binary:
+        {
+            buffer.push_back(static_cast<char>(type));
+            buffer.push_back(static_cast<char>(type >> 8));
+            size_t n = token.value.size();
+            do
+            {
+                buffer.push_back(static_cast<char>((n & 0x7F) | (n > 0x7F ? 0x80 : 0)));
+                n >>= 7;
+            } while (n != 0);
+            buffer.insert(buffer.end(), token.value.begin(), token.value.end());
+            break;
+        }
+        }
+
+        if (buffer.size() >= blockSize)
+        {
+            std::fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
+        }
+    }
+
+    void Dumper::write(const Lexer& lexer)
+    {
+        FLANER_STATS(stats::PhaseTimer timer(stats::Phase::Dump);)
+        const TokenStream& stream = lexer.getStream();
+        for (size_t i = 0; i < stream.size(); ++i)
+        {
+            write(lexer.view(stream[i]));
+        }
+    }
+
+    bool parseDumpFormat(std::string_view name, DumpFormat& format)
+    {
+        if (name == "text")
+        {
+            format = DumpFormat::Text;
+        }
+        else if (name == "json")
+        {
+            format = DumpFormat::JsonLines;
+        }
+        else if (name == "binary")
+        {
+            format = DumpFormat::Binary;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+}
+}
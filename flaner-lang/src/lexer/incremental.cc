@@ -0,0 +1,421 @@
+#include <incremental.hh>
+#include <algorithm>
+#include <cstring>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 间隙用完时按源码大小的一定比例扩大，扩大的代价平摊到每个插入的字符上是常数
+    static constexpr size_t minimumGap = 4096;
+
+    IncrementalLexer::IncrementalLexer(std::string text)
+        : buffer(minimumGap + text.size()), gapStart(0), gapEnd(minimumGap), linesBefore(0),
+        core(Context(io::Source(io::Buffer::borrow(nullptr, 0)))),
+        states(1), compactedPayload(0), compactedStates(1)
+    {
+        std::copy(text.begin(), text.end(), buffer.begin() + gapEnd);
+        attach();
+        if (text.size() > UINT32_MAX)
+        {
+            core.error("Source is too large");
+        }
+        if (scan::kernels().skipUtf8(core.context.begin, core.context.end) != core.context.end)
+        {
+            core.error("Invalid UTF-8 sequence");
+        }
+        relex(0, 0, 0);
+    }
+
+    void IncrementalLexer::attach()
+    {
+        core.context.begin = buffer.data() + gapEnd;
+        core.context.cursor = core.context.begin;
+        core.context.end = buffer.data() + buffer.size();
+    }
+
+    std::string IncrementalLexer::text() const
+    {
+        std::string s(buffer.data(), gapStart);
+        s.append(buffer.data() + gapEnd, buffer.size() - gapEnd);
+        return s;
+    }
+
+    void IncrementalLexer::moveTextGap(size_t to)
+    {
+        char* data = buffer.data();
+        if (to < gapStart)
+        {
+            size_t n = gapStart - to;
+            linesBefore -= std::count(data + to, data + gapStart, '\n');
+            std::memmove(data + gapEnd - n, data + to, n);
+            gapStart -= n;
+            gapEnd -= n;
+        }
+        else if (to > gapStart)
+        {
+            size_t n = to - gapStart;
+            linesBefore += std::count(data + gapEnd, data + gapEnd + n, '\n');
+            std::memmove(data + gapStart, data + gapEnd, n);
+            gapStart += n;
+            gapEnd += n;
+        }
+    }
+
+    void IncrementalLexer::replaceAfterGap(size_t at, size_t removed, std::string_view inserted)
+    {
+        if (gapEnd + removed < gapStart + inserted.size())
+        {
+            // 间隙不够时整体重排一次，留出与源码大小成比例的余量
+            size_t gap = inserted.size() + std::max(minimumGap, textSize() / 8);
+            std::vector<char> grown(gapStart + gap + (buffer.size() - gapEnd));
+            std::copy(buffer.begin(), buffer.begin() + gapStart, grown.begin());
+            std::copy(buffer.begin() + gapEnd, buffer.end(), grown.begin() + gapStart + gap);
+            gapEnd = gapStart + gap;
+            buffer = std::move(grown);
+        }
+        size_t start = gapEnd + removed - inserted.size();
+        std::memmove(buffer.data() + start, buffer.data() + gapEnd, at);
+        std::copy(inserted.begin(), inserted.end(), buffer.begin() + start + at);
+        gapEnd = start;
+    }
+
+    Position IncrementalLexer::gapPosition() const
+    {
+        // 行号来自 linesBefore，列号只需往回扫描到行首
+        const char* head = buffer.data();
+        const char* lineStart = head + gapStart;
+        while (lineStart > head && lineStart[-1] != '\n')
+        {
+            --lineStart;
+        }
+        Position p = LineIndex::scan(lineStart, head + gapStart);
+        p.line = linesBefore + 1;
+        return p;
+    }
+
+    IncrementalLexer::Token IncrementalLexer::token(size_t i) const
+    {
+        if (i < before.tokens.size())
+        {
+            return before.tokens[i];
+        }
+        Token t = after.tokens[size() - 1 - i];
+        if (!(t.flags & Token::Payload))
+        {
+            t.offset = static_cast<uint32_t>(textSize() - t.offset);
+        }
+        return t;
+    }
+
+    IncrementalLexer::TokenView IncrementalLexer::operator[](size_t i) const
+    {
+        Token t = token(i);
+        if (t.flags & (Token::Payload | Token::Synthetic))
+        {
+            return core.view(t);
+        }
+        // token 不会跨过间隙：间隙停在某一步的起点上
+        const char* text = buffer.data() + (t.offset < gapStart ? t.offset : t.offset - gapStart + gapEnd);
+        return { t.type, { text, t.length }, Lexer::hasSymbol(t.type) ? t.attribute : 0 };
+    }
+
+    IncrementalLexer::TokenType IncrementalLexer::type(size_t i) const
+    {
+        return i < before.tokens.size() ? before.tokens.type(i) : after.tokens.type(size() - 1 - i);
+    }
+
+    size_t IncrementalLexer::closerOf(size_t i) const
+    {
+        auto openerOf = [](TokenType t) {
+            switch (t)
+            {
+            case TokenType::OP_PAREN_END: return TokenType::OP_PAREN_BEGIN;
+            case TokenType::OP_BRACKET_END: return TokenType::OP_BRACKET_BEGIN;
+            case TokenType::OP_BRACE_END: return TokenType::OP_BRACE_BEGIN;
+            default: return TokenType::UNKNOWN;
+            }
+        };
+        // i 之前的括号不影响 i 之后的配对；右括号与栈顶种类不同时不配对，也不出栈
+        std::vector<TokenType> open;
+        for (size_t j = i, n = size(); j < n; ++j)
+        {
+            TokenType t = type(j);
+            if (t == TokenType::OP_PAREN_BEGIN || t == TokenType::OP_BRACKET_BEGIN || t == TokenType::OP_BRACE_BEGIN)
+            {
+                open.push_back(t);
+            }
+            else if (j == i)
+            {
+                return 0;
+            }
+            else if (!open.empty() && open.back() == openerOf(t))
+            {
+                open.pop_back();
+                if (open.empty())
+                {
+                    return j;
+                }
+            }
+        }
+        return 0;
+    }
+
+    size_t IncrementalLexer::startOf(size_t i) const
+    {
+        if (i < before.starts.size())
+        {
+            return before.starts[i];
+        }
+        // 重新分析时，落在删除区域里的旧 token 可能换算出负的位置
+        size_t distance = after.starts[size() - 1 - i];
+        return distance <= textSize() ? textSize() - distance : 0;
+    }
+
+    uint32_t IncrementalLexer::checkpointOf(size_t i) const
+    {
+        return i < before.checkpoints.size() ? before.checkpoints[i] : after.checkpoints[size() - 1 - i];
+    }
+
+    bool IncrementalLexer::isStepStart(size_t i) const
+    {
+        return i == 0 || startOf(i) != startOf(i - 1);
+    }
+
+    size_t IncrementalLexer::restartBefore(size_t position) const
+    {
+        // 最后一个起点不超过 position 的步骤
+        size_t lo = 0, hi = size();
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (startOf(mid) <= position)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        size_t i = lo == 0 ? 0 : lo - 1;
+        while (i > 0 && !isStepStart(i))
+        {
+            --i;
+        }
+        return i;
+    }
+
+    uint32_t IncrementalLexer::checkpoint(const Lexer::State& s)
+    {
+        if (s == states[0])
+        {
+            return 0;
+        }
+        if (s != states.back())
+        {
+            states.push_back(s);
+        }
+        return static_cast<uint32_t>(states.size() - 1);
+    }
+
+    void IncrementalLexer::moveGap(size_t to)
+    {
+        // 越过间隙的 token 在源码开头算起和末尾算起的位置之间换算，须在修改源码之前进行
+        uint32_t total = static_cast<uint32_t>(textSize());
+        auto move = [total](Side& from, Side& into) {
+            Token t = from.tokens.back();
+            if (!(t.flags & Token::Payload))
+            {
+                t.offset = total - t.offset;
+            }
+            into.push(t, total - from.starts.back(), from.checkpoints.back());
+            from.pop();
+        };
+        while (before.tokens.size() > to)
+        {
+            move(before, after);
+        }
+        while (before.tokens.size() < to)
+        {
+            move(after, before);
+        }
+    }
+
+    void IncrementalLexer::compact()
+    {
+        // 丢弃被替换掉的 token 留下的 payload 和状态
+        std::pmr::string payload(core.payload.get_allocator());
+        std::vector<Lexer::State> live(1);
+        for (Side* side : { &before, &after })
+        {
+            TokenStream& tokens = side->tokens;
+            for (size_t i = 0; i < tokens.size(); ++i)
+            {
+                if (tokens.flags[i] & Token::Payload)
+                {
+                    uint32_t offset = static_cast<uint32_t>(payload.size());
+                    payload.append(core.payload, tokens.offsets[i], tokens.lengths[i]);
+                    tokens.offsets[i] = offset;
+                }
+                if (tokens.flags[i] & Token::Spilled)
+                {
+                    uint32_t offset = static_cast<uint32_t>(payload.size());
+                    payload.append(core.payload, tokens.attributes[i], number::recordSize(core.payload.data(), tokens.attributes[i]));
+                    tokens.attributes[i] = offset;
+                }
+                uint32_t& c = side->checkpoints[i];
+                if (c != 0)
+                {
+                    const Lexer::State& s = states[c];
+                    if (s != live.back())
+                    {
+                        live.push_back(s);
+                    }
+                    c = static_cast<uint32_t>(live.size() - 1);
+                }
+            }
+        }
+        core.payload = std::move(payload);
+        states = std::move(live);
+        compactedPayload = core.payload.size();
+        compactedStates = states.size();
+    }
+
+    IncrementalLexer::Change IncrementalLexer::edit(size_t offset, size_t removed, std::string_view inserted)
+    {
+        size_t total = textSize();
+        offset = std::min(offset, total);
+        removed = std::min(removed, total - offset);
+        if (total - removed + inserted.size() > UINT32_MAX)
+        {
+            core.error("Source is too large");
+        }
+        // 编辑的两端都在字符边界上、插入的文本本身合法时，编辑后的源码仍然合法
+        auto boundary = [this, total](size_t i) {
+            return i == total || (static_cast<unsigned char>(charAt(i)) & 0xc0) != 0x80;
+        };
+        const char* insertedEnd = inserted.data() + inserted.size();
+        if (!boundary(offset) || !boundary(offset + removed)
+            || scan::kernels().skipUtf8(inserted.data(), insertedEnd) != insertedEnd)
+        {
+            core.error("Invalid UTF-8 sequence");
+        }
+
+        // 重新分析的起点在编辑之前，它的位置不受编辑影响；间隙移到这里之后，其后的 token 随源码末尾一起移动
+        size_t first = restartBefore(offset < lookaround ? 0 : offset - lookaround);
+        size_t from = first < size() ? startOf(first) : 0;
+        moveGap(first);
+        moveTextGap(from);
+        replaceAfterGap(offset - from, removed, inserted);
+        attach();
+        return relex(first, from, offset + inserted.size());
+    }
+
+    IncrementalLexer::Change IncrementalLexer::relex(size_t first, size_t from, size_t editEnd)
+    {
+        // 此时间隙在 first 处，after 中的 token 都是旧的，编辑之后的那些已经处在新的位置上。
+        // core 的 begin 是源码中的 from，它产生的位置都要加上 from
+        size_t n = size();
+        bool hasPrevious = first > 0;
+
+        // core 里只留前一个 token，供 . 之后的标识符判断使用
+        core.sequence.clear();
+        if (hasPrevious)
+        {
+            core.sequence.push_back(token(first - 1));
+        }
+        core.state = first < n ? states[checkpointOf(first)] : states[0];
+
+        std::vector<uint32_t> freshStarts, freshCheckpoints;
+        size_t old = first;
+        bool resynced = false;
+        try
+        {
+            while (true)
+            {
+                uint32_t at = static_cast<uint32_t>(from + core.context.position());
+                uint32_t check = checkpoint(core.state);
+                size_t count = core.sequence.size();
+                if (!core.step())
+                {
+                    break;
+                }
+                for (size_t i = count; i < core.sequence.size(); ++i)
+                {
+                    freshStarts.push_back(at);
+                    freshCheckpoints.push_back(check);
+                }
+
+                // 编辑区域之后，起点、状态和前一个 token 的类型都相同的旧步骤会得到相同的结果。
+                // 起点在编辑区域之前的旧 token 换算出的位置没有意义，直接跳过
+                size_t p = from + core.context.position();
+                while (old < n && (startOf(old) < editEnd || startOf(old) < p))
+                {
+                    ++old;
+                }
+                TokenType last = core.sequence.back().type;
+                if (old < n && startOf(old) == p
+                    && isStepStart(old)
+                    && states[checkpointOf(old)] == core.state
+                    && ((old > 0 && type(old - 1) == last)
+                        || (!Lexer::affectsNext(last) && (old == 0 || !Lexer::affectsNext(type(old - 1))))))
+                {
+                    resynced = true;
+                    break;
+                }
+            }
+        }
+        catch (Lexer::LexError& e)
+        {
+            after.clear();
+            // core 只看到间隙之后的部分，行列号从间隙所在的位置数起
+            Position p = gapPosition();
+            core.context.lineOffset = p.line - 1;
+            core.context.charOffset = p.column - 1;
+            Position q = core.context.locate(core.context.cursor);
+            core.context.lineOffset = core.context.charOffset = 0;
+            e.line = q.line;
+            e.column = q.column;
+            throw;
+        }
+        catch (...)
+        {
+            after.clear();
+            throw;
+        }
+
+        if (hasPrevious)
+        {
+            core.sequence.splice(0, 1, TokenStream{});
+        }
+
+        size_t end = resynced ? old : n;
+        size_t inserted = core.sequence.size();
+
+        // 被替换的旧 token 都紧挨着间隙，新 token 接在 before 末尾，间隙随之移到它们之后
+        for (size_t i = first; i < end; ++i)
+        {
+            after.pop();
+        }
+        for (size_t i = 0; i < inserted; ++i)
+        {
+            Token t = core.sequence[i];
+            if (!(t.flags & Token::Payload))
+            {
+                t.offset += static_cast<uint32_t>(from);
+            }
+            before.push(t, freshStarts[i], freshCheckpoints[i]);
+        }
+        core.sequence.clear();
+
+        // 回收要扫描全部 token，等积累的垃圾与 token 数相当时才回收，平摊到每次编辑是常数
+        size_t slack = size() / 8;
+        if (core.payload.size() > compactedPayload * 2 + 4096 + slack || states.size() > compactedStates * 2 + 64 + slack)
+        {
+            compact();
+        }
+        return { first, end - first, inserted };
+    }
+}
+}
@@ -0,0 +1,153 @@
+#include <interactive.hh>
+#include <algorithm>
+
+namespace flaner
+{
+namespace lexer
+{
+    InteractiveLexer::InteractiveLexer(Interner* interner)
+        : core(Context(io::Source(io::Buffer::borrow(nullptr, 0))), std::pmr::get_default_resource(), interner),
+        consumed(0), resume(0), delivered(0), brackets(0), status(Pending::None)
+    {
+    }
+
+    void InteractiveLexer::attach(size_t position)
+    {
+        core.context.begin = buffer.data();
+        core.context.cursor = core.context.begin + position;
+        core.context.end = core.context.begin + buffer.size();
+    }
+
+    void InteractiveLexer::discard(size_t n)
+    {
+        // 丢弃的部分计入行号，报错时的行列号从会话开始算起
+        Position p = LineIndex::scan(buffer.data(), buffer.data() + n);
+        core.context.charOffset = p.line > 1 ? p.column - 1 : core.context.charOffset + p.column - 1;
+        core.context.lineOffset += p.line - 1;
+        buffer.erase(0, n);
+    }
+
+    void InteractiveLexer::reset()
+    {
+        core.sequence.clear();
+        core.payload.clear();
+        core.state = Lexer::State{};
+        discard(buffer.size());
+        attach(0);
+        consumed = resume = delivered = brackets = 0;
+        status = Pending::None;
+    }
+
+    InteractiveLexer::Pending InteractiveLexer::feed(std::string_view line)
+    {
+        const char* lineEnd = line.data() + line.size();
+        if (scan::kernels().skipUtf8(line.data(), lineEnd) != lineEnd)
+        {
+            core.error("Invalid UTF-8 sequence");
+        }
+
+        // 上一行交出的 token 和它们的源码不再需要，只留下暂不交出的 token 和未完成的输入
+        bool holding = core.sequence.size() > delivered;
+        Token held = holding ? core.sequence.back() : Token{};
+        core.sequence.clear();
+        core.payload.clear();
+        discard(consumed);
+        if (holding)
+        {
+            held.offset -= static_cast<uint32_t>(consumed);
+            core.sequence.push_back(held);
+        }
+        buffer.append(line.data(), line.size());
+        if (buffer.empty() || buffer.back() != '\n')
+        {
+            buffer += '\n';
+        }
+        if (buffer.size() > UINT32_MAX)
+        {
+            reset();
+            core.error("Source is too large");
+        }
+        attach(resume);
+
+        bool incomplete = false;
+        const char* mark;
+        while (true)
+        {
+            mark = core.context.cursor;
+            Lexer::State saved = core.state;
+            size_t tokens = core.sequence.size();
+            size_t payloadSize = core.payload.size();
+            try
+            {
+                if (!core.step())
+                {
+                    break;
+                }
+            }
+            catch (const Lexer::LexError&)
+            {
+                if (!core.context.isEnd())
+                {
+                    reset();
+                    throw;
+                }
+                // 字符串或模板字符串到输入末尾还没有结束：退回这一步的起点，等下一行
+                core.state = saved;
+                while (core.sequence.size() > tokens)
+                {
+                    core.sequence.pop_back();
+                }
+                core.payload.resize(payloadSize);
+                incomplete = true;
+                break;
+            }
+        }
+
+        const TokenStream& sequence = core.sequence;
+        size_t end = incomplete ? static_cast<size_t>(mark - core.context.begin) : buffer.size();
+        Token last = sequence.empty() ? Token{} : sequence[sequence.size() - 1];
+        holding = !sequence.empty() && Lexer::affectsNext(last.type) && !(last.flags & Token::Synthetic);
+        delivered = sequence.size() - (holding ? 1 : 0);
+        consumed = holding ? std::min<size_t>(end, last.offset) : end;
+        resume = end - consumed;
+
+        for (size_t i = 0; i < delivered; ++i)
+        {
+            switch (sequence.type(i))
+            {
+            case TokenType::OP_PAREN_BEGIN:
+            case TokenType::OP_BRACKET_BEGIN:
+            case TokenType::OP_BRACE_BEGIN:
+                brackets += 1;
+                break;
+            case TokenType::OP_PAREN_END:
+            case TokenType::OP_BRACKET_END:
+            case TokenType::OP_BRACE_END:
+                brackets -= brackets > 0 ? 1 : 0;
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (incomplete)
+        {
+            char first = *scan::skipBlank(mark, core.context.end);
+            status = first == '"' || first == '\'' ? Pending::String : Pending::Template;
+        }
+        else if (core.state.levelOfTemplateNesting > 0)
+        {
+            status = Pending::Template;
+        }
+        else if (holding)
+        {
+            status = Pending::Token;
+        }
+        else
+        {
+            status = brackets > 0 ? Pending::Bracket : Pending::None;
+        }
+        return status;
+    }
+}
+}
@@ -0,0 +1,155 @@
+#include <interner.hh>
+#include <cache.hh>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace flaner
+{
+namespace lexer
+{
+    // 编号所在的段和段内下标
+    static void locate(Interner::Symbol id, unsigned firstBits, unsigned& segment, size_t& index)
+    {
+        uint64_t v = uint64_t(id) + (uint64_t(1) << firstBits);
+        unsigned k = 0;
+        while ((v >> (firstBits + k + 1)) != 0)
+        {
+            ++k;
+        }
+        segment = k;
+        index = static_cast<size_t>(v - (uint64_t(1) << (firstBits + k)));
+    }
+
+    Interner::Interner()
+        : next(1)
+    {
+        for (auto& s : segments)
+        {
+            s.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    Interner::~Interner()
+    {
+        for (auto& s : segments)
+        {
+            delete[] s.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::string_view Interner::name(Symbol id) const
+    {
+        unsigned segment;
+        size_t index;
+        locate(id, firstSegmentBits, segment, index);
+        const std::string_view* entries = segments[segment].load(std::memory_order_acquire);
+        return entries && id != none && id < next.load(std::memory_order_acquire) ? entries[index] : std::string_view{};
+    }
+
+    Interner::Symbol Interner::lookup(const Shard& shard, uint64_t hash, std::string_view s) const
+    {
+        if (shard.slots.empty())
+        {
+            return none;
+        }
+        size_t mask = shard.slots.size() - 1;
+        for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask)
+        {
+            const Slot& slot = shard.slots[i];
+            if (slot.id == none)
+            {
+                return none;
+            }
+            if (slot.hash == hash && name(slot.id) == s)
+            {
+                return slot.id;
+            }
+        }
+    }
+
+    void Interner::insert(Shard& shard, Slot slot)
+    {
+        // 装填率保持在 3/4 以下
+        if ((shard.count + 1) * 4 > shard.slots.size() * 3)
+        {
+            std::vector<Slot> old(std::max<size_t>(64, shard.slots.size() * 2), Slot{ 0, none });
+            old.swap(shard.slots);
+            shard.count = 0;
+            for (const Slot& s : old)
+            {
+                if (s.id != none)
+                {
+                    insert(shard, s);
+                }
+            }
+        }
+        size_t mask = shard.slots.size() - 1;
+        size_t i = static_cast<size_t>(slot.hash) & mask;
+        while (shard.slots[i].id != none)
+        {
+            i = (i + 1) & mask;
+        }
+        shard.slots[i] = slot;
+        shard.count += 1;
+    }
+
+    void Interner::publish(Symbol id, std::string_view s)
+    {
+        unsigned segment;
+        size_t index;
+        locate(id, firstSegmentBits, segment, index);
+        std::string_view* entries = segments[segment].load(std::memory_order_acquire);
+        if (entries == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(growing);
+            entries = segments[segment].load(std::memory_order_relaxed);
+            if (entries == nullptr)
+            {
+                entries = new std::string_view[size_t(1) << (firstSegmentBits + segment)];
+                segments[segment].store(entries, std::memory_order_release);
+            }
+        }
+        entries[index] = s;
+    }
+
+    Interner::Symbol Interner::find(std::string_view s) const
+    {
+        uint64_t hash = contentHash(s.data(), s.size());
+        const Shard& shard = shards[hash >> (64 - shardBits)];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return lookup(shard, hash, s);
+    }
+
+    Interner::Symbol Interner::intern(std::string_view s)
+    {
+        // 哈希只算一次，分片和表内位置都由它决定
+        uint64_t hash = contentHash(s.data(), s.size());
+        Shard& shard = shards[hash >> (64 - shardBits)];
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            if (Symbol id = lookup(shard, hash, s))
+            {
+                return id;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (Symbol id = lookup(shard, hash, s))
+        {
+            return id;
+        }
+        Symbol id = next.fetch_add(1, std::memory_order_acq_rel);
+        if (id == UINT32_MAX)
+        {
+            throw std::length_error("Interner: too many symbols");
+        }
+
+        char* copy = static_cast<char*>(shard.storage.allocate(s.size() ? s.size() : 1, 1));
+        std::memcpy(copy, s.data(), s.size());
+        publish(id, { copy, s.size() });
+        insert(shard, { hash, id });
+        return id;
+    }
+}
+}
@@ -0,0 +1,297 @@
+#include <io.hh>
+#include <scan.hh>
+#include <stats.hh>
+#include <unicode.hh>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace flaner
+{
+namespace lexer
+{
+namespace io
+{
+    Buffer::~Buffer()
+    {
+        unmap();
+    }
+
+    void Buffer::unmap()
+    {
+        if (mapping == nullptr)
+        {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(static_cast<HANDLE>(mapping));
+#else
+        munmap(mapping, size);
+#endif
+        mapping = nullptr;
+    }
+
+    void Buffer::decode(Encoding declared)
+    {
+        FLANER_STATS(stats::PhaseTimer timer(stats::Phase::Decode);)
+        auto startsWith = [this](const char* prefix, size_t n) {
+            return size >= n && std::memcmp(data, prefix, n) == 0;
+        };
+
+        encoding = declared;
+        bool bigEndian = false;
+        size_t skip = 0;
+        if (startsWith("\xef\xbb\xbf", 3))
+        {
+            encoding = Encoding::UTF_8;
+            skip = 3;
+        }
+        else if (startsWith("\xff\xfe\0\0", 4) || startsWith("\0\0\xfe\xff", 4))
+        {
+            encoding = Encoding::UTF_32;
+            bigEndian = data[0] == 0;
+            skip = 4;
+        }
+        else if (startsWith("\xff\xfe", 2) || startsWith("\xfe\xff", 2))
+        {
+            encoding = Encoding::UTF_16;
+            bigEndian = data[0] == '\xfe';
+            skip = 2;
+        }
+
+        if (encoding == Encoding::UTF_8)
+        {
+            // 纯 ASCII 的块整块跳过，只有含多字节序列的块才逐个解码
+            bom = skip;
+            const char* p = scan::kernels().skipUtf8(begin(), end());
+            malformed = p == end() ? npos : static_cast<size_t>(p - begin());
+            return;
+        }
+
+        std::string text;
+        malformed = encoding == Encoding::UTF_16
+            ? unicode::fromUtf16(data + skip, size - skip, bigEndian, text)
+            : unicode::fromUtf32(data + skip, size - skip, bigEndian, text);
+        unmap();
+        storage.swap(text);
+        data = storage.data();
+        size = storage.size();
+        bom = 0;
+    }
+
+#ifdef _WIN32
+    bool Buffer::map(const std::string& path)
+    {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &fileSize))
+        {
+            CloseHandle(file);
+            return false;
+        }
+        if (fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return true;
+        }
+
+        HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (view == nullptr)
+        {
+            return false;
+        }
+        void* p = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+        if (p == nullptr)
+        {
+            CloseHandle(view);
+            return false;
+        }
+
+        data = static_cast<const char*>(p);
+        size = static_cast<size_t>(fileSize.QuadPart);
+        mapping = view;
+        return true;
+    }
+#else
+    bool Buffer::map(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            ::close(fd);
+            return false;
+        }
+        if (st.st_size == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+        data = static_cast<const char*>(p);
+        size = static_cast<size_t>(st.st_size);
+        mapping = p;
+        return true;
+    }
+#endif
+
+    const LineIndex& Buffer::lines() const
+    {
+        std::call_once(indexed, [this]() {
+            lineIndex = std::make_unique<LineIndex>(begin(), end());
+        });
+        return *lineIndex;
+    }
+
+    bool Buffer::fetch(const std::string& path)
+    {
+        std::FILE* file = nullptr;
+        {
+            FLANER_STATS(stats::PhaseTimer timer(stats::Phase::Open);)
+            // 无法映射时（管道、标准输入等）退回到整体读入
+            if (path == "-" || !map(path))
+            {
+                file = path == "-" ? stdin : std::fopen(path.c_str(), "rb");
+                if (file == nullptr)
+                {
+                    return false;
+                }
+            }
+        }
+
+        if (file != nullptr)
+        {
+            FLANER_STATS(stats::PhaseTimer timer(stats::Phase::Read);)
+            char block[1 << 16];
+            size_t n;
+            while ((n = std::fread(block, 1, sizeof(block), file)) > 0)
+            {
+                storage.append(block, n);
+            }
+            if (file != stdin)
+            {
+                std::fclose(file);
+            }
+
+            data = storage.data();
+            size = storage.size();
+        }
+        return true;
+    }
+
+    std::shared_ptr<const Buffer> Buffer::open(const std::string& path, Encoding declared)
+    {
+        auto buffer = std::make_shared<Buffer>();
+        if (buffer->fetch(path))
+        {
+            buffer->decode(declared);
+        }
+        return buffer;
+    }
+
+    std::shared_ptr<const Buffer> Buffer::openRaw(const std::string& path)
+    {
+        auto buffer = std::make_shared<Buffer>();
+        buffer->fetch(path);
+        return buffer;
+    }
+
+    std::shared_ptr<const Buffer> Buffer::borrow(const char* data, size_t size, Encoding declared)
+    {
+        auto buffer = std::make_shared<Buffer>();
+        buffer->data = data;
+        buffer->size = size;
+        buffer->decode(declared);
+        return buffer;
+    }
+
+    std::shared_ptr<const Buffer> Buffer::read(std::wstreambuf* buf)
+    {
+        auto buffer = std::make_shared<Buffer>();
+        if (buf == nullptr)
+        {
+            return buffer;
+        }
+        FLANER_STATS(stats::PhaseTimer timer(stats::Phase::Read);)
+
+        // 宽字符按 UTF-8 存放，与文件来源保持一致；不成对的代理换成 U+FFFD 并记为非法
+        std::string& text = buffer->storage;
+        buffer->encoding = sizeof(wchar_t) == 2 ? Encoding::UTF_16 : Encoding::UTF_32;
+        auto invalid = [&]() {
+            if (buffer->malformed == npos)
+            {
+                buffer->malformed = text.size();
+            }
+            unicode::encode(text, unicode::replacement);
+        };
+        char32_t pending = 0;
+        for (auto c = buf->sbumpc(); c != std::wstreambuf::traits_type::eof(); c = buf->sbumpc())
+        {
+            char32_t u = static_cast<char32_t>(c);
+            if (pending)
+            {
+                char32_t high = pending;
+                pending = 0;
+                if (u >= 0xdc00 && u < 0xe000)
+                {
+                    unicode::encode(text, 0x10000 + ((high - 0xd800) << 10) + (u - 0xdc00));
+                    continue;
+                }
+                invalid();
+            }
+            if (u >= 0xd800 && u < 0xdc00)
+            {
+                pending = u;
+            }
+            else if ((u >= 0xdc00 && u < 0xe000) || u > 0x10ffff)
+            {
+                invalid();
+            }
+            else
+            {
+                unicode::encode(text, u);
+            }
+        }
+        if (pending)
+        {
+            invalid();
+        }
+
+        buffer->data = buffer->storage.data();
+        buffer->size = buffer->storage.size();
+        return buffer;
+    }
+}
+}
+}
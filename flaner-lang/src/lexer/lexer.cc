@@ -1,106 +1,106 @@
 #include <lexer.hh>
+#include <chars.hh>
+#include <unicode.hh>
+#include <algorithm>
 #include <cassert>
 
 namespace flaner
 {
 namespace lexer
 {
-    static inline size_t it2idx(std::vector<Lexer::Token>& seq, std::vector<Lexer::Token>::iterator& it)
+    // ֻֽж ASCII հףֽڵ Unicode հ scan::skipBlank 
+    bool Lexer::isBlank(char ch)
     {
-        return static_cast<size_t>(it - seq.begin());
+        return chars::isBlank(ch);
     }
 
-    bool Lexer::isBlank(char ch)
+    Lexer::TokenType Lexer::getKeywordOrID(std::string_view s)
     {
-        std::string blanks = "\n\r\t\f \x0b\xa0\u2000"
-            "\u2001\u2002\u2003\u2004\u2005\u2006\u2007\u2008\u2009"
-            "\u200a\u200b\u2028\u2029\u3000";
-        for (auto i = blanks.begin(); i != blanks.end(); i++)
-        {
-            if (*i == ch)
-            {
-                return true;
-            }
-        }
-        return false;
+        return keywordOf(s);
     }
 
-    Lexer::TokenType Lexer::getKeywordOrID(std::string s)
+    Lexer::Token Lexer::slice(TokenType type, const char* from, const char* to)
     {
-        TokenType type;
+        return { type, 0, static_cast<uint32_t>(from - context.begin), static_cast<uint32_t>(to - from) };
+    }
 
-        try
-        {
-            type = keywordMap.at(s);
-        }
-        catch (const std::exception&)
-        {
-            type = TokenType::IDENTIFIER;
-        }
-        return type;
+    Lexer::Token Lexer::synthetic(TokenType type)
+    {
+        return { type, Token::Synthetic, static_cast<uint32_t>(context.position()), 0 };
     }
 
-    std::string Lexer::getNumber()
+    Lexer::Token Lexer::getNumber()
     {
-        std::string n{};
-        char ch = context.getLastchar();
+        const char* start = context.cursor - 1;
         char state = 1;
-        do
-        {
+        auto accept = [&state](char ch) {
             switch (ch)
             {
             case 'e':
             {
                 if (state != 2 && state != 14)
                 {
-                    return n;
+                    return false;
                 }
                 state = 9;
-                n += 'e';
-                break;
+                return true;
             }
             case '.':
             {
                 if (state >> 2)
                 {
-                    return n;
+                    return false;
                 }
                 state = 12;
-                n += '.';
-                break;
+                return true;
             }
             case '+':
             case '-':
             {
-                if (!(state & 1))
-                {
-                    return n;
-                }
-                n += ch;
-                break;
+                return (state & 1) != 0;
             }
             default:
                 if (ch >= '0' && ch <= '9')
                 {
                     if (state >> 2 == 1)
                     {
-                        return n;
+                        return false;
                     }
                     state = state & 8 ? 14 : ((state >> 1 & 2) + 2);
-                    n += ch;
+                    return true;
                 }
-                else
-                {
-                    return n;
-                }
-                break;
+                return false;
             }
+        };
 
-            ch = context.getNextchar();
+        // һַѱ process() ȡַֻ֮ʱǰ
+        // ʱǷΧ0..10 ܶ 0.  .10
+        accept(context.getLastchar());
+        for (char ch = context.lookNextchar(); !(ch == '.' && context.lookNextchar(2) == '.') && accept(ch); ch = context.lookNextchar())
+        {
+            context.getNextchar();
+        }
 
-        } while (true);
+        // ׺֮ʶַʱ 123name׺
+        TokenType type = TokenType::NUMBER;
+        char suffix = context.lookNextchar();
+        char after = context.lookNextchar(2);
+        if ((suffix == 'n' || suffix == 'r') && !chars::isIdentPart(after))
+        {
+            type = suffix == 'n' ? TokenType::BIGINT : TokenType::RATIONAL;
+            context.getNextchar();
+        }
 
-        return n;
+        Token token = slice(type, start, context.cursor);
+        number::Decoded decoded;
+        if (const char* message = number::decode({ start, token.length }, type, payload, decoded))
+        {
+            diagnose(message);
+            return slice(TokenType::UNKNOWN, start, context.cursor);
+        }
+        token.flags = decoded.spilled ? Token::Spilled : 0;
+        token.attribute = decoded.attribute;
+        return token;
     }
 
     inline char Lexer::getEscapeCharacter()
@@ -122,524 +122,522 @@ namespace lexer
         case '\\': m = '\x5c'; break;
 
             // ת \r\n
-        case '\r': ch = context.getNextchar();
-        case '\n': ch = context.getNextchar(); break;
+        case '\r':
+            if (context.lookNextchar() == '\n')
+            {
+                context.getNextchar();
+            }
+            break;
+        case '\n': break;
         default:
             m = ch; break;
         }
         return m;
     }
 
-    std::string Lexer::getString(char mark)
+    Lexer::Token Lexer::getString(char mark)
     {
-        std::string s{};
-        char ch = context.getNextchar();
+        const scan::Kernels& kernels = scan::kernels();
+        const char* start = context.cursor;
+        //  payload е㣬npos ʾûת壬ֱԴ
+        size_t decoded = std::string::npos;
 
         while (true)
         {
-            if (ch == mark)
+            // ַͨɶֻšתͻдͣ
+            const char* run = context.cursor;
+            context.cursor = kernels.findStringSpecial(run, context.end, mark);
+            FLANER_STATS(stats::local().seeks += 1;)
+            if (decoded != std::string::npos)
             {
-                if (context.lookLastchar() != '\\')
-                {
-                    return s;
-                }
-                s += ch;
+                payload.append(run, context.cursor);
             }
-            else
+            if (context.isEnd())
             {
-                if (ch == '\\')
-                {
-                    s += getEscapeCharacter();
-                }
-                else if (ch == '\r' || ch == '\n')
-                {
-                   error("Invalid or unexpected token");
-                }
-                else
-                {
-                    s += ch;
-                }
+                break;
             }
-            ch = context.getNextchar();
-        }
-    }
-
-    void Lexer::processTemplateString(std::function<void(TokenType, std::string)> push)
-    {
-        if (context.getLastchar() == '}')
-        {
-            push(TokenType::OP_PAREN_END, ")");
-            push(TokenType::OP_ADD, "+");
-            levelOfTemplateNesting -= 1;
-        }
+            char ch = context.getNextchar();
 
-        char ch = context.getNextchar();
-        std::string s{};
-
-        while (true)
-        {
-            if (ch == '\\')
+            if (ch == mark)
             {
-                s += getEscapeCharacter();
+                if (decoded == std::string::npos)
+                {
+                    return slice(TokenType::STRING, start, context.cursor - 1);
+                }
+                return { TokenType::STRING, Token::Payload,
+                    static_cast<uint32_t>(decoded), static_cast<uint32_t>(payload.size() - decoded) };
             }
-            else if (ch == '$')
+            else if (ch == '\\')
             {
-                ch = context.getNextchar();
-                if (ch == '{')
+                if (decoded == std::string::npos)
                 {
-                    push(TokenType::STRING, s);
-                    push(TokenType::OP_ADD, "+");
-                    push(TokenType::OP_PAREN_BEGIN, "(");
-                    levelOfTemplateNesting += 1;
-                    return;
+                    decoded = payload.size();
+                    payload.append(start, context.cursor - 1);
                 }
-                else
+                if (char m = getEscapeCharacter())
                 {
-                    s += ch;
+                    payload += m;
                 }
             }
-            else if (ch == '`')
-            {
-                push(TokenType::STRING, s);
-                return;
-            }
             else
             {
-                s += ch;
+                // δתĻУͣڻϱĩβűֻδַ
+                context.cursor -= 1;
+                break;
             }
+        }
 
-            ch = context.getNextchar();
+        // ûнַŵβĩβΪһ UNKNOWNӻдŷ
+        diagnose("Invalid or unexpected token");
+        if (decoded != std::string::npos)
+        {
+            payload.resize(decoded);
         }
+        return slice(TokenType::UNKNOWN, start - 1, context.cursor);
     }
 
-    void Lexer::process()
+    void Lexer::processTemplateString(std::function<void(Token)> push)
     {
-        auto push = [&](TokenType t, std::string v) {
-			try
-			{
-				sequence.push_back({ t, v });
-			}
-			catch (const std::exception& e)
-			{
-				std::cout << e.what() << std::endl;
-				abort();
-			}
-        };
-        auto next = [&](size_t offset = 1) {
-            return context.getNextchar(offset);
-        };
-        auto lastToken = [&]() {
-            return sequence.at(sequence.size() - 1);
-        };
-
-        levelOfTemplateNesting = 0;
-        levelOfParanthesesNestingInTemplateInnerEvaluation = 0;
-
-        while (!context.isEnd())
+        //  ` ʼǵһΣ ${ ... }  } ֮Ķ
+        bool head = context.getLastchar() != '}';
+        if (!head)
         {
-            char ch = next();
-
-            if (isBlank(ch))
+            if (options.desugarTemplates)
             {
-                continue;
+                push(synthetic(TokenType::OP_PAREN_END));
+                push(synthetic(TokenType::OP_ADD));
             }
+            state.levelOfTemplateNesting -= 1;
+            state.levelOfParanthesesNestingInTemplateInnerEvaluation = state.outerLevels.back();
+            state.outerLevels.pop_back();
+        }
 
-            auto match = [&](char s) {
-                return ch == s;
-            };
-            auto test = [&](char s, size_t offset = 1) {
-                return context.lookNextchar(offset) == s;
-            };
-
-            if (isdigit(ch) || (ch == '.' && isdigit(context.lookNextchar())))
-            {
-                push(TokenType::NUMBER, getNumber());
-            }      
-            else if (isalpha(ch) || ch == L'_' || ch == L'$')
+        const char* start = context.cursor;
+        size_t decoded = std::string::npos;
+        auto segment = [&](TokenType type, const char* to) -> Token {
+            if (decoded == std::string::npos)
             {
-                std::string word{ ch };
-                char nextchar = context.lookNextchar(1);
-                while (isalnum(nextchar) || ch == L'_' || ch == L'$')
-                {
-                    ch = next();
-                    nextchar = context.lookNextchar(1);
-                    word += ch;
-                }
-                if (sequence.size() != 0 && sequence.back().type == TokenType::OP_DOT)
-                {
-                    push(TokenType::IDENTIFIER, word);
-                }
-                else
-                {
-                    push(getKeywordOrID(word), word);
-                }
-            }
-            else if (match('\''))
-            {
-                push(TokenType::STRING, getString('\''));
-            }
-            else if (match('"'))
-            {
-                push(TokenType::STRING, getString('"'));
+                return slice(type, start, to);
             }
-            else if (match('`'))
+            return { type, Token::Payload,
+                static_cast<uint32_t>(decoded), static_cast<uint32_t>(payload.size() - decoded) };
+        };
+
+        const scan::Kernels& kernels = scan::kernels();
+
+        while (true)
+        {
+            const char* run = context.cursor;
+            context.cursor = kernels.findTemplateSpecial(run, context.end);
+            FLANER_STATS(stats::local().seeks += 1;)
+            if (decoded != std::string::npos)
             {
-                processTemplateString(push);
+                payload.append(run, context.cursor);
             }
-            else if (match('+'))
+            if (context.isEnd())
             {
-                if (test('='))
+                // ģַԿУûнʱһֱĩβ
+                diagnose("Unterminated template literal");
+                if (decoded != std::string::npos)
                 {
-                    push(TokenType::OP_ADD_ASSIGN, "+=");
-                    next();
-                }
-                else
-                {
-                    push(TokenType::OP_ADD, "+");
-                }
-            }
-            else if (match('-'))
-            {
-                if (test('='))
-                {
-                    push(TokenType::OP_MINUS_ASSIGN, "-=");
-                    next();
-                }
-                else
-                {
-                    push(TokenType::OP_MINUS, "-");
+                    payload.resize(decoded);
                 }
+                push(slice(TokenType::UNKNOWN, start - 1, context.cursor));
+                return;
             }
-            else if (match('*'))
-            {
-                if (test('*'))
-                {
-                    push(TokenType::OP_POW, "**");
-                    next();
-                }
-                else
-                {
-                    if (test('='))
-                    {
+            char ch = context.getNextchar();
 
-                        push(TokenType::OP_MUL_ASSIGN, "*=");
-                        next();
-                    }
-                    else
-                    {
-                        push(TokenType::OP_MUL, "*");
-                    }
-                    next();
-                }
-            }
-            else if (match('/'))
-            {
-                if (test('/'))
-                {
-                    push(TokenType::OP_INTDIV_ASSIGN, "//");
-                    next();
-                }
-                else
-                {
-                    if (test('='))
-                    {
-                        push(TokenType::OP_DIV_ASSIGN, "/=");
-                        next();
-                    }
-                    else
-                    {
-                        push(TokenType::OP_DIV, "/");
-                    }
-                }
-            }
-            else if (match('%'))
+            if (ch == '\\')
             {
-                if (test('%'))
+                if (decoded == std::string::npos)
                 {
-                    push(TokenType::OP_QUOTE, "%%");
-                    next();
+                    decoded = payload.size();
+                    payload.append(start, context.cursor - 1);
                 }
-                else
+                if (char m = getEscapeCharacter())
                 {
-                    if (test('='))
-                    {
-
-                        push(TokenType::OP_MOD_ASSIGN, "%=");
-                        next();
-                    }
-                    else
-                    {
-                        push(TokenType::OP_MOD, "%");
-                    }
-                    next();
+                    payload += m;
                 }
             }
-            else if (match('|'))
+            else if (ch == '$' && context.lookNextchar() == '{')
             {
-                if (test('|'))
+                const char* to = context.cursor - 1;
+                context.getNextchar();
+                if (options.desugarTemplates)
                 {
-                    push(TokenType::OP_LOGIC_OR, "||");
-                    next();
+                    push(segment(TokenType::STRING, to));
+                    push(synthetic(TokenType::OP_ADD));
+                    push(synthetic(TokenType::OP_PAREN_BEGIN));
                 }
                 else
                 {
-                    if (test('='))
-                    {
-                        push(TokenType::OP_BIT_OR_ASSIGN, "|=");
-                        next();
-                    }
-                    else
-                    {
-                        push(TokenType::OP_BIT_OR, "|");
-                    }
+                    push(segment(head ? TokenType::TEMPLATE_HEAD : TokenType::TEMPLATE_MIDDLE, to));
                 }
+                state.levelOfTemplateNesting += 1;
+                state.outerLevels.push_back(state.levelOfParanthesesNestingInTemplateInnerEvaluation);
+                state.levelOfParanthesesNestingInTemplateInnerEvaluation = 0;
+                return;
             }
-            else if (match('&'))
+            else if (ch == '`')
             {
-                if (test('&'))
-                {
-                    push(TokenType::OP_LOGIC_AND, "&&");
-                    next();
-                }
-                else
-                {
-                    if (test('='))
-                    {
-                        push(TokenType::OP_BIT_OR_ASSIGN, "&=");
-                        next();
-                    }
-                    else
-                    {
-                        push(TokenType::OP_BIT_OR, "&");
-                    }
-                }
+                // û ${ ... } ģַһַ
+                bool tail = !head && !options.desugarTemplates;
+                push(segment(tail ? TokenType::TEMPLATE_TAIL : TokenType::STRING, context.cursor - 1));
+                return;
             }
-            else if (match('<'))
+            else if (decoded != std::string::npos)
             {
-                if (test('<'))
-                {
-                    push(TokenType::OP_SHIFT_LEFT, "<<");
-                    next();
-                }
-                else
-                {
-                    if (test('='))
-                    {
-                        push(TokenType::OP_LESS_EQUAL, "<=");
-                        next();
-                    }
-                    else
-                    {
-                        push(TokenType::OP_LESS_THAN, "<");
-                    }
-                }
+                // ûи {  $
+                payload += ch;
             }
-            else if (match('>'))
-            {
-                if (test('>'))
-                {
-                    push(TokenType::OP_SHIFT_RIGHT, ">>");
-                    next();
-                }
-                else
-                {
-                    if (test('='))
-                    {
-                        push(TokenType::OP_GREATER_EQUAL, ">=");
-                        next();
-                    }
-                    else
-                    {
-                        push(TokenType::OP_GREATER_THAN, ">");
-                    }
-                }
-            }
-            else if (match('='))
-            {
-                bool pureAssignment = true;
-                auto replace = [&](TokenType t1, TokenType t2, std::string s) {
-                    if (sequence.size() != 0 && sequence.back().type == t1)
-                    {
-                        sequence.pop_back();
-                        push(t2, s);
-                        pureAssignment = false;
-                    }
-                };
+        }
+    }
 
-                if (test('>'))
-                {
-                    push(TokenType::FUNCTION_ARROW, "=>");
-                    next();
-                    continue;
-                }
+    void Lexer::process()
+    {
+        if (context.source.size() > UINT32_MAX)
+        {
+            error("Source is too large");
+        }
+        checkEncoding();
 
-                replace(TokenType::OP_POW, TokenType::OP_POW_ASSIGN, "**=");
-                replace(TokenType::OP_QUOTE, TokenType::OP_QUOTE_ASSIGN, "%%=");
-                replace(TokenType::OP_INTDIV, TokenType::OP_INTDIV_ASSIGN, "//=");
-                replace(TokenType::OP_SHIFT_LEFT, TokenType::OP_SHIFT_LEFT_ASSIGN, "<<=");
-                replace(TokenType::OP_SHIFT_RIGHT, TokenType::OP_SHIFT_RIGHT_ASSIGN, ">>=");
+        FLANER_STATS(stats::PhaseTimer timer(stats::Phase::Lex);)
+        state = State{};
+        while (step())
+        {
+        }
+        state = State{};
+        sequence.matchBrackets();
+    }
 
-                if (pureAssignment)
-                {
-                    push(TokenType::OP_ASSIGN, "=");
-                }
+    void Lexer::checkEncoding()
+    {
+        const io::Source& source = context.source;
+        if (!source.isValid())
+        {
+            context.cursor = context.begin + source.buffer->malformedAt();
+            error(std::string("Invalid ") + io::nameOf(source.encoding) + " sequence");
+        }
+    }
 
-            }
-            else if (match('('))
-            {
-                push(TokenType::OP_PAREN_BEGIN, "(");
-            }
-            else if (match(')'))
-            {
-                push(TokenType::OP_PAREN_END, ")");
-            }
-            else if (match('['))
-            {
-                push(TokenType::OP_BRACKET_BEGIN, "[");
-            }
-            else if (match(']'))
-            {
-                push(TokenType::OP_BRACKET_END, "]");
-            }
-            else if (match('{'))
-            {
-                if (levelOfTemplateNesting > 0)
-                {
-                    levelOfParanthesesNestingInTemplateInnerEvaluation += 1;
-                }
-                push(TokenType::OP_BRACE_BEGIN, "{");
-            }
-            else if (match('}'))
-            {
-                if (levelOfParanthesesNestingInTemplateInnerEvaluation > 0)
-                {
-                    levelOfParanthesesNestingInTemplateInnerEvaluation -= 1;
-                }
-                if (levelOfParanthesesNestingInTemplateInnerEvaluation == 0)
-                {
-                    processTemplateString(push);
-                }
-                else
-                {
-                    push(TokenType::OP_BRACE_END, "}");
-                }
-            }
-            else if (match('.'))
+    Lexer::Token Lexer::getIdentifier(const char* start)
+    {
+        // ASCII ֳɶͣڷ ASCII ֽʱŽ
+        const scan::Kernels& kernels = scan::kernels();
+        context.cursor = kernels.skipIdentifier(context.cursor, context.end);
+        FLANER_STATS(stats::local().seeks += 1;)
+        while (context.cursor < context.end && static_cast<unsigned char>(*context.cursor) >= 0x80)
+        {
+            size_t n = unicode::identifierPart(context.cursor, context.end);
+            if (n == 0)
             {
-                if (sequence.size() != 0 && sequence.back().type == TokenType::OP_DOT_DOT)
-                {
-                    sequence.pop_back();
-                    push(TokenType::OP_DOT_DOT_DOT, "...");
-                }
-                else if (test('.'))
-                {
-                    push(TokenType::OP_DOT_DOT, "..");
-                    next();
-                }
-                else
-                {
-                    push(TokenType::OP_DOT, ".");
-                }
+                break;
             }
-            else if (match(':'))
+            context.cursor = kernels.skipIdentifier(context.cursor + n, context.end);
+        }
+
+        if (sequence.size() != 0 && sequence.back().type == TokenType::OP_DOT)
+        {
+            return slice(TokenType::IDENTIFIER, start, context.cursor);
+        }
+        std::string_view word{ start, static_cast<size_t>(context.cursor - start) };
+        return slice(getKeywordOrID(word), start, context.cursor);
+    }
+
+#if FLANER_LEXER_STATS
+    static stats::Branch branchOf(char ch, char after, bool continuesTemplate)
+    {
+        switch (chars::table.startOf(ch))
+        {
+        case chars::Start::Digit:
+            return stats::Branch::Number;
+        case chars::Start::Dot:
+            return chars::isDigit(after) ? stats::Branch::Number : stats::Branch::Operator;
+        case chars::Start::Identifier:
+        case chars::Start::NonAscii:
+            return stats::Branch::Identifier;
+        case chars::Start::Quote:
+            return stats::Branch::String;
+        case chars::Start::Template:
+            return stats::Branch::Template;
+        case chars::Start::BraceEnd:
+            return continuesTemplate ? stats::Branch::Template : stats::Branch::Operator;
+        default:
+            return stats::Branch::Operator;
+        }
+    }
+#endif
+
+    bool Lexer::step()
+    {
+        auto push = [&](Token t) {
+			FLANER_STATS(stats::local().tokens[static_cast<size_t>(t.type)] += 1;)
+			if (interner && hasSymbol(t.type))
+			{
+				t.attribute = symbolOf(t);
+			}
+			sequence.push_back(t);
+        };
+        auto next = [&](size_t offset = 1) {
+            return context.getNextchar(offset);
+        };
+
+        FLANER_STATS(const char* blankStart = context.cursor;)
+        context.cursor = scan::skipBlank(context.cursor, context.end);
+        FLANER_STATS(stats::local().seeks += 1;)
+        FLANER_STATS(stats::local().branchBytes[static_cast<size_t>(stats::Branch::Blank)] += context.cursor - blankStart;)
+        if (context.isEnd())
+        {
+            return false;
+        }
+        FLANER_STATS(const char* tokenStart = context.cursor;)
+        char ch = next();
+        FLANER_STATS(stats::BranchScope branch(
+            branchOf(ch, context.cursor < context.end ? *context.cursor : 0,
+                state.levelOfTemplateNesting > 0 && state.levelOfParanthesesNestingInTemplateInnerEvaluation == 0),
+            tokenStart, context.cursor);)
+
+        // һֽڷɣ operatorTable ȡƥ䣬ͷ޸Ѿ token
+        const char* start = context.cursor - 1;
+        switch (chars::table.startOf(ch))
+        {
+        case chars::Start::NonAscii:
+        {
+            // ַֽܿʼʶİʶַΪ UNKNOWN
+            size_t n = unicode::identifierStart(start, context.end);
+            if (n != 0)
             {
-                push(TokenType::OP_COLON, ":");
+                context.cursor = start + n;
+                push(getIdentifier(start));
             }
-            else if (match(','))
+            else
             {
-                push(TokenType::OP_COMMA, ",");
+                char32_t c;
+                n = std::max<size_t>(unicode::decode(start, context.end, c), 1);
+                context.cursor = start + n;
+                push(slice(TokenType::UNKNOWN, start, context.cursor));
             }
-            else if (match('?'))
+            break;
+        }
+        case chars::Start::Digit:
+            push(getNumber());
+            break;
+        case chars::Start::Identifier:
+            push(getIdentifier(start));
+            break;
+        case chars::Start::Quote:
+            push(getString(ch));
+            break;
+        case chars::Start::Template:
+            processTemplateString(push);
+            break;
+        case chars::Start::BraceBegin:
+            if (state.levelOfTemplateNesting > 0)
+            {
+                state.levelOfParanthesesNestingInTemplateInnerEvaluation += 1;
+            }
+            push(slice(TokenType::OP_BRACE_BEGIN, start, context.cursor));
+            break;
+        case chars::Start::BraceEnd:
+            // ֻģʽ ${ ûδպϵ { ʱ} Żصģַ
+            if (state.levelOfTemplateNesting > 0 && state.levelOfParanthesesNestingInTemplateInnerEvaluation == 0)
             {
-                push(TokenType::OP_QUESTION, "?");
+                processTemplateString(push);
+                break;
             }
-            else if (match(';'))
+            if (state.levelOfParanthesesNestingInTemplateInnerEvaluation > 0)
             {
-                push(TokenType::OP_SEMICOLON, ";");
+                state.levelOfParanthesesNestingInTemplateInnerEvaluation -= 1;
             }
-            else
+            push(slice(TokenType::OP_BRACE_END, start, context.cursor));
+            break;
+        case chars::Start::Dot:
+            if (chars::isDigit(context.lookNextchar()))
             {
-                if (ch == EOF)
-                {
-                    push(TokenType::END_OF_FILE, { ch });
-                }
-                else
-                {
-                    push(TokenType::UNKNOWN, { ch });
-                }
+                push(getNumber());
+                break;
             }
+            [[fallthrough]];
+        case chars::Start::Operator:
+        {
+            TokenType type = TokenType::UNKNOWN;
+            size_t n = std::max<size_t>(operatorTable.match(start, context.end, type), 1);
+            context.cursor = start + n;
+            push(slice(type, start, context.cursor));
+            break;
+        }
+        default:
+            push(slice(TokenType::UNKNOWN, start, context.cursor));
+            break;
         }
+        return true;
+    }
 
-        levelOfTemplateNesting = 0;
+    bool Lexer::affectsNext(TokenType type)
+    {
+        // ֻڵַ֮ϲ. ֮ĹؼֵʶΨһ token Ĺ
+        return type == TokenType::OP_DOT;
     }
 
-    std::vector<Lexer::Token> Lexer::getSequence()
+    Lexer::Sequence Lexer::getSequence()
     {
-        return std::move(sequence);
+        return { this };
     }
 
-    Lexer::Token Lexer::forwards(size_t n)
+    Lexer::TokenView Lexer::view(const Token& token) const
     {
-        auto offset = location + n;
-        if (it2idx(sequence, offset) >= sequence.size())
+        if (token.flags & Token::Payload)
+        {
+            return { token.type, { payload.data() + token.offset, token.length }, hasSymbol(token.type) ? token.attribute : 0 };
+        }
+        if (token.flags & Token::Synthetic)
         {
-            return { TokenType::END_OF_FILE, { EOF } };
+            return { token.type, spellingOf(token.type) };
         }
-        return *offset;
+        return { token.type, { context.begin + token.offset, token.length }, hasSymbol(token.type) ? token.attribute : 0 };
     }
-    Lexer::Token Lexer::backwards(size_t n)
+
+    uint32_t Lexer::symbolOf(const Token& token) const
     {
-        if (it2idx(sequence, location) < n)
+        if (interner == nullptr || !hasSymbol(token.type))
         {
-            // TODO...
+            return Interner::none;
         }
-        return *(location - n);
+        return interner->intern(view(token).value);
     }
-    Lexer::Token Lexer::go(size_t n)
+
+    Number Lexer::numberOf(const Token& token) const
     {
-        location += n;
-        return *location;
+        if (token.flags & Token::Spilled)
+        {
+            return number::read(payload.data(), token.attribute);
+        }
+        Number n;
+        n.integer = token.attribute;
+        n.real = token.attribute;
+        return n;
     }
-    Lexer::Token Lexer::last(size_t n)
+
+    Position Lexer::positionAt(size_t offset) const
     {
-        location -= n;
-        return *location;
+        // ԴʱԴ뻺ڵֱӴ begin 
+        if (context.begin == context.source.begin())
+        {
+            return context.source.buffer->lines().locate(offset);
+        }
+        return context.locate(context.begin + std::min(offset, static_cast<size_t>(context.end - context.begin)));
     }
-    Lexer::Token Lexer::now()
+
+    size_t Lexer::lineAt(size_t offset) const
     {
-        assert(sequence.size());
-        return sequence.at(0);
+        if (context.begin == context.source.begin())
+        {
+            return context.source.buffer->lines().lineOf(offset);
+        }
+        return positionAt(offset).line;
     }
 
-    size_t Lexer::tryFindingAfter(std::unordered_set<TokenType> patterns, TokenType t1, TokenType t2)
-    {                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                 
-        for (auto i = location; i != sequence.end() && patterns.find(*i) != patterns.end(); ++i)
+    Position Lexer::positionOf(size_t i) const
+    {
+        return positionAt(startOf(i));
+    }
+
+    size_t Lexer::lineOf(size_t i) const
+    {
+        return lineAt(startOf(i));
+    }
+
+    size_t Lexer::startOf(size_t i) const
+    {
+        Token t = sequence[i];
+        if (!(t.flags & Token::Payload))
         {
-            if (*i == t1)
+            return t.offset;
+        }
+
+        // ַָ payloadǰһԴ token ֮հףͷ
+        size_t from = 0;
+        for (size_t j = i; j-- > 0;)
+        {
+            Token previous = sequence[j];
+            if (!(previous.flags & Token::Payload))
             {
-                if (*(++i) == t2)
-                {
-                    return std::distance(location, i);
-                }
-                else
-                {
-                    return 0;
-                }
+                from = previous.offset + previous.length;
+                break;
             }
         }
-        return 0;
+        return static_cast<size_t>(scan::skipBlank(context.begin + from, context.end) - context.begin);
     }
-    
-    size_t Lexer::tryFinding(std::unordered_set<TokenType> patterns, TokenType t)
+
+    Lexer::TokenView Lexer::forwards(size_t n)
     {
-        for (auto i = location; i != sequence.end() && patterns.find(*i) != patterns.end(); ++i)
+        if (cursor + n >= sequence.size())
         {
-            if (*i == t)
-            {
-                return std::distance(location, i);
-            }
+            return { TokenType::END_OF_FILE, {} };
+        }
+        return view(sequence[cursor + n]);
+    }
+    Lexer::TokenView Lexer::backwards(size_t n)
+    {
+        if (cursor < n || cursor - n >= sequence.size())
+        {
+            return { TokenType::END_OF_FILE, {} };
+        }
+        return view(sequence[cursor - n]);
+    }
+    Lexer::TokenView Lexer::go(size_t n)
+    {
+        cursor += n;
+        return now();
+    }
+    Lexer::TokenView Lexer::last(size_t n)
+    {
+        cursor = cursor < n ? 0 : cursor - n;
+        return now();
+    }
+    Lexer::TokenView Lexer::now()
+    {
+        if (cursor >= sequence.size())
+        {
+            return { TokenType::END_OF_FILE, {} };
+        }
+        return view(sequence[cursor]);
+    }
+
+    //  cursor ʼҳģʽƥ䣬ÿ token һλͼ
+    static size_t matchingSpan(const TokenStream& stream, size_t from, TokenSet patterns)
+    {
+        size_t i = from, n = stream.size();
+        while (i < n && patterns.contains(stream.type(i)))
+        {
+            ++i;
+        }
+        return i;
+    }
+
+    size_t Lexer::tryFindingAfter(TokenSet patterns, TokenType t1, TokenType t2)
+    {
+        size_t end = matchingSpan(sequence, cursor, patterns);
+        size_t i = sequence.find(t1, cursor, end);
+        if (i == end || i + 1 >= sequence.size() || sequence.type(i + 1) != t2)
+        {
+            return 0;
         }
-        return 0;
+        return i + 1 - cursor;
+    }
+
+    size_t Lexer::tryFinding(TokenSet patterns, TokenType t)
+    {
+        size_t end = matchingSpan(sequence, cursor, patterns);
+        size_t i = sequence.find(t, cursor, end);
+        return i == end ? 0 : i - cursor;
+    }
+
+    bool Lexer::State::operator==(const State& s) const
+    {
+        return levelOfTemplateNesting == s.levelOfTemplateNesting
+            && levelOfParanthesesNestingInTemplateInnerEvaluation == s.levelOfParanthesesNestingInTemplateInnerEvaluation
+            && outerLevels == s.outerLevels;
     }
 
     bool Lexer::isEnd()
@@ -648,15 +646,100 @@ namespace lexer
     }
     std::unordered_map<std::string, Lexer::TokenType> Lexer::getKeywordMap()
     {
-        return keywordMap;
+        std::unordered_map<std::string, TokenType> map;
+        for (const auto& k : keywords)
+        {
+            map.emplace(k.name, k.type);
+        }
+        return map;
     }
-    std::unordered_set<Lexer::TokenType> Lexer::getOperatorSet()
+    TokenSet Lexer::getOperatorSet()
     {
+        // ڹ죬صֻ
+        static constexpr TokenSet operatorSet
+        {
+            TokenType::KEYWORD_IN |
+            TokenType::KEYWORD_OF |
+
+            TokenType::OP_ADD |
+            TokenType::OP_MINUS |
+            TokenType::OP_MUL |
+            TokenType::OP_INTDIV |
+            TokenType::OP_DIV |
+            TokenType::OP_MOD |
+            TokenType::OP_QUOTE |
+            TokenType::OP_POW |
+
+            TokenType::OP_ADD_ASSIGN |
+            TokenType::OP_MINUS_ASSIGN |
+            TokenType::OP_MUL_ASSIGN |
+            TokenType::OP_INTDIV_ASSIGN |
+            TokenType::OP_DIV_ASSIGN |
+            TokenType::OP_MOD_ASSIGN |
+            TokenType::OP_QUOTE_ASSIGN |
+            TokenType::OP_POW_ASSIGN |
+
+            TokenType::OP_LOGIC_NEGATE |
+            TokenType::OP_LOGIC_OR |
+            TokenType::OP_LOGIC_AND |
+
+            TokenType::OP_BIT_NEGATE |
+            TokenType::OP_BIT_OR |
+            TokenType::OP_BIT_AND |
+            TokenType::OP_BIT_XOR |
+
+            TokenType::OP_BIT_OR_ASSIGN |
+            TokenType::OP_BIT_AND_ASSIGN |
+            TokenType::OP_BIT_XOR_ASSIGN |
+
+            TokenType::OP_SHIFT_LEFT |
+            TokenType::OP_SHIFT_RIGHT |
+            TokenType::OP_SHIFT_LEFT_ASSIGN |
+            TokenType::OP_SHIFT_RIGHT_ASSIGN |
+
+            TokenType::OP_LESS_THAN |
+            TokenType::OP_GREATER_THAN |
+            TokenType::OP_LESS_EQUAL |
+            TokenType::OP_GREATER_EQUAL |
+            TokenType::OP_EQUAL |
+            TokenType::OP_NOT_EQUAL |
+
+            TokenType::OP_ASSIGN |
+            TokenType::OP_COLON |
+            TokenType::OP_QUESTION |
+            TokenType::OP_COMMA |
+            TokenType::OP_DOT |
+            TokenType::OP_DOT_DOT |
+            TokenType::OP_DOT_DOT_DOT |
+
+            TokenType::OP_PAREN_BEGIN |
+            TokenType::OP_PAREN_END |
+            TokenType::OP_BRACKET_BEGIN |
+            TokenType::OP_BRACKET_END |
+            TokenType::OP_BRACE_BEGIN |
+            TokenType::OP_BRACE_END
+        };
         return operatorSet;
     }
     void Lexer::error(std::string info)
     {
-        throw LexError{ "SyntaxError: " + info, context.lineOffset, context.charOffset };
+        Position p = context.locate(context.cursor);
+        throw LexError{ "SyntaxError: " + info, p.line, p.column };
+    }
+
+    void Lexer::diagnose(const char* message)
+    {
+        if (!options.recover)
+        {
+            error(message);
+        }
+        diagnostics.push_back({ static_cast<uint32_t>(context.cursor - context.begin), message });
+    }
+
+    Lexer::LexError Lexer::errorOf(const Diagnostic& diagnostic) const
+    {
+        Position p = positionAt(diagnostic.offset);
+        return { std::string("SyntaxError: ") + diagnostic.message, p.line, p.column };
     }
 }
 }
@@ -0,0 +1,227 @@
+#include <lines.hh>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLANER_LINES_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace flaner
+{
+namespace lexer
+{
+    namespace
+    {
+        inline unsigned lowestBit(uint32_t mask)
+        {
+#ifdef _MSC_VER
+            unsigned long i;
+            _BitScanForward(&i, mask);
+            return static_cast<unsigned>(i);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        inline unsigned highestBit(uint32_t mask)
+        {
+#ifdef _MSC_VER
+            unsigned long i;
+            _BitScanReverse(&i, mask);
+            return static_cast<unsigned>(i);
+#else
+            return 31 - static_cast<unsigned>(__builtin_clz(mask));
+#endif
+        }
+
+        inline unsigned popCount(uint32_t mask)
+        {
+#ifdef _MSC_VER
+            return static_cast<unsigned>(__popcnt(mask));
+#else
+            return static_cast<unsigned>(__builtin_popcount(mask));
+#endif
+        }
+
+#ifdef FLANER_LINES_SSE2
+        // p 起 16 字节中 \n 的位置
+        inline uint32_t newlineMask(const char* p)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n'))));
+        }
+#endif
+
+        // UTF-8 字符数，即不是后续字节的字节数
+        size_t countCharacters(const char* p, const char* end)
+        {
+            size_t n = 0;
+            for (; p < end; ++p)
+            {
+                n += (static_cast<unsigned char>(*p) & 0xc0) != 0x80;
+            }
+            return n;
+        }
+    }
+
+    LineIndex::LineIndex(const char* begin, const char* end)
+        : begin(begin), end(end), lines(0)
+    {
+        uint64_t starts[blockLines];
+        size_t count = 0;
+        starts[count++] = 0;
+        auto add = [&](const char* next) {
+            starts[count++] = static_cast<uint64_t>(next - begin);
+            if (count == blockLines)
+            {
+                addBlock(starts, count);
+                count = 0;
+            }
+        };
+
+        const char* p = begin;
+#ifdef FLANER_LINES_SSE2
+        for (; end - p >= 16; p += 16)
+        {
+            for (uint32_t mask = newlineMask(p); mask != 0; mask &= mask - 1)
+            {
+                add(p + lowestBit(mask) + 1);
+            }
+        }
+#endif
+        for (; p < end; ++p)
+        {
+            if (*p == '\n')
+            {
+                add(p + 1);
+            }
+        }
+        if (count > 0)
+        {
+            addBlock(starts, count);
+        }
+        blocks.shrink_to_fit();
+        narrow.shrink_to_fit();
+        wide.shrink_to_fit();
+    }
+
+    void LineIndex::addBlock(const uint64_t* starts, size_t count)
+    {
+        Block block{ starts[0], 0 };
+        if (starts[count - 1] - starts[0] <= UINT16_MAX)
+        {
+            block.at = static_cast<uint32_t>(narrow.size());
+            for (size_t i = 0; i < count; ++i)
+            {
+                narrow.push_back(static_cast<uint16_t>(starts[i] - block.base));
+            }
+        }
+        else
+        {
+            block.at = static_cast<uint32_t>(wide.size()) | wideBlock;
+            for (size_t i = 0; i < count; ++i)
+            {
+                wide.push_back(static_cast<uint32_t>(starts[i] - block.base));
+            }
+        }
+        blocks.push_back(block);
+        lines += count;
+    }
+
+    size_t LineIndex::lineStart(size_t line) const
+    {
+        if (line == 0 || line > lines)
+        {
+            return static_cast<size_t>(end - begin);
+        }
+        size_t k = (line - 1) / blockLines, j = (line - 1) % blockLines;
+        const Block& b = blocks[k];
+        uint32_t delta = b.at & wideBlock ? wide[(b.at & ~wideBlock) + j] : narrow[b.at + j];
+        return static_cast<size_t>(b.base + delta);
+    }
+
+    Position LineIndex::locate(size_t offset) const
+    {
+        if (blocks.empty())
+        {
+            return {};
+        }
+        offset = std::min(offset, static_cast<size_t>(end - begin));
+        size_t line = lineOf(offset);
+        return { line, columnOf(lineStart(line), offset) + 1 };
+    }
+
+    size_t LineIndex::lineOf(size_t offset) const
+    {
+        if (blocks.empty())
+        {
+            return 1;
+        }
+        offset = std::min(offset, static_cast<size_t>(end - begin));
+
+        // 最后一个起点不超过 offset 的块，再在块内找最后一个起点不超过 offset 的行
+        auto it = std::upper_bound(blocks.begin(), blocks.end(), offset, [](size_t o, const Block& b) {
+            return o < b.base;
+        });
+        size_t k = static_cast<size_t>(it - blocks.begin()) - 1;
+        const Block& b = blocks[k];
+        size_t count = std::min(blockLines, lines - k * blockLines);
+        uint64_t delta = offset - b.base;
+        size_t j;
+        if (b.at & wideBlock)
+        {
+            const uint32_t* d = wide.data() + (b.at & ~wideBlock);
+            j = static_cast<size_t>(std::upper_bound(d, d + count, delta) - d) - 1;
+        }
+        else
+        {
+            const uint16_t* d = narrow.data() + b.at;
+            j = static_cast<size_t>(std::upper_bound(d, d + count, delta) - d) - 1;
+        }
+
+        return k * blockLines + j + 1;
+    }
+
+    size_t LineIndex::columnOf(size_t lineStart, size_t offset) const
+    {
+        return countCharacters(begin + lineStart, begin + offset);
+    }
+
+    size_t LineIndex::memoryUsage() const
+    {
+        return blocks.capacity() * sizeof(Block) + narrow.capacity() * sizeof(uint16_t) + wide.capacity() * sizeof(uint32_t);
+    }
+
+    Position LineIndex::scan(const char* begin, const char* at)
+    {
+        Position position;
+        const char* lineStart = begin;
+        const char* p = begin;
+#ifdef FLANER_LINES_SSE2
+        for (; at - p >= 16; p += 16)
+        {
+            uint32_t mask = newlineMask(p);
+            if (mask != 0)
+            {
+                position.line += popCount(mask);
+                lineStart = p + highestBit(mask) + 1;
+            }
+        }
+#endif
+        for (; p < at; ++p)
+        {
+            if (*p == '\n')
+            {
+                position.line += 1;
+                lineStart = p + 1;
+            }
+        }
+        position.column = countCharacters(lineStart, at) + 1;
+        return position;
+    }
+}
+}
@@ -0,0 +1,452 @@
+#include <number.hh>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace flaner
+{
+namespace lexer
+{
+namespace number
+{
+    // 字面量的整数部分和小数部分最多的十进制位数（含指数），超过时视为错误
+    static constexpr long long maxDigits = 1 << 16;
+
+    // 任意精度无符号整数，32 位分段，低位在前，没有前导零段
+    using Big = std::vector<uint32_t>;
+
+    static void multiplyAdd(Big& a, uint32_t m, uint32_t add)
+    {
+        uint64_t carry = add;
+        for (uint32_t& limb : a)
+        {
+            uint64_t v = uint64_t(limb) * m + carry;
+            limb = static_cast<uint32_t>(v);
+            carry = v >> 32;
+        }
+        if (carry)
+        {
+            a.push_back(static_cast<uint32_t>(carry));
+        }
+    }
+
+    // a 除以 d，返回余数
+    static uint32_t divide(Big& a, uint32_t d)
+    {
+        uint64_t rest = 0;
+        for (size_t i = a.size(); i-- > 0;)
+        {
+            uint64_t v = rest << 32 | a[i];
+            a[i] = static_cast<uint32_t>(v / d);
+            rest = v % d;
+        }
+        while (!a.empty() && a.back() == 0)
+        {
+            a.pop_back();
+        }
+        return static_cast<uint32_t>(rest);
+    }
+
+    static bool divisible(const Big& a, uint32_t d)
+    {
+        uint64_t rest = 0;
+        for (size_t i = a.size(); i-- > 0;)
+        {
+            rest = (rest << 32 | a[i]) % d;
+        }
+        return rest == 0;
+    }
+
+    static void multiplyPow10(Big& a, long long n)
+    {
+        for (; n >= 9; n -= 9)
+        {
+            multiplyAdd(a, 1000000000u, 0);
+        }
+        static const uint32_t pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+        multiplyAdd(a, pow10[n], 0);
+    }
+
+    // 十进制数字串转成 Big，每次处理 9 位
+    static Big parseDigits(std::string_view digits)
+    {
+        Big a;
+        size_t i = 0;
+        while (i < digits.size())
+        {
+            size_t n = std::min<size_t>(9, digits.size() - i);
+            uint32_t chunk = 0, scale = 1;
+            for (size_t k = 0; k < n; ++k)
+            {
+                chunk = chunk * 10 + static_cast<uint32_t>(digits[i + k] - '0');
+                scale *= 10;
+            }
+            multiplyAdd(a, scale, chunk);
+            i += n;
+        }
+        while (!a.empty() && a.back() == 0)
+        {
+            a.pop_back();
+        }
+        return a;
+    }
+
+    // 字面量拆成整数部分、小数部分和指数
+    struct Parts
+    {
+        std::string_view whole, fraction;
+        bool dot = false, exponent = false;
+        // 超过 maxDigits 时截断，只用于判断范围
+        long long power = 0;
+    };
+
+    static Parts split(std::string_view text)
+    {
+        Parts p;
+        size_t i = 0;
+        while (i < text.size() && text[i] >= '0' && text[i] <= '9')
+        {
+            ++i;
+        }
+        p.whole = text.substr(0, i);
+        if (i < text.size() && text[i] == '.')
+        {
+            p.dot = true;
+            size_t from = ++i;
+            while (i < text.size() && text[i] >= '0' && text[i] <= '9')
+            {
+                ++i;
+            }
+            p.fraction = text.substr(from, i - from);
+        }
+        if (i < text.size() && text[i] == 'e')
+        {
+            p.exponent = true;
+            bool negative = ++i < text.size() && text[i] == '-';
+            if (i < text.size() && (text[i] == '+' || text[i] == '-'))
+            {
+                ++i;
+            }
+            for (; i < text.size(); ++i)
+            {
+                p.power = std::min(p.power * 10 + (text[i] - '0'), maxDigits * 4);
+            }
+            p.power = negative ? -p.power : p.power;
+        }
+        return p;
+    }
+
+    // 科学计数法中第一个非零数字的十进制指数，全为零时返回 LLONG_MIN
+    static long long magnitude(const Parts& p)
+    {
+        size_t lead = p.whole.find_first_not_of('0');
+        if (lead != std::string_view::npos)
+        {
+            return static_cast<long long>(p.whole.size() - lead) - 1 + p.power;
+        }
+        size_t first = p.fraction.find_first_not_of('0');
+        if (first != std::string_view::npos)
+        {
+            return -static_cast<long long>(first) - 1 + p.power;
+        }
+        return std::numeric_limits<long long>::min();
+    }
+
+    template <typename T>
+    static void append(std::pmr::string& payload, T v)
+    {
+        payload.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    static void appendLimbs(std::pmr::string& payload, const Big& a)
+    {
+        payload.append(reinterpret_cast<const char*>(a.data()), a.size() * sizeof(uint32_t));
+    }
+
+    const char* decode(std::string_view text, TokenType type, std::pmr::string& payload, Decoded& out)
+    {
+        if (type != TokenType::NUMBER)
+        {
+            // 去掉后缀
+            text.remove_suffix(1);
+        }
+        Parts parts = split(text);
+        if (parts.exponent && (text.back() < '0' || text.back() > '9'))
+        {
+            return "Invalid numeric literal";
+        }
+        out.spilled = true;
+        out.attribute = static_cast<uint32_t>(payload.size());
+
+        if (type == TokenType::NUMBER)
+        {
+            if (!parts.dot && !parts.exponent && parts.whole.size() <= 19)
+            {
+                // 整数的快速路径：19 位以内不会溢出 uint64_t
+                uint64_t v = 0;
+                for (char ch : parts.whole)
+                {
+                    v = v * 10 + static_cast<uint64_t>(ch - '0');
+                }
+                if (v <= UINT32_MAX)
+                {
+                    out.spilled = false;
+                    out.attribute = static_cast<uint32_t>(v);
+                    return nullptr;
+                }
+                append(payload, static_cast<uint32_t>(Number::Kind::Integer));
+                append(payload, v);
+                return nullptr;
+            }
+            if (!parts.dot && !parts.exponent)
+            {
+                uint64_t v;
+                auto r = std::from_chars(text.data(), text.data() + text.size(), v);
+                if (r.ec == std::errc())
+                {
+                    append(payload, static_cast<uint32_t>(Number::Kind::Integer));
+                    append(payload, v);
+                    return nullptr;
+                }
+            }
+
+            // 有效数字不超过 2^53、十进制指数不超过 22 时，尾数和 10 的幂都能精确表示为 double，
+            // 一次乘除就是正确舍入的结果（Clinger 快速路径）。其余交给 from_chars
+            double d = 0;
+            if (parts.whole.size() + parts.fraction.size() <= 15)
+            {
+                uint64_t mantissa = 0;
+                for (char ch : parts.whole)
+                {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(ch - '0');
+                }
+                for (char ch : parts.fraction)
+                {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(ch - '0');
+                }
+                long long e = parts.power - static_cast<long long>(parts.fraction.size());
+                static const double pow10[] = {
+                    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+                };
+                if (e >= -22 && e <= 22)
+                {
+                    d = e >= 0 ? static_cast<double>(mantissa) * pow10[e] : static_cast<double>(mantissa) / pow10[-e];
+                    append(payload, static_cast<uint32_t>(Number::Kind::Float));
+                    append(payload, d);
+                    return nullptr;
+                }
+            }
+
+            // from_chars 给出正确舍入的结果；超出范围时它不写入结果，溢出按 inf、下溢按 0 处理
+            auto r = std::from_chars(text.data(), text.data() + text.size(), d);
+            if (r.ec == std::errc::result_out_of_range)
+            {
+                d = magnitude(parts) >= 0 ? std::numeric_limits<double>::infinity() : 0.0;
+            }
+            else if (r.ec != std::errc() || r.ptr != text.data() + text.size())
+            {
+                return "Invalid numeric literal";
+            }
+            append(payload, static_cast<uint32_t>(Number::Kind::Float));
+            append(payload, d);
+            return nullptr;
+        }
+
+        if (type == TokenType::BIGINT)
+        {
+            if (parts.dot || parts.exponent)
+            {
+                return "Invalid BigInt literal";
+            }
+            if (static_cast<long long>(parts.whole.size()) > maxDigits)
+            {
+                return "Numeric literal is too large";
+            }
+            Big value = parseDigits(parts.whole);
+            append(payload, static_cast<uint32_t>(Number::Kind::BigInt));
+            append(payload, static_cast<uint32_t>(value.size()));
+            appendLimbs(payload, value);
+            return nullptr;
+        }
+
+        // 有理数：全部数字作分子，10 的小数位数次方作分母，再乘上指数，最后约去 2 和 5
+        Big numerator, denominator{ 1 };
+        std::string digits{ parts.whole };
+        digits.append(parts.fraction);
+        long long shift = parts.power - static_cast<long long>(parts.fraction.size());
+        bool zero = magnitude(parts) == std::numeric_limits<long long>::min();
+        if (!zero && (static_cast<long long>(digits.size()) + (shift < 0 ? -shift : shift) > maxDigits))
+        {
+            return "Numeric literal is too large";
+        }
+        if (!zero)
+        {
+            numerator = parseDigits(digits);
+            multiplyPow10(shift > 0 ? numerator : denominator, shift > 0 ? shift : -shift);
+            for (uint32_t prime : { 2u, 5u })
+            {
+                while (divisible(numerator, prime) && divisible(denominator, prime))
+                {
+                    divide(numerator, prime);
+                    divide(denominator, prime);
+                }
+            }
+        }
+        append(payload, static_cast<uint32_t>(Number::Kind::Rational));
+        append(payload, static_cast<uint32_t>(numerator.size()));
+        append(payload, static_cast<uint32_t>(denominator.size()));
+        appendLimbs(payload, numerator);
+        appendLimbs(payload, denominator);
+        return nullptr;
+    }
+
+    template <typename T>
+    static T load(const char* p)
+    {
+        T v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    Number read(const char* payload, uint32_t offset)
+    {
+        const char* p = payload + offset;
+        Number n;
+        n.kind = static_cast<Number::Kind>(load<uint32_t>(p));
+        p += sizeof(uint32_t);
+        switch (n.kind)
+        {
+        case Number::Kind::Integer:
+            n.integer = load<uint64_t>(p);
+            n.real = static_cast<double>(n.integer);
+            break;
+        case Number::Kind::Float:
+            n.real = load<double>(p);
+            break;
+        case Number::Kind::BigInt:
+            n.numerator = { p + sizeof(uint32_t), load<uint32_t>(p) };
+            break;
+        case Number::Kind::Rational:
+        {
+            uint32_t a = load<uint32_t>(p), b = load<uint32_t>(p + sizeof(uint32_t));
+            n.numerator = { p + 2 * sizeof(uint32_t), a };
+            n.denominator = { p + (2 + a) * sizeof(uint32_t), b };
+            break;
+        }
+        }
+        return n;
+    }
+
+    size_t recordSize(const char* payload, uint32_t offset)
+    {
+        const char* p = payload + offset;
+        switch (static_cast<Number::Kind>(load<uint32_t>(p)))
+        {
+        case Number::Kind::BigInt:
+            return 2 * sizeof(uint32_t) + load<uint32_t>(p + sizeof(uint32_t)) * sizeof(uint32_t);
+        case Number::Kind::Rational:
+            return 3 * sizeof(uint32_t)
+                + (load<uint32_t>(p + sizeof(uint32_t)) + load<uint32_t>(p + 2 * sizeof(uint32_t))) * sizeof(uint32_t);
+        default:
+            return sizeof(uint32_t) + 8;
+        }
+    }
+}
+
+    static number::Big toBig(const Number::Limbs& limbs)
+    {
+        number::Big a(limbs.size());
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            a[i] = limbs[i];
+        }
+        return a;
+    }
+
+    static double approximateOf(const Number::Limbs& limbs)
+    {
+        double v = 0;
+        for (size_t i = limbs.size(); i-- > 0;)
+        {
+            v = v * 4294967296.0 + limbs[i];
+        }
+        return v;
+    }
+
+    static std::string decimalOf(const Number::Limbs& limbs)
+    {
+        number::Big a = toBig(limbs);
+        if (a.empty())
+        {
+            return "0";
+        }
+        std::string s;
+        while (!a.empty())
+        {
+            uint32_t chunk = number::divide(a, 1000000000u);
+            for (int k = 0; k < 9 && (chunk != 0 || !a.empty()); ++k)
+            {
+                s += static_cast<char>('0' + chunk % 10);
+                chunk /= 10;
+            }
+        }
+        return { s.rbegin(), s.rend() };
+    }
+
+    double Number::approximate() const
+    {
+        switch (kind)
+        {
+        case Kind::Integer:
+            return static_cast<double>(integer);
+        case Kind::Float:
+            return real;
+        case Kind::BigInt:
+            return approximateOf(numerator);
+        case Kind::Rational:
+        {
+            // 分子分母都很大时先同时缩小，避免 inf / inf
+            uint32_t drop = std::min(numerator.size(), denominator.size());
+            drop = drop > 30 ? drop - 30 : 0;
+            double a = 0, b = 0;
+            for (size_t i = numerator.size(); i-- > drop;)
+            {
+                a = a * 4294967296.0 + numerator[i];
+            }
+            for (size_t i = denominator.size(); i-- > drop;)
+            {
+                b = b * 4294967296.0 + denominator[i];
+            }
+            return a / b;
+        }
+        }
+        return 0;
+    }
+
+    std::string Number::toString() const
+    {
+        switch (kind)
+        {
+        case Kind::Integer:
+            return std::to_string(integer);
+        case Kind::Float:
+        {
+            if (std::isinf(real))
+            {
+                return "inf";
+            }
+            char buffer[32];
+            auto r = std::to_chars(buffer, buffer + sizeof(buffer), real);
+            return { buffer, r.ptr };
+        }
+        case Kind::BigInt:
+            return decimalOf(numerator);
+        case Kind::Rational:
+            return decimalOf(numerator) + "/" + decimalOf(denominator);
+        }
+        return {};
+    }
+}
+}
@@ -0,0 +1,131 @@
+#include <parallel.hh>
+#include <cstring>
+
+namespace flaner
+{
+namespace lexer
+{
+    const char* ParallelLexer::resume(Lexer& lexer, const char* at, const char* to)
+    {
+        Context& c = lexer.context;
+        c.cursor = at;
+        while (true)
+        {
+            c.cursor = scan::skipBlank(c.cursor, c.end);
+            if (c.cursor >= to || !lexer.step())
+            {
+                return c.cursor;
+            }
+        }
+    }
+
+    void ParallelLexer::speculate(Chunk& chunk)
+    {
+        chunk.entry = scan::skipBlank(chunk.from, chunk.lexer.context.end);
+        try
+        {
+            chunk.exit = resume(chunk.lexer, chunk.from, chunk.to);
+        }
+        catch (...)
+        {
+            chunk.failure = std::current_exception();
+        }
+    }
+
+    Lexer ParallelLexer::lex(io::Source source, ThreadPool& pool, size_t chunkSize, Interner* interner, Lexer::Options options)
+    {
+        Lexer result{ Context(source), std::pmr::get_default_resource(), interner };
+        result.options = options;
+        const char* begin = result.context.begin;
+        const char* end = result.context.end;
+
+        if (pool.size() < 2 || chunkSize == 0 || source.size() < chunkSize * 2)
+        {
+            result.process();
+            return result;
+        }
+        if (source.size() > UINT32_MAX)
+        {
+            result.error("Source is too large");
+        }
+        result.checkEncoding();
+
+        FLANER_STATS(stats::PhaseTimer timer(stats::Phase::Lex);)
+
+        // 每块从换行之后开始
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        const char* from = begin;
+        while (from < end)
+        {
+            const char* to = end;
+            if (static_cast<size_t>(end - from) > chunkSize)
+            {
+                auto newline = static_cast<const char*>(std::memchr(from + chunkSize, '\n', end - from - chunkSize));
+                to = newline ? newline + 1 : end;
+            }
+            chunks.push_back(std::make_unique<Chunk>(result.context, interner, options, from, to));
+            from = to;
+        }
+
+        pool.parallelFor(chunks.size(), [&](size_t i) {
+            speculate(*chunks[i]);
+        });
+
+        // 按顺序拼接：入口和猜测一致的块直接采用，否则从真实位置接着串行分析
+        TokenStream& sequence = result.sequence;
+        size_t total = 0;
+        for (auto& chunk : chunks)
+        {
+            total += chunk->lexer.sequence.size();
+        }
+        sequence.reserve(total);
+
+        const char* at = begin;
+        for (auto& chunk : chunks)
+        {
+            bool guessed = scan::skipBlank(at, end) == chunk->entry
+                && result.state == Lexer::State{}
+                && (sequence.empty() || !Lexer::affectsNext(sequence.back().type));
+
+            if (!guessed)
+            {
+                at = resume(result, at, chunk->to);
+                continue;
+            }
+            if (chunk->failure)
+            {
+                std::rethrow_exception(chunk->failure);
+            }
+
+            const TokenStream& tokens = chunk->lexer.sequence;
+            uint32_t payloadBase = static_cast<uint32_t>(result.payload.size());
+            for (size_t i = 0; i < tokens.size(); ++i)
+            {
+                Token t = tokens[i];
+                if (t.flags & Token::Payload)
+                {
+                    t.offset += payloadBase;
+                }
+                if (t.flags & Token::Spilled)
+                {
+                    t.attribute += payloadBase;
+                }
+                sequence.push_back(t);
+            }
+            result.payload += chunk->lexer.payload;
+            // recover 模式下块中的错误：偏移都相对于整个源码，按块的顺序接上即可
+            const auto& diagnostics = chunk->lexer.diagnostics;
+            result.diagnostics.insert(result.diagnostics.end(), diagnostics.begin(), diagnostics.end());
+            result.state = chunk->lexer.state;
+            at = chunk->exit;
+            chunk.reset();
+        }
+
+        // 括号可能跨块配对，拼接完成后整体重新记录
+        sequence.matchBrackets();
+        result.context.cursor = end;
+        result.state = Lexer::State{};
+        return result;
+    }
+}
+}
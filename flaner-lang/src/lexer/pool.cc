@@ -0,0 +1,158 @@
+#include <pool.hh>
+
+namespace flaner
+{
+namespace lexer
+{
+    ThreadPool::ThreadPool(unsigned threads)
+        : job(nullptr), remaining(0),
+        generation(0), active(0), stopping(false)
+    {
+        if (threads == 0)
+        {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads == 0)
+        {
+            threads = 1;
+        }
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned i = 0; i + 1 < threads; ++i)
+        {
+            workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+    }
+
+    void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& f)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &f;
+            failure = nullptr;
+            remaining = n;
+            // 连续的下标分给同一个队列，窃取时从队首拿走离主人最远的任务
+            size_t count = queues.size();
+            for (size_t q = 0; q < count; ++q)
+            {
+                std::lock_guard<std::mutex> guard(queues[q]->mutex);
+                for (size_t i = n * q / count; i < n * (q + 1) / count; ++i)
+                {
+                    queues[q]->items.push_back(i);
+                }
+            }
+            generation += 1;
+        }
+        wake.notify_all();
+
+        unsigned self = size() - 1;
+        while (runOne(self))
+        {
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return remaining == 0 && active == 0; });
+        job = nullptr;
+        if (failure)
+        {
+            std::exception_ptr e = failure;
+            failure = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    void ThreadPool::work(unsigned self)
+    {
+        unsigned long long seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+                active += 1;
+            }
+
+            while (runOne(self))
+            {
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                active -= 1;
+            }
+            done.notify_all();
+        }
+    }
+
+    bool ThreadPool::runOne(unsigned self)
+    {
+        size_t index = 0;
+        bool found = false;
+        {
+            Queue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.items.empty())
+            {
+                index = own.items.back();
+                own.items.pop_back();
+                found = true;
+            }
+        }
+        for (size_t k = 1; !found && k < queues.size(); ++k)
+        {
+            Queue& victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.items.empty())
+            {
+                index = victim.items.front();
+                victim.items.pop_front();
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            return false;
+        }
+
+        try
+        {
+            (*job)(index);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure)
+            {
+                failure = std::current_exception();
+            }
+        }
+        remaining -= 1;
+        return true;
+    }
+}
+}
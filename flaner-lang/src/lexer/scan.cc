@@ -0,0 +1,517 @@
+#include <scan.hh>
+#include <chars.hh>
+#include <unicode.hh>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FLANER_SCAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FLANER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FLANER_TARGET(isa)
+#endif
+
+namespace flaner
+{
+namespace lexer
+{
+namespace scan
+{
+    namespace
+    {
+        inline uint8_t classOf(char c)
+        {
+            return chars::table.classOf(c);
+        }
+
+        inline unsigned lowestBit(uint32_t mask)
+        {
+#ifdef _MSC_VER
+            unsigned long i;
+            _BitScanForward(&i, mask);
+            return static_cast<unsigned>(i);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        // 标量实现，也用于各向量实现处理不足一个寄存器宽的尾部
+
+        const char* scalarSkipAsciiBlank(const char* p, const char* end)
+        {
+            while (p < end && (classOf(*p) & chars::Blank))
+            {
+                ++p;
+            }
+            return p;
+        }
+
+        const char* scalarSkipIdentifier(const char* p, const char* end)
+        {
+            while (p < end && (classOf(*p) & chars::IdentPart))
+            {
+                ++p;
+            }
+            return p;
+        }
+
+        const char* scalarFindStringSpecial(const char* p, const char* end, char mark)
+        {
+            while (p < end && *p != mark && *p != '\\' && *p != '\n' && *p != '\r')
+            {
+                ++p;
+            }
+            return p;
+        }
+
+        const char* scalarFindTemplateSpecial(const char* p, const char* end)
+        {
+            while (p < end && *p != '`' && *p != '\\' && *p != '$')
+            {
+                ++p;
+            }
+            return p;
+        }
+
+        const char* scalarSkipUtf8(const char* p, const char* end)
+        {
+            while (p < end)
+            {
+                // 一次检查 8 个字节的最高位
+                uint64_t word;
+                if (end - p >= 8 && (std::memcpy(&word, p, 8), (word & 0x8080808080808080ull) == 0))
+                {
+                    p += 8;
+                    continue;
+                }
+                char32_t c;
+                size_t n = unicode::decode(p, end, c);
+                if (n == 0)
+                {
+                    return p;
+                }
+                p += n;
+            }
+            return p;
+        }
+
+        // 已确认 [begin, p) 中完整的序列都合法时，退回到 p 所在序列的起点，
+        // 使截断在 p 处的序列交给标量实现重新校验
+        inline const char* sequenceStart(const char* begin, const char* p)
+        {
+            for (const char* q = p; q > begin && p - q < 3;)
+            {
+                unsigned char b = static_cast<unsigned char>(*--q);
+                if (b < 0x80)
+                {
+                    break;
+                }
+                if (b >= 0xc0)
+                {
+                    size_t length = b >= 0xf0 ? 4 : b >= 0xe0 ? 3 : 2;
+                    return static_cast<size_t>(p - q) < length ? q : p;
+                }
+            }
+            return p;
+        }
+
+#ifdef FLANER_SCAN_X86
+
+        // SSE2，每次 16 字节
+
+        // 无符号比较 lo <= x <= hi
+        FLANER_TARGET("sse2") inline __m128i inRange128(__m128i x, char lo, char hi)
+        {
+            __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+            return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(static_cast<char>(hi - lo))), d);
+        }
+
+        FLANER_TARGET("sse2") const char* sse2SkipAsciiBlank(const char* p, const char* end)
+        {
+            for (; end - p >= 16; p += 16)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i blank = _mm_or_si128(inRange128(x, '\t', '\r'), _mm_cmpeq_epi8(x, _mm_set1_epi8(' ')));
+                uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(blank)) & 0xffff;
+                if (mask)
+                {
+                    return p + lowestBit(mask);
+                }
+            }
+            return scalarSkipAsciiBlank(p, end);
+        }
+
+        FLANER_TARGET("sse2") const char* sse2SkipIdentifier(const char* p, const char* end)
+        {
+            for (; end - p >= 16; p += 16)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i ident = _mm_or_si128(
+                    _mm_or_si128(inRange128(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z'), inRange128(x, '0', '9')),
+                    _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('_')), _mm_cmpeq_epi8(x, _mm_set1_epi8('$'))));
+                uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(ident)) & 0xffff;
+                if (mask)
+                {
+                    return p + lowestBit(mask);
+                }
+            }
+            return scalarSkipIdentifier(p, end);
+        }
+
+        FLANER_TARGET("sse2") const char* sse2FindStringSpecial(const char* p, const char* end, char mark)
+        {
+            for (; end - p >= 16; p += 16)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i hit = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(mark)), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+                if (mask)
+                {
+                    return p + lowestBit(mask);
+                }
+            }
+            return scalarFindStringSpecial(p, end, mark);
+        }
+
+        FLANER_TARGET("sse2") const char* sse2FindTemplateSpecial(const char* p, const char* end)
+        {
+            for (; end - p >= 16; p += 16)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i hit = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('`')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'))),
+                    _mm_cmpeq_epi8(x, _mm_set1_epi8('$')));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+                if (mask)
+                {
+                    return p + lowestBit(mask);
+                }
+            }
+            return scalarFindTemplateSpecial(p, end);
+        }
+
+        FLANER_TARGET("sse2") const char* sse2SkipUtf8(const char* p, const char* end)
+        {
+            while (end - p >= 16)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(x));
+                if (mask == 0)
+                {
+                    p += 16;
+                    continue;
+                }
+                // 含非 ASCII 字节的块从第一个这样的字节起逐个序列解码，直到越过块尾
+                const char* stop = p + 16;
+                p += lowestBit(mask);
+                while (p < stop)
+                {
+                    char32_t c;
+                    size_t n = unicode::decode(p, end, c);
+                    if (n == 0)
+                    {
+                        return p;
+                    }
+                    p += n;
+                }
+            }
+            return scalarSkipUtf8(p, end);
+        }
+
+        // AVX2，每次 32 字节
+
+        FLANER_TARGET("avx2") inline __m256i inRange256(__m256i x, char lo, char hi)
+        {
+            __m256i d = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(static_cast<char>(hi - lo))), d);
+        }
+
+        FLANER_TARGET("avx2") const char* avx2SkipAsciiBlank(const char* p, const char* end)
+        {
+            for (; end - p >= 32; p += 32)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                __m256i blank = _mm256_or_si256(inRange256(x, '\t', '\r'), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')));
+                uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(blank));
+                if (mask)
+                {
+                    return p + lowestBit(mask);
+                }
+            }
+            return sse2SkipAsciiBlank(p, end);
+        }
+
+        FLANER_TARGET("avx2") const char* avx2SkipIdentifier(const char* p, const char* end)
+        {
+            for (; end - p >= 32; p += 32)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                __m256i ident = _mm256_or_si256(
+                    _mm256_or_si256(inRange256(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z'), inRange256(x, '0', '9')),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('$'))));
+                uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(ident));
+                if (mask)
+                {
+                    return p + lowestBit(mask);
+                }
+            }
+            return sse2SkipIdentifier(p, end);
+        }
+
+        FLANER_TARGET("avx2") const char* avx2FindStringSpecial(const char* p, const char* end, char mark)
+        {
+            for (; end - p >= 32; p += 32)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                __m256i hit = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(mark)), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\'))),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r'))));
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+                if (mask)
+                {
+                    return p + lowestBit(mask);
+                }
+            }
+            return sse2FindStringSpecial(p, end, mark);
+        }
+
+        FLANER_TARGET("avx2") const char* avx2FindTemplateSpecial(const char* p, const char* end)
+        {
+            for (; end - p >= 32; p += 32)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                __m256i hit = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('`')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\'))),
+                    _mm256_cmpeq_epi8(x, _mm256_set1_epi8('$')));
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+                if (mask)
+                {
+                    return p + lowestBit(mask);
+                }
+            }
+            return sse2FindTemplateSpecial(p, end);
+        }
+
+        // 按查表法校验 UTF-8：由每个字节与前一个字节的高、低 4 位查出它可能违反的规则，
+        // 三张表的结果相与不为零即出错；前面第 2、3 个字节是 3、4 字节序列的首字节时，
+        // 当前字节必须是后续字节。参见 Keiser 和 Lemire 的 Validating UTF-8 In Less Than One Instruction Per Byte
+        enum : uint8_t
+        {
+            TooShort = 1 << 0,
+            TooLong = 1 << 1,
+            Overlong3 = 1 << 2,
+            TooLarge = 1 << 3,
+            Surrogate = 1 << 4,
+            Overlong2 = 1 << 5,
+            TooLarge1000 = 1 << 6,
+            Overlong4 = 1 << 6,
+            TwoConts = 1 << 7,
+            Carry = TooShort | TooLong | TwoConts,
+        };
+
+        FLANER_TARGET("avx2") inline __m256i table256(
+            uint8_t t0, uint8_t t1, uint8_t t2, uint8_t t3, uint8_t t4, uint8_t t5, uint8_t t6, uint8_t t7,
+            uint8_t t8, uint8_t t9, uint8_t t10, uint8_t t11, uint8_t t12, uint8_t t13, uint8_t t14, uint8_t t15)
+        {
+            __m128i t = _mm_setr_epi8(
+                static_cast<char>(t0), static_cast<char>(t1), static_cast<char>(t2), static_cast<char>(t3),
+                static_cast<char>(t4), static_cast<char>(t5), static_cast<char>(t6), static_cast<char>(t7),
+                static_cast<char>(t8), static_cast<char>(t9), static_cast<char>(t10), static_cast<char>(t11),
+                static_cast<char>(t12), static_cast<char>(t13), static_cast<char>(t14), static_cast<char>(t15));
+            return _mm256_broadcastsi128_si256(t);
+        }
+
+        FLANER_TARGET("avx2") const char* avx2SkipUtf8(const char* p, const char* end)
+        {
+            const char* begin = p;
+            const __m256i firstHigh = table256(
+                TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+                TwoConts, TwoConts, TwoConts, TwoConts,
+                TooShort | Overlong2,
+                TooShort,
+                TooShort | Overlong3 | Surrogate,
+                TooShort | TooLarge | TooLarge1000 | Overlong4);
+            const __m256i firstLow = table256(
+                Carry | Overlong3 | Overlong2 | Overlong4,
+                Carry | Overlong2,
+                Carry, Carry,
+                Carry | TooLarge,
+                Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000,
+                Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000,
+                Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000,
+                Carry | TooLarge | TooLarge1000 | Surrogate,
+                Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000);
+            const __m256i secondHigh = table256(
+                TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+                TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4,
+                TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge,
+                TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+                TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+                TooShort, TooShort, TooShort, TooShort);
+            // 块末尾的 3 个字节若是尚未结束的序列的首字节，相减后不为零
+            const __m256i incompleteLimit = _mm256_setr_epi8(
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                static_cast<char>(0xf0 - 1), static_cast<char>(0xe0 - 1), static_cast<char>(0xc0 - 1));
+            const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+            __m256i previous = _mm256_setzero_si256();
+            __m256i incomplete = _mm256_setzero_si256();
+            for (; end - p >= 32; p += 32)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                if (_mm256_movemask_epi8(x) == 0)
+                {
+                    // 整块 ASCII：只需确认上一块没有以未完成的序列结尾
+                    if (!_mm256_testz_si256(incomplete, incomplete))
+                    {
+                        break;
+                    }
+                    previous = x;
+                    continue;
+                }
+
+                __m256i carried = _mm256_permute2x128_si256(previous, x, 0x21);
+                __m256i prev1 = _mm256_alignr_epi8(x, carried, 15);
+                __m256i prev2 = _mm256_alignr_epi8(x, carried, 14);
+                __m256i prev3 = _mm256_alignr_epi8(x, carried, 13);
+
+                __m256i special = _mm256_and_si256(
+                    _mm256_and_si256(
+                        _mm256_shuffle_epi8(firstHigh, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                        _mm256_shuffle_epi8(firstLow, _mm256_and_si256(prev1, nibble))),
+                    _mm256_shuffle_epi8(secondHigh, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble)));
+                __m256i mustContinue = _mm256_or_si256(
+                    _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xe0 - 0x80))),
+                    _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xf0 - 0x80))));
+                __m256i error = _mm256_xor_si256(_mm256_and_si256(mustContinue, _mm256_set1_epi8(static_cast<char>(0x80))), special);
+                if (!_mm256_testz_si256(error, error))
+                {
+                    break;
+                }
+                previous = x;
+                incomplete = _mm256_subs_epu8(x, incompleteLimit);
+            }
+
+            // 出错的块和不足 32 字节的尾部交给逐个序列的实现，它给出出错的确切位置
+            return sse2SkipUtf8(sequenceStart(begin, p), end);
+        }
+
+        bool cpuHas(const char* isa)
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 1);
+            bool sse2 = (info[3] & (1 << 26)) != 0;
+            if (isa[0] == 's')
+            {
+                return sse2;
+            }
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+            {
+                return false;
+            }
+            __cpuid(info, 0);
+            if (info[0] < 7)
+            {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return isa[0] == 's' ? __builtin_cpu_supports("sse2") : __builtin_cpu_supports("avx2");
+#endif
+        }
+
+        const Kernels sse2 = {
+            "sse2",
+            sse2SkipAsciiBlank,
+            sse2SkipIdentifier,
+            sse2FindStringSpecial,
+            sse2FindTemplateSpecial,
+            sse2SkipUtf8,
+        };
+
+        const Kernels avx2 = {
+            "avx2",
+            avx2SkipAsciiBlank,
+            avx2SkipIdentifier,
+            avx2FindStringSpecial,
+            avx2FindTemplateSpecial,
+            avx2SkipUtf8,
+        };
+
+#endif // FLANER_SCAN_X86
+
+        const Kernels scalar = {
+            "scalar",
+            scalarSkipAsciiBlank,
+            scalarSkipIdentifier,
+            scalarFindStringSpecial,
+            scalarFindTemplateSpecial,
+            scalarSkipUtf8,
+        };
+
+        const Kernels& select()
+        {
+#ifdef FLANER_SCAN_X86
+            if (cpuHas("avx2"))
+            {
+                return avx2;
+            }
+            if (cpuHas("sse2"))
+            {
+                return sse2;
+            }
+#endif
+            return scalar;
+        }
+    }
+
+    const Kernels& kernels()
+    {
+        static const Kernels& selected = select();
+        return selected;
+    }
+
+    const Kernels& scalarKernels()
+    {
+        return scalar;
+    }
+
+    size_t unicodeBlank(const char* p, const char* end)
+    {
+        auto u = [p](size_t i) {
+            return static_cast<unsigned char>(p[i]);
+        };
+        size_t n = static_cast<size_t>(end - p);
+
+        if (n >= 2 && u(0) == 0xc2 && u(1) == 0xa0)
+        {
+            return 2;
+        }
+        if (n >= 3 && u(0) == 0xe2 && u(1) == 0x80 && ((u(2) >= 0x80 && u(2) <= 0x8b) || u(2) == 0xa8 || u(2) == 0xa9))
+        {
+            return 3;
+        }
+        if (n >= 3 && u(0) == 0xe3 && u(1) == 0x80 && u(2) == 0x80)
+        {
+            return 3;
+        }
+        return 0;
+    }
+}
+}
+}
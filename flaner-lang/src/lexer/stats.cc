@@ -0,0 +1,221 @@
+#include <stats.hh>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace flaner
+{
+namespace lexer
+{
+namespace stats
+{
+    static const char* const branchNames[] = { "blank", "number", "identifier", "string", "template", "operator" };
+    static const char* const phaseNames[] = { "open", "read", "decode", "lex", "parse", "compile", "run", "dump" };
+
+    void Stats::merge(const Stats& s)
+    {
+        for (size_t i = 0; i < tokenTypeCount; ++i)
+        {
+            tokens[i] += s.tokens[i];
+        }
+        for (size_t i = 0; i < static_cast<size_t>(Branch::Count); ++i)
+        {
+            branchBytes[i] += s.branchBytes[i];
+        }
+        streamCalls += s.streamCalls;
+        seeks += s.seeks;
+        ungets += s.ungets;
+        for (size_t i = 0; i < static_cast<size_t>(Phase::Count); ++i)
+        {
+            phaseSeconds[i] += s.phaseSeconds[i];
+        }
+    }
+
+    std::string Stats::toJson() const
+    {
+        std::string json = enabled() ? "{\"enabled\":true,\"tokens\":{" : "{\"enabled\":false,\"tokens\":{";
+        const char* separator = "";
+        for (size_t i = 0; i < tokenTypeCount; ++i)
+        {
+            if (tokens[i] != 0)
+            {
+                json += separator;
+                json += "\"" + std::to_string(i) + "\":" + std::to_string(tokens[i]);
+                separator = ",";
+            }
+        }
+        json += "},\"branchBytes\":{";
+        for (size_t i = 0; i < static_cast<size_t>(Branch::Count); ++i)
+        {
+            json += (i ? ",\"" : "\"") + std::string(branchNames[i]) + "\":" + std::to_string(branchBytes[i]);
+        }
+        json += "},\"context\":{\"streamCalls\":" + std::to_string(streamCalls)
+            + ",\"seeks\":" + std::to_string(seeks)
+            + ",\"ungets\":" + std::to_string(ungets) + "},\"phaseSeconds\":{";
+        for (size_t i = 0; i < static_cast<size_t>(Phase::Count); ++i)
+        {
+            char number[32];
+            std::snprintf(number, sizeof(number), "%.6f", phaseSeconds[i]);
+            json += (i ? ",\"" : "\"") + std::string(phaseNames[i]) + "\":" + number;
+        }
+        json += "}}";
+        return json;
+    }
+
+    // 每个线程的统计登记在这里，线程退出时并入 retired
+    static std::mutex registryMutex;
+    static std::vector<Stats*> registry;
+    static Stats retired;
+
+    struct Registration
+    {
+        Stats stats;
+        Registration()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            registry.push_back(&stats);
+        }
+        ~Registration()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            retired.merge(stats);
+            for (auto& s : registry)
+            {
+                if (s == &stats)
+                {
+                    s = registry.back();
+                    registry.pop_back();
+                    break;
+                }
+            }
+        }
+    };
+
+    Stats& local()
+    {
+        thread_local Registration registration;
+        return registration.stats;
+    }
+
+    Stats total()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        Stats sum = retired;
+        for (const Stats* s : registry)
+        {
+            sum.merge(*s);
+        }
+        return sum;
+    }
+
+    PhaseTimer::PhaseTimer(Phase phase)
+        : phase(phase), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    PhaseTimer::~PhaseTimer()
+    {
+        auto end = std::chrono::steady_clock::now();
+        local().phaseSeconds[static_cast<size_t>(phase)] += std::chrono::duration<double>(end - start).count();
+        if (Trace::active())
+        {
+            Trace::complete(phaseNames[static_cast<size_t>(phase)], {}, start, end);
+        }
+    }
+
+    struct Event
+    {
+        const char* name;
+        std::string detail;
+        Trace::Clock::time_point begin, end;
+        unsigned thread;
+    };
+
+    static std::atomic<bool> tracing{ false };
+    static std::mutex traceMutex;
+    static std::vector<Event> events;
+    static Trace::Clock::time_point origin;
+    static std::atomic<unsigned> nextThread{ 0 };
+
+    void Trace::start()
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        events.clear();
+        origin = Clock::now();
+        tracing = true;
+    }
+
+    bool Trace::active()
+    {
+        return tracing.load(std::memory_order_relaxed);
+    }
+
+    void Trace::complete(const char* name, const std::string& detail, Clock::time_point begin, Clock::time_point end)
+    {
+        thread_local unsigned thread = nextThread++;
+        std::lock_guard<std::mutex> lock(traceMutex);
+        events.push_back({ name, detail, begin, end, thread });
+    }
+
+    static void appendJsonString(std::string& out, const std::string& s)
+    {
+        out += '"';
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escape[8];
+                std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                out += escape;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    bool Trace::write(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        // 时间以微秒为单位
+        auto micros = [](Clock::duration d) {
+            return std::chrono::duration<double, std::micro>(d).count();
+        };
+        std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            const Event& e = events[i];
+            char head[160];
+            std::snprintf(head, sizeof(head), "%s{\"name\":\"%s\",\"cat\":\"lexer\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                i ? ",\n" : "\n", e.name, e.thread, micros(e.begin - origin), micros(e.end - e.begin));
+            json += head;
+            if (!e.detail.empty())
+            {
+                json += ",\"args\":{\"detail\":";
+                appendJsonString(json, e.detail);
+                json += "}";
+            }
+            json += "}";
+        }
+        json += "\n]}\n";
+
+        bool ok = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+        return std::fclose(file) == 0 && ok;
+    }
+}
+}
+}
@@ -0,0 +1,330 @@
+#include <stream.hh>
+#include <unicode.hh>
+#include <algorithm>
+#include <cstring>
+
+namespace flaner
+{
+namespace lexer
+{
+    StreamLexer::StreamLexer(std::string path)
+        : StreamLexer(path, Options{})
+    {
+    }
+
+    StreamLexer::StreamLexer(std::string path, Options options)
+        : StreamLexer(path == "-" ? stdin : std::fopen(path.c_str(), "rb"), options)
+    {
+        ownsFile = file != nullptr && file != stdin;
+    }
+
+    StreamLexer::StreamLexer(std::FILE* f)
+        : StreamLexer(f, Options{})
+    {
+    }
+
+    StreamLexer::StreamLexer(std::FILE* f, Options o)
+        : options(o),
+        file(f), ownsFile(false), eof(f == nullptr),
+        window(std::max<size_t>(o.window, 64)), filled(0), windowBase(0), checked(0),
+        core(Context(io::Source(io::Buffer::borrow(nullptr, 0)))),
+        ring(o.lookahead + 8), head(0), count(0), started(false)
+    {
+        core.options.desugarTemplates = o.desugarTemplates;
+        rebase(0);
+    }
+
+    StreamLexer::~StreamLexer()
+    {
+        if (ownsFile)
+        {
+            std::fclose(file);
+        }
+    }
+
+    void StreamLexer::rebase(size_t position)
+    {
+        core.context.begin = window.data();
+        core.context.cursor = window.data() + position;
+        core.context.end = window.data() + filled;
+    }
+
+    bool StreamLexer::readMore()
+    {
+        if (eof)
+        {
+            return false;
+        }
+        size_t position = core.context.position();
+        if (filled == window.size())
+        {
+            window.resize(window.size() * 2);
+        }
+        size_t n = std::fread(window.data() + filled, 1, window.size() - filled, file);
+        filled += n;
+        if (n == 0 || std::feof(file) || std::ferror(file))
+        {
+            eof = true;
+        }
+        // 跳过文件开头的 UTF-8 BOM
+        if (windowBase == 0 && position == 0 && filled >= 3 && std::memcmp(window.data(), "\xef\xbb\xbf", 3) == 0)
+        {
+            position = 3;
+        }
+        rebase(position);
+
+        // 新读入的部分随读随校验，末尾被截断的序列留到下次读入后再看
+        const char* from = window.data() + checked;
+        const char* to = eof ? core.context.end : unicode::completePrefix(from, core.context.end);
+        const char* bad = scan::kernels().skipUtf8(from, to);
+        if (bad != to)
+        {
+            core.context.cursor = bad;
+            core.error("Invalid UTF-8 sequence");
+        }
+        checked = static_cast<size_t>(to - window.data());
+        return n > 0;
+    }
+
+    void StreamLexer::compact()
+    {
+        // 环形缓冲区和 core 中暂存的 token 仍引用的源码和 payload 必须保留
+        size_t position = core.context.position();
+        size_t keep = position;
+        size_t keepPayload = core.payload.size();
+        auto visit = [&](uint16_t flags, uint32_t offset, uint32_t attribute) {
+            if (flags & Token::Payload)
+            {
+                keepPayload = std::min<size_t>(keepPayload, offset);
+            }
+            else
+            {
+                keep = std::min<size_t>(keep, offset);
+            }
+            if (flags & Token::Spilled)
+            {
+                keepPayload = std::min<size_t>(keepPayload, attribute);
+            }
+        };
+        for (size_t k = 0; k < count; ++k)
+        {
+            visit(at(k).flags, at(k).offset, at(k).attribute);
+        }
+        const TokenStream& held = core.sequence;
+        for (size_t i = 0; i < held.size(); ++i)
+        {
+            visit(held.flags[i], held.offsets[i], held.attributes[i]);
+        }
+
+        auto shift = [&](uint16_t flags, uint32_t& offset, uint32_t& attribute) {
+            offset -= static_cast<uint32_t>(flags & Token::Payload ? keepPayload : keep);
+            if (flags & Token::Spilled)
+            {
+                attribute -= static_cast<uint32_t>(keepPayload);
+            }
+        };
+        for (size_t k = 0; k < count; ++k)
+        {
+            Token& t = ring[(head + k) % ring.size()];
+            shift(t.flags, t.offset, t.attribute);
+        }
+        for (size_t i = 0; i < core.sequence.size(); ++i)
+        {
+            shift(core.sequence.flags[i], core.sequence.offsets[i], core.sequence.attributes[i]);
+        }
+
+        if (keep > 0)
+        {
+            // 记下滑出窗口的部分有多少行，报错时的行列号仍从输入开头算起
+            Position p = LineIndex::scan(window.data(), window.data() + keep);
+            core.context.charOffset = p.line > 1 ? p.column - 1 : core.context.charOffset + p.column - 1;
+            core.context.lineOffset += p.line - 1;
+            std::memmove(window.data(), window.data() + keep, filled - keep);
+            filled -= keep;
+            windowBase += keep;
+            checked -= keep;
+        }
+        core.payload.erase(0, keepPayload);
+        rebase(position - keep);
+    }
+
+    bool StreamLexer::lexMore()
+    {
+        while (true)
+        {
+            // 窗口中未读的部分不足一半时，先腾出空间再读入
+            if (!eof && filled - core.context.position() < window.size() / 2)
+            {
+                compact();
+                readMore();
+            }
+
+            const char* mark = core.context.cursor;
+            Lexer::State saved = core.state;
+            size_t payloadSize = core.payload.size();
+            bool hadHeld = !core.sequence.empty();
+            Token held = hadHeld ? core.sequence.back() : Token{};
+
+            // 向前看最多 3 个字符，停在离窗口末尾太近处的 token 可能还没有结束
+            auto cutOff = [this] { return !eof && core.context.end - core.context.cursor < 4; };
+            bool produced = false;
+            bool retry = false;
+            try
+            {
+                produced = core.step();
+                retry = cutOff();
+            }
+            catch (const Lexer::LexError&)
+            {
+                // 只有碰到窗口末尾的错误可能是截断造成的，其余的错误再读入多少也不会消失
+                if (!cutOff())
+                {
+                    throw;
+                }
+                retry = true;
+            }
+
+            if (retry)
+            {
+                core.context.cursor = mark;
+                core.state = saved;
+                core.payload.resize(payloadSize);
+                core.sequence.clear();
+                if (hadHeld)
+                {
+                    core.sequence.push_back(held);
+                }
+                compact();
+                readMore();
+                continue;
+            }
+
+            // 最后一个 token 可能是 .，它决定之后的关键字是否当作标识符，输入结束前先留在 core 中
+            size_t keep = produced ? 1 : 0;
+            size_t n = core.sequence.size() > keep ? core.sequence.size() - keep : 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                ring[(head + count) % ring.size()] = core.sequence[i];
+                count += 1;
+            }
+            if (n > 0)
+            {
+                Token last = core.sequence.back();
+                core.sequence.clear();
+                if (keep)
+                {
+                    core.sequence.push_back(last);
+                }
+            }
+
+            if (n > 0)
+            {
+                return true;
+            }
+            if (!produced)
+            {
+                return false;
+            }
+        }
+    }
+
+    bool StreamLexer::fill(size_t n)
+    {
+        while (count < n)
+        {
+            if (!lexMore())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const Token& StreamLexer::at(size_t k) const
+    {
+        return ring[(head + k) % ring.size()];
+    }
+
+    StreamLexer::TokenView StreamLexer::view(const Token& t) const
+    {
+        if (t.flags & Token::Payload)
+        {
+            return { t.type, { core.payload.data() + t.offset, t.length }, Lexer::hasSymbol(t.type) ? t.attribute : 0 };
+        }
+        if (t.flags & Token::Synthetic)
+        {
+            return { t.type, spellingOf(t.type) };
+        }
+        return { t.type, { window.data() + t.offset, t.length }, Lexer::hasSymbol(t.type) ? t.attribute : 0 };
+    }
+
+    StreamLexer::TokenView StreamLexer::next()
+    {
+        if (started)
+        {
+            head = (head + 1) % ring.size();
+            count -= 1;
+        }
+        started = fill(1);
+        if (!started)
+        {
+            return { TokenType::END_OF_FILE, {} };
+        }
+        return view(at(0));
+    }
+
+    StreamLexer::TokenView StreamLexer::peek(size_t k)
+    {
+        size_t index = (started ? 1 : 0) + k;
+        if (k >= options.lookahead || !fill(index + 1))
+        {
+            return { TokenType::END_OF_FILE, {} };
+        }
+        return view(at(index));
+    }
+
+    bool StreamLexer::isEnd()
+    {
+        return !fill((started ? 1 : 0) + 1);
+    }
+
+    Number StreamLexer::number() const
+    {
+        return started ? core.numberOf(at(0)) : Number{};
+    }
+
+    size_t StreamLexer::tryFindingAfter(TokenSet patterns, TokenType t1, TokenType t2)
+    {
+        for (size_t k = 0; k < options.lookahead && fill(k + 1); ++k)
+        {
+            TokenType type = at(k).type;
+            if (!patterns.contains(type))
+            {
+                return 0;
+            }
+            if (type == t1)
+            {
+                return fill(k + 2) && at(k + 1).type == t2 ? k + 1 : 0;
+            }
+        }
+        return 0;
+    }
+
+    size_t StreamLexer::tryFinding(TokenSet patterns, TokenType t)
+    {
+        for (size_t k = 0; k < options.lookahead && fill(k + 1); ++k)
+        {
+            TokenType type = at(k).type;
+            if (!patterns.contains(type))
+            {
+                return 0;
+            }
+            if (type == t)
+            {
+                return k;
+            }
+        }
+        return 0;
+    }
+}
+}
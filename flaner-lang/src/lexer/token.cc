@@ -0,0 +1,140 @@
+#include <token.hh>
+#include <keyword.hh>
+#include <operator.hh>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FLANER_TOKEN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLANER_TOKEN_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace flaner
+{
+namespace lexer
+{
+    static inline unsigned lowestBit(uint32_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long i;
+        _BitScanForward(&i, mask);
+        return static_cast<unsigned>(i);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    size_t TokenStream::find(TokenType t, size_t from, size_t to) const
+    {
+        const uint16_t* p = types.data();
+        const uint16_t v = static_cast<uint16_t>(t);
+        size_t i = from;
+
+#if defined(FLANER_TOKEN_AVX2)
+        const __m256i needle = _mm256_set1_epi16(static_cast<short>(v));
+        for (; i + 32 <= to; i += 32)
+        {
+            __m256i a = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)), needle);
+            __m256i b = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 16)), needle);
+            if (!_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_or_si256(a, b)))
+            {
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(a));
+                if (mask)
+                {
+                    return i + lowestBit(mask) / 2;
+                }
+                return i + 16 + lowestBit(static_cast<uint32_t>(_mm256_movemask_epi8(b))) / 2;
+            }
+        }
+#elif defined(FLANER_TOKEN_SSE2)
+        const __m128i needle = _mm_set1_epi16(static_cast<short>(v));
+        for (; i + 16 <= to; i += 16)
+        {
+            __m128i a = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), needle);
+            __m128i b = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 8)), needle);
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(a))
+                | static_cast<uint32_t>(_mm_movemask_epi8(b)) << 16;
+            if (mask)
+            {
+                return i + lowestBit(mask) / 2;
+            }
+        }
+#endif
+
+        for (; i < to; ++i)
+        {
+            if (p[i] == v)
+            {
+                return i;
+            }
+        }
+        return to;
+    }
+
+    void TokenStream::matchBrackets()
+    {
+        // 尚未配对的左括号的下标。右括号与栈顶种类不同时不配对，也不出栈
+        std::vector<uint32_t> open;
+        auto close = [&](size_t i, TokenType opener) {
+            if (!open.empty() && type(open.back()) == opener)
+            {
+                attributes[open.back()] = static_cast<uint32_t>(i);
+                open.pop_back();
+            }
+        };
+        for (size_t i = 0, n = size(); i < n; ++i)
+        {
+            switch (type(i))
+            {
+            case TokenType::OP_PAREN_BEGIN:
+            case TokenType::OP_BRACKET_BEGIN:
+            case TokenType::OP_BRACE_BEGIN:
+                attributes[i] = 0;
+                open.push_back(static_cast<uint32_t>(i));
+                break;
+            case TokenType::OP_PAREN_END:
+                close(i, TokenType::OP_PAREN_BEGIN);
+                break;
+            case TokenType::OP_BRACKET_END:
+                close(i, TokenType::OP_BRACKET_BEGIN);
+                break;
+            case TokenType::OP_BRACE_END:
+                close(i, TokenType::OP_BRACE_BEGIN);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    // 关键字和运算符的写法都来自各自的列表，按类型编号排成一张表
+    static constexpr struct Spellings
+    {
+        std::string_view names[tokenTypeCount];
+
+        constexpr Spellings()
+            : names()
+        {
+            for (const auto& k : keywords)
+            {
+                names[static_cast<size_t>(k.type)] = k.name;
+            }
+            for (const auto& o : operators)
+            {
+                names[static_cast<size_t>(o.type)] = o.spelling;
+            }
+        }
+    } spellings{};
+
+    std::string_view spellingOf(TokenType type)
+    {
+        size_t i = static_cast<size_t>(type);
+        return i < tokenTypeCount ? spellings.names[i] : std::string_view{};
+    }
+}
+}
@@ -0,0 +1,146 @@
+#include <ast.hh>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace flaner
+{
+namespace parser
+{
+    Ast::Ast(const lexer::Lexer& l, std::pmr::memory_resource* r)
+        : lexer(l), resource(r), blocks(r), count(1), top(none)
+    {
+        // 0 号结点表示没有，它的子结点都是 0，遍历到它时自然停下
+        blocks.push_back(static_cast<Node*>(resource->allocate(blockSize * sizeof(Node), alignof(Node))));
+        blocks[0][0] = Node{ NodeKind::None, TokenType::UNKNOWN, 0, none, none, none, none };
+    }
+
+    Ast::~Ast()
+    {
+        // 后分配的先释放，从 Arena 分配时最近的一块可以收回
+        for (size_t i = blocks.size(); i-- > 0;)
+        {
+            resource->deallocate(blocks[i], blockSize * sizeof(Node), alignof(Node));
+        }
+    }
+
+    NodeId Ast::add(NodeKind kind, uint32_t token, TokenType op, NodeId a, NodeId b, NodeId c)
+    {
+        if ((count & (blockSize - 1)) == 0)
+        {
+            blocks.push_back(static_cast<Node*>(resource->allocate(blockSize * sizeof(Node), alignof(Node))));
+        }
+        NodeId id = count++;
+        (*this)[id] = Node{ kind, op, token, a, b, c, none };
+        return id;
+    }
+
+    TokenView Ast::text(NodeId id) const
+    {
+        return lexer.view(lexer.getStream()[(*this)[id].token]);
+    }
+
+    lexer::Position Ast::position(NodeId id) const
+    {
+        return lexer.positionOf((*this)[id].token);
+    }
+
+    size_t Ast::line(NodeId id) const
+    {
+        return lexer.lineOf((*this)[id].token);
+    }
+
+    const char* Ast::nameOf(NodeKind kind)
+    {
+        static const char* const names[] = {
+            "None",
+            "Identifier", "Number", "String", "Literal", "Template", "Array", "Object", "Property",
+            "Unary", "Binary", "Assign", "Conditional", "Call", "Index", "Member", "Arrow", "Parameter",
+            "Spread", "Yield",
+            "Program", "Block", "Declaration", "Declarator", "ExpressionStatement", "If", "Switch", "Case",
+            "While", "DoWhile", "ForIn", "ForOf", "Break", "Continue", "Return", "Throw",
+            "Import", "ImportSpecifier", "Export", "ExportSpecifier", "Class", "Method", "Field", "Empty",
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(NodeKind::Count), "missing node kind names");
+        return names[static_cast<size_t>(kind)];
+    }
+
+    void Ast::dump(std::string& out, NodeId id) const
+    {
+        // 左结合的长链（a + b + c + ...）可以很深，用显式的栈而不是递归
+        std::vector<std::pair<NodeId, size_t>> stack{ { id, 0 } };
+        std::vector<NodeId> children;
+        while (!stack.empty())
+        {
+            auto [n, depth] = stack.back();
+            stack.pop_back();
+            dump(out, n, depth);
+
+            const Node& node = (*this)[n];
+            children.clear();
+            for (NodeId child : { node.a, node.b, node.c })
+            {
+                for (NodeId c = child; c != none; c = (*this)[c].next)
+                {
+                    children.push_back(c);
+                }
+            }
+            for (size_t i = children.size(); i-- > 0;)
+            {
+                stack.push_back({ children[i], depth + 1 });
+            }
+        }
+    }
+
+    void Ast::dump(std::string& out, NodeId id, size_t depth) const
+    {
+        const Node& node = (*this)[id];
+        // 缩进到 maxIndent 层为止，更深的结点写出实际深度，长链的输出才不会随深度平方增长
+        out.append(std::min(depth, maxIndent) * 2, ' ');
+        if (depth > maxIndent)
+        {
+            out += '[';
+            out += std::to_string(depth);
+            out += "] ";
+        }
+        out += nameOf(node.kind);
+        if (node.op != TokenType::UNKNOWN)
+        {
+            out += ' ';
+            out += lexer::spellingOf(node.op);
+        }
+
+        // 以名字或字面量为主 token 的结点带上它的文本
+        switch (node.kind)
+        {
+        case NodeKind::Identifier:
+        case NodeKind::Number:
+        case NodeKind::Literal:
+        case NodeKind::Property:
+        case NodeKind::Member:
+        case NodeKind::Parameter:
+        case NodeKind::Declarator:
+        case NodeKind::ForIn:
+        case NodeKind::ForOf:
+        case NodeKind::ImportSpecifier:
+        case NodeKind::ExportSpecifier:
+        case NodeKind::Class:
+        case NodeKind::Method:
+        case NodeKind::Field:
+            out += ' ';
+            out += text(id).value;
+            break;
+        case NodeKind::String:
+        case NodeKind::Import:
+            out += " \"";
+            out += text(id).value;
+            out += '"';
+            break;
+        default:
+            break;
+        }
+        out += '\n';
+    }
+}
+}
@@ -0,0 +1,841 @@
+#include <parser.hh>
+#include <stats.hh>
+#include <algorithm>
+
+namespace flaner
+{
+namespace parser
+{
+    namespace
+    {
+        // 二元运算符的优先级，数值越大结合越紧；一元运算符在乘除和乘方之间，-a ** b 即 -(a ** b)
+        enum Precedence : unsigned
+        {
+            Assignment = 1,
+            Condition,
+            LogicOr,
+            LogicAnd,
+            BitOr,
+            BitXor,
+            BitAnd,
+            Equality,
+            Relation,
+            Range,
+            Shift,
+            Additive,
+            Multiplicative,
+            Prefix,
+            Power,
+        };
+
+        struct Infix
+        {
+            TokenType type = TokenType::UNKNOWN;
+            // 0 表示不是二元运算符
+            unsigned precedence = 0;
+            bool right = false;
+            NodeKind kind = NodeKind::None;
+        };
+
+        constexpr Infix infixOperators[] = {
+            { TokenType::OP_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_ADD_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_MINUS_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_MUL_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_INTDIV_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_DIV_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_MOD_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_QUOTE_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_POW_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_BIT_OR_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_BIT_AND_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_BIT_XOR_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_SHIFT_LEFT_ASSIGN, Assignment, true, NodeKind::Assign },
+            { TokenType::OP_SHIFT_RIGHT_ASSIGN, Assignment, true, NodeKind::Assign },
+
+            { TokenType::OP_QUESTION, Condition, true, NodeKind::Conditional },
+
+            { TokenType::OP_LOGIC_OR, LogicOr, false, NodeKind::Binary },
+            { TokenType::OP_LOGIC_AND, LogicAnd, false, NodeKind::Binary },
+            { TokenType::OP_BIT_OR, BitOr, false, NodeKind::Binary },
+            { TokenType::OP_BIT_XOR, BitXor, false, NodeKind::Binary },
+            { TokenType::OP_BIT_AND, BitAnd, false, NodeKind::Binary },
+
+            { TokenType::OP_EQUAL, Equality, false, NodeKind::Binary },
+            { TokenType::OP_NOT_EQUAL, Equality, false, NodeKind::Binary },
+
+            { TokenType::OP_LESS_THAN, Relation, false, NodeKind::Binary },
+            { TokenType::OP_GREATER_THAN, Relation, false, NodeKind::Binary },
+            { TokenType::OP_LESS_EQUAL, Relation, false, NodeKind::Binary },
+            { TokenType::OP_GREATER_EQUAL, Relation, false, NodeKind::Binary },
+            { TokenType::KEYWORD_IN, Relation, false, NodeKind::Binary },
+
+            { TokenType::OP_DOT_DOT, Range, false, NodeKind::Binary },
+            { TokenType::OP_DOT_DOT_DOT, Range, false, NodeKind::Binary },
+
+            { TokenType::OP_SHIFT_LEFT, Shift, false, NodeKind::Binary },
+            { TokenType::OP_SHIFT_RIGHT, Shift, false, NodeKind::Binary },
+
+            { TokenType::OP_ADD, Additive, false, NodeKind::Binary },
+            { TokenType::OP_MINUS, Additive, false, NodeKind::Binary },
+
+            { TokenType::OP_MUL, Multiplicative, false, NodeKind::Binary },
+            { TokenType::OP_DIV, Multiplicative, false, NodeKind::Binary },
+            { TokenType::OP_INTDIV, Multiplicative, false, NodeKind::Binary },
+            { TokenType::OP_MOD, Multiplicative, false, NodeKind::Binary },
+            { TokenType::OP_QUOTE, Multiplicative, false, NodeKind::Binary },
+
+            { TokenType::OP_POW, Power, true, NodeKind::Binary },
+        };
+
+        // 按 token 类型直接索引的运算符表，在编译期由 infixOperators 生成
+        class InfixTable
+        {
+        public:
+            constexpr InfixTable()
+                : entries()
+            {
+                for (const auto& o : infixOperators)
+                {
+                    entries[static_cast<size_t>(o.type)] = o;
+                }
+            }
+
+            constexpr const Infix& operator[](TokenType type) const
+            {
+                return entries[static_cast<size_t>(type)];
+            }
+
+        private:
+            Infix entries[lexer::tokenTypeCount];
+        };
+
+        constexpr InfixTable infixTable{};
+
+        // 对象字面量的键还可以是关键字
+        bool isKeyword(TokenType type)
+        {
+            return (type >= TokenType::KEYWORD_IF && type <= TokenType::KEYWORD_AS)
+                || type == TokenType::KEYWORD_NONE || type == TokenType::KEYWORD_TRUE || type == TokenType::KEYWORD_FALSE;
+        }
+    }
+
+    Parser::Parser(lexer::Lexer& l, Ast& a)
+        : lexer(l), ast(a), depth(0)
+    {
+    }
+
+    void Parser::append(List& list, NodeId id)
+    {
+        if (list.last == none)
+        {
+            list.first = id;
+        }
+        else
+        {
+            ast[list.last].next = id;
+        }
+        list.last = id;
+    }
+
+    TokenType Parser::peek()
+    {
+        return lexer.now().type;
+    }
+
+    uint32_t Parser::index() const
+    {
+        return static_cast<uint32_t>(lexer.index());
+    }
+
+    uint32_t Parser::advance()
+    {
+        uint32_t i = index();
+        lexer.go();
+        return i;
+    }
+
+    bool Parser::accept(TokenType type)
+    {
+        if (peek() != type)
+        {
+            return false;
+        }
+        lexer.go();
+        return true;
+    }
+
+    uint32_t Parser::expect(TokenType type, const char* what)
+    {
+        if (peek() != type)
+        {
+            TokenView t = lexer.now();
+            error(std::string("Expected ") + what + " but found "
+                + (t.type == TokenType::END_OF_FILE ? std::string("end of input") : "'" + std::string(t.value) + "'"));
+        }
+        return advance();
+    }
+
+    uint32_t Parser::expectName(const char* what)
+    {
+        return expect(TokenType::IDENTIFIER, what);
+    }
+
+    bool Parser::startsExpression()
+    {
+        switch (peek())
+        {
+        case TokenType::IDENTIFIER:
+        case TokenType::NUMBER:
+        case TokenType::BIGINT:
+        case TokenType::RATIONAL:
+        case TokenType::STRING:
+        case TokenType::TEMPLATE_HEAD:
+        case TokenType::KEYWORD_NONE:
+        case TokenType::KEYWORD_TRUE:
+        case TokenType::KEYWORD_FALSE:
+        case TokenType::KEYWORD_YIELD:
+        case TokenType::OP_PAREN_BEGIN:
+        case TokenType::OP_BRACKET_BEGIN:
+        case TokenType::OP_BRACE_BEGIN:
+        case TokenType::OP_ADD:
+        case TokenType::OP_MINUS:
+        case TokenType::OP_LOGIC_NEGATE:
+        case TokenType::OP_BIT_NEGATE:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void Parser::error(const std::string& info)
+    {
+        errorAt(index(), info);
+    }
+
+    void Parser::errorAt(uint32_t token, const std::string& info)
+    {
+        // 输入已经结束时指向最后一个 token
+        size_t n = lexer.getStream().size();
+        lexer::Position p = n == 0 ? lexer::Position{} : lexer.positionOf(std::min<size_t>(token, n - 1));
+        throw ParseError{ "SyntaxError: " + info, p.line, p.column };
+    }
+
+    void Parser::unexpected()
+    {
+        TokenView t = lexer.now();
+        if (t.type == TokenType::END_OF_FILE)
+        {
+            error("Unexpected end of input");
+        }
+        error("Unexpected token '" + std::string(t.value) + "'");
+    }
+
+    NodeId Parser::parseProgram()
+    {
+        FLANER_STATS(lexer::stats::PhaseTimer timer(lexer::stats::Phase::Parse);)
+        uint32_t token = index();
+        List statements;
+        while (peek() != TokenType::END_OF_FILE)
+        {
+            append(statements, parseStatement());
+        }
+        NodeId root = ast.add(NodeKind::Program, token, TokenType::UNKNOWN, statements.first);
+        ast.setRoot(root);
+        return root;
+    }
+
+    NodeId Parser::parseStatement()
+    {
+        if (++depth > maxDepth)
+        {
+            error("Statement nested too deeply");
+        }
+
+        NodeId statement;
+        switch (peek())
+        {
+        case TokenType::KEYWORD_LET:
+        case TokenType::KEYWORD_CONST:
+            statement = declaration();
+            break;
+        case TokenType::KEYWORD_IF:
+            statement = ifStatement();
+            break;
+        case TokenType::KEYWORD_SWITCH:
+            statement = switchStatement();
+            break;
+        case TokenType::KEYWORD_WHILE:
+            statement = whileStatement();
+            break;
+        case TokenType::KEYWORD_DO:
+            statement = doWhileStatement();
+            break;
+        case TokenType::KEYWORD_FOR:
+            statement = forStatement();
+            break;
+        case TokenType::KEYWORD_IMPORT:
+            statement = importDeclaration();
+            break;
+        case TokenType::KEYWORD_EXPORT:
+            statement = exportDeclaration();
+            break;
+        case TokenType::KEYWORD_CLASS:
+            statement = classDeclaration();
+            break;
+        case TokenType::KEYWORD_BREAK:
+            statement = ast.add(NodeKind::Break, advance());
+            break;
+        case TokenType::KEYWORD_CONTINUE:
+            statement = ast.add(NodeKind::Continue, advance());
+            break;
+        case TokenType::KEYWORD_RETURN:
+        {
+            uint32_t token = advance();
+            statement = ast.add(NodeKind::Return, token, TokenType::UNKNOWN, startsExpression() ? parseExpression() : none);
+            break;
+        }
+        case TokenType::KEYWORD_THROW:
+        {
+            uint32_t token = advance();
+            statement = ast.add(NodeKind::Throw, token, TokenType::UNKNOWN, parseExpression());
+            break;
+        }
+        case TokenType::OP_BRACE_BEGIN:
+            statement = block();
+            break;
+        case TokenType::OP_SEMICOLON:
+            --depth;
+            return ast.add(NodeKind::Empty, advance());
+        default:
+        {
+            uint32_t token = index();
+            statement = ast.add(NodeKind::ExpressionStatement, token, TokenType::UNKNOWN, parseExpression());
+            break;
+        }
+        }
+        accept(TokenType::OP_SEMICOLON);
+        --depth;
+        return statement;
+    }
+
+    NodeId Parser::block()
+    {
+        uint32_t token = expect(TokenType::OP_BRACE_BEGIN, "'{'");
+        List statements;
+        while (peek() != TokenType::OP_BRACE_END)
+        {
+            if (peek() == TokenType::END_OF_FILE)
+            {
+                unexpected();
+            }
+            append(statements, parseStatement());
+        }
+        advance();
+        return ast.add(NodeKind::Block, token, TokenType::UNKNOWN, statements.first);
+    }
+
+    NodeId Parser::declaration()
+    {
+        TokenType kind = peek();
+        uint32_t token = advance();
+        List declarators;
+        do
+        {
+            uint32_t name = expectName("a variable name");
+            NodeId value = none;
+            if (accept(TokenType::OP_ASSIGN))
+            {
+                value = parseExpression();
+            }
+            else if (kind == TokenType::KEYWORD_CONST)
+            {
+                error("Missing initializer in const declaration");
+            }
+            append(declarators, ast.add(NodeKind::Declarator, name, TokenType::UNKNOWN, value));
+        } while (accept(TokenType::OP_COMMA));
+        return ast.add(NodeKind::Declaration, token, kind, declarators.first);
+    }
+
+    NodeId Parser::ifStatement()
+    {
+        uint32_t token = advance();
+        expect(TokenType::OP_PAREN_BEGIN, "'('");
+        NodeId condition = parseExpression();
+        expect(TokenType::OP_PAREN_END, "')'");
+        NodeId then = parseStatement();
+        NodeId otherwise = accept(TokenType::KEYWORD_ELSE) ? parseStatement() : none;
+        return ast.add(NodeKind::If, token, TokenType::UNKNOWN, condition, then, otherwise);
+    }
+
+    NodeId Parser::switchStatement()
+    {
+        uint32_t token = advance();
+        expect(TokenType::OP_PAREN_BEGIN, "'('");
+        NodeId value = parseExpression();
+        expect(TokenType::OP_PAREN_END, "')'");
+        expect(TokenType::OP_BRACE_BEGIN, "'{'");
+
+        List cases;
+        while (!accept(TokenType::OP_BRACE_END))
+        {
+            uint32_t label = index();
+            NodeId test = none;
+            if (accept(TokenType::KEYWORD_CASE))
+            {
+                test = parseExpression();
+            }
+            else if (!accept(TokenType::KEYWORD_DEFAULT))
+            {
+                unexpected();
+            }
+            expect(TokenType::OP_COLON, "':'");
+
+            List body;
+            for (TokenType t = peek(); t != TokenType::KEYWORD_CASE && t != TokenType::KEYWORD_DEFAULT
+                && t != TokenType::OP_BRACE_END; t = peek())
+            {
+                append(body, parseStatement());
+            }
+            append(cases, ast.add(NodeKind::Case, label, TokenType::UNKNOWN, test, body.first));
+        }
+        return ast.add(NodeKind::Switch, token, TokenType::UNKNOWN, value, cases.first);
+    }
+
+    NodeId Parser::whileStatement()
+    {
+        uint32_t token = advance();
+        expect(TokenType::OP_PAREN_BEGIN, "'('");
+        NodeId condition = parseExpression();
+        expect(TokenType::OP_PAREN_END, "')'");
+        NodeId body = parseStatement();
+        return ast.add(NodeKind::While, token, TokenType::UNKNOWN, condition, body);
+    }
+
+    NodeId Parser::doWhileStatement()
+    {
+        uint32_t token = advance();
+        NodeId body = parseStatement();
+        expect(TokenType::KEYWORD_WHILE, "'while'");
+        expect(TokenType::OP_PAREN_BEGIN, "'('");
+        NodeId condition = parseExpression();
+        expect(TokenType::OP_PAREN_END, "')'");
+        return ast.add(NodeKind::DoWhile, token, TokenType::UNKNOWN, body, condition);
+    }
+
+    NodeId Parser::forStatement()
+    {
+        advance();
+        expect(TokenType::OP_PAREN_BEGIN, "'('");
+        TokenType kind = TokenType::UNKNOWN;
+        if (peek() == TokenType::KEYWORD_LET || peek() == TokenType::KEYWORD_CONST)
+        {
+            kind = peek();
+            advance();
+        }
+        uint32_t name = expectName("a loop variable");
+
+        NodeKind loop = NodeKind::ForIn;
+        if (accept(TokenType::KEYWORD_IN))
+        {
+            loop = NodeKind::ForIn;
+        }
+        else if (accept(TokenType::KEYWORD_OF))
+        {
+            loop = NodeKind::ForOf;
+        }
+        else
+        {
+            unexpected();
+        }
+        NodeId iterable = parseExpression();
+        expect(TokenType::OP_PAREN_END, "')'");
+        NodeId body = parseStatement();
+        return ast.add(loop, name, kind, iterable, body);
+    }
+
+    NodeId Parser::importDeclaration()
+    {
+        advance();
+        if (peek() == TokenType::STRING)
+        {
+            return ast.add(NodeKind::Import, advance());
+        }
+
+        // import a, { b as c } from "m"、import * as m from "m"
+        List specifiers;
+        bool more = true;
+        if (peek() == TokenType::IDENTIFIER)
+        {
+            append(specifiers, ast.add(NodeKind::ImportSpecifier, advance(), TokenType::KEYWORD_DEFAULT));
+            more = accept(TokenType::OP_COMMA);
+        }
+        if (more && peek() == TokenType::OP_MUL)
+        {
+            uint32_t star = advance();
+            expect(TokenType::KEYWORD_AS, "'as'");
+            NodeId alias = ast.add(NodeKind::Identifier, expectName("a module alias"));
+            append(specifiers, ast.add(NodeKind::ImportSpecifier, star, TokenType::OP_MUL, alias));
+        }
+        else if (more && accept(TokenType::OP_BRACE_BEGIN))
+        {
+            while (peek() != TokenType::OP_BRACE_END)
+            {
+                uint32_t name = expectName("an imported name");
+                NodeId alias = accept(TokenType::KEYWORD_AS) ? ast.add(NodeKind::Identifier, expectName("an alias")) : none;
+                append(specifiers, ast.add(NodeKind::ImportSpecifier, name, TokenType::UNKNOWN, alias));
+                if (!accept(TokenType::OP_COMMA))
+                {
+                    break;
+                }
+            }
+            expect(TokenType::OP_BRACE_END, "'}'");
+        }
+        else if (more)
+        {
+            unexpected();
+        }
+        expect(TokenType::KEYWORD_FROM, "'from'");
+        uint32_t module = expect(TokenType::STRING, "a module name");
+        return ast.add(NodeKind::Import, module, TokenType::UNKNOWN, specifiers.first);
+    }
+
+    NodeId Parser::exportDeclaration()
+    {
+        uint32_t token = advance();
+        switch (peek())
+        {
+        case TokenType::KEYWORD_DEFAULT:
+            advance();
+            return ast.add(NodeKind::Export, token, TokenType::KEYWORD_DEFAULT, parseExpression());
+        case TokenType::KEYWORD_LET:
+        case TokenType::KEYWORD_CONST:
+            return ast.add(NodeKind::Export, token, TokenType::UNKNOWN, declaration());
+        case TokenType::KEYWORD_CLASS:
+            return ast.add(NodeKind::Export, token, TokenType::UNKNOWN, classDeclaration());
+        case TokenType::OP_BRACE_BEGIN:
+        {
+            advance();
+            List specifiers;
+            while (peek() != TokenType::OP_BRACE_END)
+            {
+                uint32_t name = expectName("an exported name");
+                NodeId alias = accept(TokenType::KEYWORD_AS) ? ast.add(NodeKind::Identifier, expectName("an alias")) : none;
+                append(specifiers, ast.add(NodeKind::ExportSpecifier, name, TokenType::UNKNOWN, alias));
+                if (!accept(TokenType::OP_COMMA))
+                {
+                    break;
+                }
+            }
+            expect(TokenType::OP_BRACE_END, "'}'");
+            if (accept(TokenType::KEYWORD_FROM))
+            {
+                token = expect(TokenType::STRING, "a module name");
+            }
+            return ast.add(NodeKind::Export, token, TokenType::UNKNOWN, none, specifiers.first);
+        }
+        default:
+            unexpected();
+        }
+    }
+
+    NodeId Parser::classDeclaration()
+    {
+        advance();
+        uint32_t name = expectName("a class name");
+        expect(TokenType::OP_BRACE_BEGIN, "'{'");
+        List members;
+        while (!accept(TokenType::OP_BRACE_END))
+        {
+            if (accept(TokenType::OP_SEMICOLON))
+            {
+                continue;
+            }
+            uint32_t member = expectName("a member name");
+            if (accept(TokenType::OP_PAREN_BEGIN))
+            {
+                NodeId list = parameters();
+                NodeId body = block();
+                append(members, ast.add(NodeKind::Method, member, TokenType::UNKNOWN, list, body));
+            }
+            else
+            {
+                NodeId value = accept(TokenType::OP_ASSIGN) ? parseExpression() : none;
+                append(members, ast.add(NodeKind::Field, member, TokenType::UNKNOWN, value));
+            }
+        }
+        return ast.add(NodeKind::Class, name, TokenType::UNKNOWN, members.first);
+    }
+
+    NodeId Parser::parseExpression()
+    {
+        return expression(Assignment);
+    }
+
+    NodeId Parser::expression(unsigned precedence)
+    {
+        if (++depth > maxDepth)
+        {
+            error("Expression nested too deeply");
+        }
+
+        NodeId left = prefix();
+        while (true)
+        {
+            TokenType type = peek();
+            const Infix& infix = infixTable[type];
+            if (infix.precedence == 0 || infix.precedence < precedence)
+            {
+                break;
+            }
+            uint32_t token = advance();
+
+            if (infix.kind == NodeKind::Conditional)
+            {
+                NodeId then = expression(Assignment);
+                expect(TokenType::OP_COLON, "':'");
+                NodeId otherwise = expression(Condition);
+                left = ast.add(NodeKind::Conditional, token, TokenType::UNKNOWN, left, then, otherwise);
+                continue;
+            }
+            if (infix.kind == NodeKind::Assign)
+            {
+                NodeKind target = ast[left].kind;
+                if (target != NodeKind::Identifier && target != NodeKind::Member && target != NodeKind::Index)
+                {
+                    errorAt(token, "Invalid left-hand side in assignment");
+                }
+            }
+            // 右结合的运算符右侧允许同级的运算符，左结合的只允许更高级的
+            NodeId right = expression(infix.right ? infix.precedence : infix.precedence + 1);
+            left = ast.add(infix.kind, token, type, left, right);
+        }
+
+        --depth;
+        return left;
+    }
+
+    NodeId Parser::prefix()
+    {
+        NodeId primary = none;
+        switch (peek())
+        {
+        case TokenType::IDENTIFIER:
+        {
+            uint32_t token = advance();
+            if (peek() == TokenType::FUNCTION_ARROW)
+            {
+                return arrow(ast.add(NodeKind::Parameter, token));
+            }
+            primary = ast.add(NodeKind::Identifier, token);
+            break;
+        }
+        case TokenType::NUMBER:
+        case TokenType::BIGINT:
+        case TokenType::RATIONAL:
+            primary = ast.add(NodeKind::Number, advance());
+            break;
+        case TokenType::STRING:
+            primary = ast.add(NodeKind::String, advance());
+            break;
+        case TokenType::KEYWORD_NONE:
+        case TokenType::KEYWORD_TRUE:
+        case TokenType::KEYWORD_FALSE:
+            primary = ast.add(NodeKind::Literal, advance());
+            break;
+        case TokenType::TEMPLATE_HEAD:
+            primary = templateLiteral();
+            break;
+        case TokenType::OP_BRACKET_BEGIN:
+        {
+            uint32_t token = advance();
+            primary = ast.add(NodeKind::Array, token, TokenType::UNKNOWN, elements(TokenType::OP_BRACKET_END));
+            break;
+        }
+        case TokenType::OP_BRACE_BEGIN:
+            primary = objectLiteral();
+            break;
+        case TokenType::OP_PAREN_BEGIN:
+            return parenthesized();
+        case TokenType::OP_ADD:
+        case TokenType::OP_MINUS:
+        case TokenType::OP_LOGIC_NEGATE:
+        case TokenType::OP_BIT_NEGATE:
+        {
+            TokenType op = peek();
+            uint32_t token = advance();
+            return ast.add(NodeKind::Unary, token, op, expression(Prefix));
+        }
+        case TokenType::KEYWORD_YIELD:
+        {
+            uint32_t token = advance();
+            return ast.add(NodeKind::Yield, token, TokenType::UNKNOWN, startsExpression() ? expression(Assignment) : none);
+        }
+        default:
+            unexpected();
+        }
+        return postfix(primary);
+    }
+
+    NodeId Parser::postfix(NodeId left)
+    {
+        while (true)
+        {
+            switch (peek())
+            {
+            case TokenType::OP_PAREN_BEGIN:
+            {
+                uint32_t token = advance();
+                left = ast.add(NodeKind::Call, token, TokenType::UNKNOWN, left, elements(TokenType::OP_PAREN_END));
+                break;
+            }
+            case TokenType::OP_BRACKET_BEGIN:
+            {
+                uint32_t token = advance();
+                NodeId subscript = parseExpression();
+                expect(TokenType::OP_BRACKET_END, "']'");
+                left = ast.add(NodeKind::Index, token, TokenType::UNKNOWN, left, subscript);
+                break;
+            }
+            case TokenType::OP_DOT:
+                advance();
+                // . 之后的关键字已经被词法分析器当作标识符
+                left = ast.add(NodeKind::Member, expectName("a property name"), TokenType::UNKNOWN, left);
+                break;
+            default:
+                return left;
+            }
+        }
+    }
+
+    NodeId Parser::elements(TokenType close)
+    {
+        List list;
+        while (peek() != close)
+        {
+            NodeId element;
+            if (peek() == TokenType::OP_DOT_DOT_DOT)
+            {
+                uint32_t token = advance();
+                element = ast.add(NodeKind::Spread, token, TokenType::UNKNOWN, parseExpression());
+            }
+            else
+            {
+                element = parseExpression();
+            }
+            append(list, element);
+            if (!accept(TokenType::OP_COMMA))
+            {
+                break;
+            }
+        }
+        expect(close, close == TokenType::OP_PAREN_END ? "')'" : "']'");
+        return list.first;
+    }
+
+    NodeId Parser::templateLiteral()
+    {
+        // 各段和其间的表达式按顺序串成一个列表，求值时可以先算出结果的总长度
+        uint32_t token = advance();
+        List parts;
+        append(parts, ast.add(NodeKind::String, token));
+        while (true)
+        {
+            append(parts, parseExpression());
+            TokenType t = peek();
+            if (t != TokenType::TEMPLATE_MIDDLE && t != TokenType::TEMPLATE_TAIL)
+            {
+                unexpected();
+            }
+            append(parts, ast.add(NodeKind::String, advance()));
+            if (t == TokenType::TEMPLATE_TAIL)
+            {
+                break;
+            }
+        }
+        return ast.add(NodeKind::Template, token, TokenType::UNKNOWN, parts.first);
+    }
+
+    NodeId Parser::objectLiteral()
+    {
+        uint32_t token = advance();
+        List properties;
+        while (peek() != TokenType::OP_BRACE_END)
+        {
+            NodeId property;
+            TokenType key = peek();
+            if (key == TokenType::OP_DOT_DOT_DOT)
+            {
+                uint32_t spread = advance();
+                property = ast.add(NodeKind::Spread, spread, TokenType::UNKNOWN, parseExpression());
+            }
+            else if (key == TokenType::IDENTIFIER || key == TokenType::STRING || key == TokenType::NUMBER || isKeyword(key))
+            {
+                uint32_t name = advance();
+                NodeId value = none;
+                if (accept(TokenType::OP_COLON))
+                {
+                    value = parseExpression();
+                }
+                else if (key != TokenType::IDENTIFIER)
+                {
+                    error("Expected ':' after property key");
+                }
+                property = ast.add(NodeKind::Property, name, TokenType::UNKNOWN, value);
+            }
+            else
+            {
+                unexpected();
+            }
+            append(properties, property);
+            if (!accept(TokenType::OP_COMMA))
+            {
+                break;
+            }
+        }
+        expect(TokenType::OP_BRACE_END, "'}'");
+        return ast.add(NodeKind::Object, token, TokenType::UNKNOWN, properties.first);
+    }
+
+    NodeId Parser::parenthesized()
+    {
+        // 配对的 ) 由词法分析记下，其后是 => 时直接按参数表分析，不必先当作表达式再改写
+        const lexer::TokenStream& stream = lexer.getStream();
+        size_t closer = lexer.closerOf(index());
+        if (closer != 0 && closer + 1 < stream.size() && stream.type(closer + 1) == TokenType::FUNCTION_ARROW)
+        {
+            advance();
+            return arrow(parameters());
+        }
+        advance();
+        NodeId inner = parseExpression();
+        expect(TokenType::OP_PAREN_END, "')'");
+        return postfix(inner);
+    }
+
+    NodeId Parser::parameters()
+    {
+        List list;
+        while (peek() != TokenType::OP_PAREN_END)
+        {
+            TokenType op = accept(TokenType::OP_DOT_DOT_DOT) ? TokenType::OP_DOT_DOT_DOT : TokenType::UNKNOWN;
+            uint32_t name = expectName("a parameter name");
+            NodeId value = op == TokenType::UNKNOWN && accept(TokenType::OP_ASSIGN) ? parseExpression() : none;
+            append(list, ast.add(NodeKind::Parameter, name, op, value));
+            if (op != TokenType::UNKNOWN || !accept(TokenType::OP_COMMA))
+            {
+                break;
+            }
+        }
+        expect(TokenType::OP_PAREN_END, "')'");
+        return list.first;
+    }
+
+    NodeId Parser::arrow(NodeId parameters)
+    {
+        uint32_t token = advance();
+        NodeId body = peek() == TokenType::OP_BRACE_BEGIN ? block() : parseExpression();
+        return ast.add(NodeKind::Arrow, token, TokenType::UNKNOWN, parameters, body);
+    }
+}
+}
@@ -0,0 +1,77 @@
+#include <bytecode.hh>
+#include <fmt/format.h>
+#include <iterator>
+
+namespace flaner
+{
+namespace vm
+{
+    const char* nameOf(Opcode op)
+    {
+        static const char* const names[] = {
+#define FLANER_OPCODE_NAME(name) #name,
+            FLANER_OPCODES(FLANER_OPCODE_NAME)
+#undef FLANER_OPCODE_NAME
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Opcode::Count), "missing opcode names");
+        return names[static_cast<size_t>(op)];
+    }
+
+    bool isJump(Opcode op)
+    {
+        return op >= Opcode::JMP && op <= Opcode::ITER;
+    }
+
+    void Proto::disassemble(std::string& out) const
+    {
+        auto o = std::back_inserter(out);
+        fmt::format_to(o, "function {} (params {}{}, registers {}, constants {}, captures {})\n",
+            name, params, rest ? " + rest" : "", registers, constants.size(), captures.size());
+
+        for (size_t pc = 0; pc < code.size(); ++pc)
+        {
+            Instruction i = code[pc];
+            Opcode op = opcodeOf(i);
+            fmt::format_to(o, "  {:04}  [{:>4}]  {:<10}", pc, lines[pc], nameOf(op));
+            switch (op)
+            {
+            case Opcode::LOADK:
+                fmt::format_to(o, " {} {}    ; {}", argA(i), argBx(i), toString(constants[argBx(i)]));
+                break;
+            case Opcode::LOADINT:
+                fmt::format_to(o, " {} {}", argA(i), argSBx(i));
+                break;
+            case Opcode::GETGLOBAL:
+            case Opcode::CLOSURE:
+                fmt::format_to(o, " {} {}", argA(i), argBx(i));
+                break;
+            case Opcode::GETFIELD:
+                fmt::format_to(o, " {} {} {}    ; {}", argA(i), argB(i), argC(i), toString(constants[argC(i)]));
+                break;
+            case Opcode::SETFIELD:
+                fmt::format_to(o, " {} {} {}    ; {}", argA(i), argB(i), argC(i), toString(constants[argB(i)]));
+                break;
+            default:
+                fmt::format_to(o, " {} {} {}", argA(i), argB(i), argC(i));
+                if ((op >= Opcode::ADDK && op <= Opcode::SHRK) || (op >= Opcode::JEQK && op <= Opcode::JGEK))
+                {
+                    fmt::format_to(o, "    ; {}", toString(constants[argC(i)]));
+                }
+                break;
+            }
+            if (isJump(op))
+            {
+                int32_t offset = static_cast<int32_t>(code[++pc]);
+                fmt::format_to(o, "    -> {:04}", static_cast<int64_t>(pc) + 1 + offset);
+            }
+            out += '\n';
+        }
+
+        for (const auto& p : protos)
+        {
+            out += '\n';
+            p->disassemble(out);
+        }
+    }
+}
+}
@@ -0,0 +1,1407 @@
+#include <compiler.hh>
+#include <stats.hh>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace flaner
+{
+namespace vm
+{
+    namespace
+    {
+        using lexer::TokenType;
+
+        static_assert(static_cast<int>(Opcode::SHR) - static_cast<int>(Opcode::ADD)
+            == static_cast<int>(Opcode::SHRK) - static_cast<int>(Opcode::ADDK), "K forms must follow the order of ADD ... SHR");
+
+        // 二元运算符和复合赋值对应的算术指令，不是算术运算时为 Count
+        Opcode arithmeticOf(TokenType op)
+        {
+            switch (op)
+            {
+            case TokenType::OP_ADD: case TokenType::OP_ADD_ASSIGN: return Opcode::ADD;
+            case TokenType::OP_MINUS: case TokenType::OP_MINUS_ASSIGN: return Opcode::SUB;
+            case TokenType::OP_MUL: case TokenType::OP_MUL_ASSIGN: return Opcode::MUL;
+            case TokenType::OP_DIV: case TokenType::OP_DIV_ASSIGN: return Opcode::DIV;
+            case TokenType::OP_INTDIV: case TokenType::OP_INTDIV_ASSIGN: return Opcode::INTDIV;
+            case TokenType::OP_MOD: case TokenType::OP_MOD_ASSIGN: return Opcode::MOD;
+            case TokenType::OP_QUOTE: case TokenType::OP_QUOTE_ASSIGN: return Opcode::QUOTE;
+            case TokenType::OP_POW: case TokenType::OP_POW_ASSIGN: return Opcode::POW;
+            case TokenType::OP_SHIFT_LEFT: case TokenType::OP_SHIFT_LEFT_ASSIGN: return Opcode::SHL;
+            case TokenType::OP_SHIFT_RIGHT: case TokenType::OP_SHIFT_RIGHT_ASSIGN: return Opcode::SHR;
+            case TokenType::OP_BIT_AND: case TokenType::OP_BIT_AND_ASSIGN: return Opcode::BAND;
+            case TokenType::OP_BIT_OR: case TokenType::OP_BIT_OR_ASSIGN: return Opcode::BOR;
+            case TokenType::OP_BIT_XOR: case TokenType::OP_BIT_XOR_ASSIGN: return Opcode::BXOR;
+            default: return Opcode::Count;
+            }
+        }
+
+        // 右操作数为常量的形式，没有时为 Count
+        Opcode withConstant(Opcode op)
+        {
+            if (op >= Opcode::ADD && op <= Opcode::SHR)
+            {
+                return static_cast<Opcode>(static_cast<int>(Opcode::ADDK) + (static_cast<int>(op) - static_cast<int>(Opcode::ADD)));
+            }
+            return Opcode::Count;
+        }
+
+        bool isComparison(TokenType op)
+        {
+            return op >= TokenType::OP_LESS_THAN && op <= TokenType::OP_NOT_EQUAL;
+        }
+
+        // 常量在左侧时交换两侧：k < x 即 x > k
+        TokenType mirrored(TokenType op)
+        {
+            switch (op)
+            {
+            case TokenType::OP_LESS_THAN: return TokenType::OP_GREATER_THAN;
+            case TokenType::OP_GREATER_THAN: return TokenType::OP_LESS_THAN;
+            case TokenType::OP_LESS_EQUAL: return TokenType::OP_GREATER_EQUAL;
+            case TokenType::OP_GREATER_EQUAL: return TokenType::OP_LESS_EQUAL;
+            default: return op;
+            }
+        }
+    }
+
+    Compiler::Compiler(const parser::Ast& a, const std::vector<std::string>& names)
+        : ast(a), lexer(a.source()), fn(nullptr), line(0), depth(0)
+    {
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            globals.emplace(names[i], static_cast<uint32_t>(i));
+        }
+    }
+
+    Program Compiler::compile()
+    {
+        FLANER_STATS(lexer::stats::PhaseTimer timer(lexer::stats::Phase::Compile);)
+        program.main = std::make_unique<Proto>();
+        program.main->name = "main";
+
+        Function main(nullptr, program.main.get());
+        fn = &main;
+        NodeId root = ast.root();
+        at(root);
+        hoist(ast[root].a);
+        statements(ast[root].a);
+        emit(encode(Opcode::RETURN, 0, 0));
+        fn = nullptr;
+        return std::move(program);
+    }
+
+    void Compiler::error(NodeId id, const std::string& info)
+    {
+        lexer::Position p = ast.position(id);
+        throw CompileError("CompileError: " + info, p.line, p.column);
+    }
+
+    void Compiler::at(NodeId id)
+    {
+        // 每个语句和调用都要记行号，只查行不数列，长行上编译才是线性的
+        line = static_cast<uint32_t>(ast.line(id));
+    }
+
+    void Compiler::nest(NodeId id)
+    {
+        if (++depth > maxDepth)
+        {
+            error(id, "Expression is nested too deeply");
+        }
+    }
+
+    std::string_view Compiler::nameOf(NodeId id) const
+    {
+        return ast.text(id).value;
+    }
+
+    lexer::TokenType Compiler::tokenType(NodeId id) const
+    {
+        return lexer.getStream().type(ast[id].token);
+    }
+
+    size_t Compiler::emit(Instruction i)
+    {
+        fn->proto->code.push_back(i);
+        fn->proto->lines.push_back(line);
+        return fn->proto->code.size() - 1;
+    }
+
+    size_t Compiler::emitJump(Opcode op, uint8_t a, uint8_t b, uint8_t c)
+    {
+        emit(encode(op, a, b, c));
+        return emit(0);
+    }
+
+    void Compiler::emitLoop(Opcode op, uint8_t a, uint8_t c, size_t target)
+    {
+        patch(emitJump(op, a, 0, c), target);
+    }
+
+    void Compiler::patch(size_t at, size_t target)
+    {
+        fn->proto->code[at] = static_cast<Instruction>(static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 1)));
+    }
+
+    void Compiler::patchHere(const JumpList& list)
+    {
+        for (size_t at : list)
+        {
+            patch(at, here());
+        }
+    }
+
+    uint8_t Compiler::reserve(unsigned n)
+    {
+        unsigned r = fn->freeReg;
+        if (r + n > maxRegisters)
+        {
+            throw CompileError("CompileError: Function needs too many registers", line, 1);
+        }
+        fn->freeReg = static_cast<uint8_t>(r + n);
+        fn->proto->registers = std::max(fn->proto->registers, fn->freeReg);
+        return static_cast<uint8_t>(r);
+    }
+
+    uint8_t Compiler::localsTop() const
+    {
+        return fn->locals.empty() ? 0 : static_cast<uint8_t>(fn->locals.back().reg + 1);
+    }
+
+    uint32_t Compiler::constant(double number)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        auto [it, added] = fn->numbers.emplace(bits, static_cast<uint32_t>(fn->proto->constants.size()));
+        if (added)
+        {
+            fn->proto->constants.push_back(Value::fromNumber(number));
+        }
+        return it->second;
+    }
+
+    uint32_t Compiler::constant(std::string_view text)
+    {
+        auto it = fn->strings.find(text);
+        if (it != fn->strings.end())
+        {
+            return it->second;
+        }
+        program.strings.push_back(std::make_unique<String>(std::string(text)));
+        String* s = program.strings.back().get();
+        uint32_t index = static_cast<uint32_t>(fn->proto->constants.size());
+        fn->proto->constants.push_back(Value::fromObject(s));
+        fn->strings.emplace(s->value, index);
+        return index;
+    }
+
+    bool Compiler::numberOf(NodeId id, double& value) const
+    {
+        const parser::Node& node = ast[id];
+        if (node.kind == NodeKind::Unary && node.op == TokenType::OP_MINUS && ast[node.a].kind == NodeKind::Number)
+        {
+            if (!numberOf(node.a, value))
+            {
+                return false;
+            }
+            value = -value;
+            return true;
+        }
+        if (node.kind != NodeKind::Number)
+        {
+            return false;
+        }
+        lexer::Number n = lexer.numberOf(lexer.getStream()[node.token]);
+        if (n.kind == lexer::Number::Kind::BigInt || n.kind == lexer::Number::Kind::Rational)
+        {
+            return false;
+        }
+        value = n.kind == lexer::Number::Kind::Integer ? static_cast<double>(n.integer) : n.real;
+        return true;
+    }
+
+    Compiler::Local& Compiler::declare(NodeId id, std::string_view name, bool isConst)
+    {
+        for (auto it = fn->locals.rbegin(); it != fn->locals.rend() && it->depth == fn->depth; ++it)
+        {
+            if (!name.empty() && it->name == name)
+            {
+                error(id, "'" + std::string(name) + "' is already declared");
+            }
+        }
+        uint8_t reg = reserve();
+        fn->locals.push_back({ name, reg, fn->depth, isConst, false });
+        return fn->locals.back();
+    }
+
+    void Compiler::hoist(NodeId list)
+    {
+        uint8_t first = fn->freeReg;
+        for (NodeId s = list; s != parser::none; s = ast[s].next)
+        {
+            if (ast[s].kind != NodeKind::Declaration)
+            {
+                continue;
+            }
+            bool isConst = ast[s].op == TokenType::KEYWORD_CONST;
+            for (NodeId d = ast[s].a; d != parser::none; d = ast[d].next)
+            {
+                declare(d, nameOf(d), isConst);
+            }
+        }
+        // 声明之前读到的是 none；循环中的块每一轮都重新置为 none
+        if (fn->freeReg > first)
+        {
+            emit(encode(Opcode::LOADNONE, first, static_cast<uint8_t>(fn->freeReg - first)));
+        }
+    }
+
+    void Compiler::beginScope()
+    {
+        ++fn->depth;
+    }
+
+    void Compiler::endScope()
+    {
+        --fn->depth;
+        bool captured = false;
+        uint8_t first = fn->freeReg;
+        while (!fn->locals.empty() && fn->locals.back().depth > fn->depth)
+        {
+            captured |= fn->locals.back().captured;
+            first = fn->locals.back().reg;
+            fn->locals.pop_back();
+        }
+        if (captured)
+        {
+            emit(encode(Opcode::CLOSE, first));
+        }
+        fn->freeReg = first;
+    }
+
+    int Compiler::findLocal(Function& f, std::string_view name)
+    {
+        for (size_t i = f.locals.size(); i-- > 0;)
+        {
+            if (f.locals[i].name == name)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void Compiler::markCaptured(Function& f, Local& local)
+    {
+        local.captured = true;
+        for (Loop& loop : f.loops)
+        {
+            if (local.reg >= loop.base)
+            {
+                loop.captured = true;
+            }
+        }
+    }
+
+    int Compiler::findCapture(Function& f, std::string_view name)
+    {
+        for (size_t i = 0; i < f.captureNames.size(); ++i)
+        {
+            if (f.captureNames[i] == name)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        if (!f.enclosing)
+        {
+            return -1;
+        }
+
+        Proto::Capture capture;
+        bool isConst;
+        int local = findLocal(*f.enclosing, name);
+        if (local >= 0)
+        {
+            Local& l = f.enclosing->locals[local];
+            markCaptured(*f.enclosing, l);
+            capture = { true, l.reg };
+            isConst = l.isConst;
+        }
+        else
+        {
+            int outer = findCapture(*f.enclosing, name);
+            if (outer < 0)
+            {
+                return -1;
+            }
+            capture = { false, static_cast<uint8_t>(outer) };
+            isConst = f.enclosing->captureConst[outer];
+        }
+        if (f.captureNames.size() >= 255)
+        {
+            throw CompileError("CompileError: Function captures too many variables", line, 1);
+        }
+        f.proto->captures.push_back(capture);
+        f.captureNames.push_back(name);
+        f.captureConst.push_back(isConst);
+        return static_cast<int>(f.captureNames.size() - 1);
+    }
+
+    Compiler::Variable Compiler::resolve(NodeId id, std::string_view name)
+    {
+        int local = findLocal(*fn, name);
+        if (local >= 0)
+        {
+            return { Where::Local, fn->locals[local].reg, fn->locals[local].isConst };
+        }
+        int capture = findCapture(*fn, name);
+        if (capture >= 0)
+        {
+            return { Where::Capture, static_cast<uint32_t>(capture), fn->captureConst[capture] };
+        }
+        auto it = globals.find(name);
+        if (it != globals.end())
+        {
+            return { Where::Global, it->second, true };
+        }
+        error(id, "'" + std::string(name) + "' is not defined");
+    }
+
+    void Compiler::store(NodeId id, std::string_view name, uint8_t src)
+    {
+        Variable v = resolve(id, name);
+        if (v.isConst)
+        {
+            error(id, "Assignment to constant '" + std::string(name) + "'");
+        }
+        if (v.where == Where::Local)
+        {
+            if (v.index != src)
+            {
+                emit(encode(Opcode::MOVE, static_cast<uint8_t>(v.index), src));
+            }
+        }
+        else
+        {
+            emit(encode(Opcode::SETUPVAL, src, static_cast<uint8_t>(v.index)));
+        }
+    }
+
+    void Compiler::statements(NodeId list)
+    {
+        for (NodeId s = list; s != parser::none; s = ast[s].next)
+        {
+            statement(s);
+        }
+    }
+
+    void Compiler::statement(NodeId id)
+    {
+        const parser::Node& node = ast[id];
+        at(id);
+        switch (node.kind)
+        {
+        case NodeKind::ExpressionStatement:
+            effect(node.a);
+            break;
+        case NodeKind::Declaration:
+            declaration(id);
+            break;
+        case NodeKind::Block:
+            beginScope();
+            hoist(node.a);
+            statements(node.a);
+            endScope();
+            break;
+        case NodeKind::If:
+            ifStatement(id);
+            break;
+        case NodeKind::While:
+            whileStatement(id);
+            break;
+        case NodeKind::DoWhile:
+            doWhileStatement(id);
+            break;
+        case NodeKind::ForIn:
+        case NodeKind::ForOf:
+            forStatement(id);
+            break;
+        case NodeKind::Switch:
+            switchStatement(id);
+            break;
+        case NodeKind::Break:
+        case NodeKind::Continue:
+            jumpOut(id, node.kind == NodeKind::Break);
+            break;
+        case NodeKind::Return:
+            if (node.a == parser::none)
+            {
+                emit(encode(Opcode::RETURN, 0, 0));
+            }
+            else
+            {
+                uint8_t mark = fn->freeReg;
+                emit(encode(Opcode::RETURN, any(node.a), 1));
+                fn->freeReg = mark;
+            }
+            break;
+        case NodeKind::Throw:
+        {
+            uint8_t mark = fn->freeReg;
+            emit(encode(Opcode::THROW, any(node.a)));
+            fn->freeReg = mark;
+            break;
+        }
+        case NodeKind::Empty:
+            break;
+        case NodeKind::Class:
+            error(id, "Classes are not supported by the compiler yet");
+        case NodeKind::Import:
+        case NodeKind::Export:
+            error(id, "Modules are not supported by the compiler yet");
+        default:
+            error(id, std::string("Unexpected ") + parser::Ast::nameOf(node.kind));
+        }
+    }
+
+    void Compiler::declaration(NodeId id)
+    {
+        bool isConst = ast[id].op == TokenType::KEYWORD_CONST;
+        for (NodeId d = ast[id].a; d != parser::none; d = ast[d].next)
+        {
+            std::string_view name = nameOf(d);
+            // 块中的声明已经提前登记；if 等之后单独的声明在这里登记
+            int index = findLocal(*fn, name);
+            if (index < 0 || fn->locals[index].depth != fn->depth)
+            {
+                declare(d, name, isConst);
+                index = static_cast<int>(fn->locals.size() - 1);
+                emit(encode(Opcode::LOADNONE, fn->locals[index].reg, 1));
+            }
+            uint8_t reg = fn->locals[index].reg;
+            NodeId value = ast[d].a;
+            if (value == parser::none)
+            {
+                if (isConst)
+                {
+                    error(d, "Missing initializer in const declaration");
+                }
+                emit(encode(Opcode::LOADNONE, reg, 1));
+                continue;
+            }
+
+            at(d);
+            if (ast[value].kind == NodeKind::Arrow)
+            {
+                function(value, reg, name);
+            }
+            else if (writesEarly(ast[value]))
+            {
+                uint8_t mark = fn->freeReg;
+                uint8_t t = reserve();
+                into(value, t);
+                emit(encode(Opcode::MOVE, reg, t));
+                fn->freeReg = mark;
+            }
+            else
+            {
+                into(value, reg);
+            }
+        }
+    }
+
+    void Compiler::ifStatement(NodeId id)
+    {
+        const parser::Node& node = ast[id];
+        JumpList otherwise;
+        branch(node.a, false, otherwise);
+        beginScope();
+        statement(node.b);
+        endScope();
+        if (node.c == parser::none)
+        {
+            patchHere(otherwise);
+            return;
+        }
+        size_t end = emitJump(Opcode::JMP);
+        patchHere(otherwise);
+        beginScope();
+        statement(node.c);
+        endScope();
+        patch(end, here());
+    }
+
+    void Compiler::endIteration(Loop& loop)
+    {
+        patchHere(loop.continues);
+        if (loop.captured)
+        {
+            emit(encode(Opcode::CLOSE, loop.base));
+        }
+    }
+
+    void Compiler::endLoop()
+    {
+        // break 跳过了内层块的结尾，在这里关闭它们捕获的变量
+        Loop& loop = fn->loops.back();
+        patchHere(loop.breaks);
+        if (loop.captured && !loop.breaks.empty())
+        {
+            emit(encode(Opcode::CLOSE, loop.base));
+        }
+        fn->loops.pop_back();
+    }
+
+    void Compiler::whileStatement(NodeId id)
+    {
+        // 条件放在循环体之后，每一轮只有一次条件跳转
+        const parser::Node& node = ast[id];
+        size_t test = emitJump(Opcode::JMP);
+        size_t top = here();
+        fn->loops.push_back({ false, fn->freeReg, false, {}, {} });
+        beginScope();
+        statement(node.b);
+        endScope();
+        endIteration(fn->loops.back());
+        patch(test, here());
+        at(id);
+        JumpList again;
+        branch(node.a, true, again);
+        for (size_t at : again)
+        {
+            patch(at, top);
+        }
+        endLoop();
+    }
+
+    void Compiler::doWhileStatement(NodeId id)
+    {
+        const parser::Node& node = ast[id];
+        size_t top = here();
+        fn->loops.push_back({ false, fn->freeReg, false, {}, {} });
+        beginScope();
+        statement(node.a);
+        endScope();
+        endIteration(fn->loops.back());
+        at(id);
+        JumpList again;
+        branch(node.b, true, again);
+        for (size_t at : again)
+        {
+            patch(at, top);
+        }
+        endLoop();
+    }
+
+    void Compiler::forStatement(NodeId id)
+    {
+        const parser::Node& node = ast[id];
+        const parser::Node& iterable = ast[node.a];
+        std::string_view name = nameOf(id);
+        bool declares = node.op != TokenType::UNKNOWN;
+
+        // 隐藏变量：被遍历的值（或区间的起点）、位置（或终点），之后是本轮的值
+        beginScope();
+        uint8_t base = declare(id, {}, false).reg;
+        declare(id, {}, false);
+        bool range = node.kind == NodeKind::ForOf && iterable.kind == NodeKind::Binary
+            && (iterable.op == TokenType::OP_DOT_DOT || iterable.op == TokenType::OP_DOT_DOT_DOT);
+        // a..b 包含 b，a...b 不包含
+        uint8_t inclusive = range && iterable.op == TokenType::OP_DOT_DOT;
+        if (range)
+        {
+            into(iterable.a, base);
+            into(iterable.b, base + 1);
+        }
+        else
+        {
+            into(node.a, base);
+            emit(encodeBx(Opcode::LOADINT, base + 1, 0));
+        }
+        uint8_t value = declare(id, declares ? name : std::string_view{}, node.op == TokenType::KEYWORD_CONST).reg;
+
+        at(id);
+        size_t exit = 0;
+        size_t top = 0;
+        if (range)
+        {
+            exit = emitJump(Opcode::FORPREP, base, 0, inclusive);
+            top = here();
+        }
+        else
+        {
+            top = here();
+            exit = emitJump(Opcode::ITER, base, 0, node.kind == NodeKind::ForIn);
+        }
+
+        fn->loops.push_back({ false, value, false, {}, {} });
+        if (!declares)
+        {
+            store(id, name, value);
+        }
+        beginScope();
+        statement(node.b);
+        endScope();
+        endIteration(fn->loops.back());
+        at(id);
+        if (range)
+        {
+            emitLoop(Opcode::FORLOOP, base, inclusive, top);
+        }
+        else
+        {
+            emitLoop(Opcode::JMP, 0, 0, top);
+        }
+        patch(exit, here());
+        endLoop();
+        endScope();
+    }
+
+    void Compiler::switchStatement(NodeId id)
+    {
+        const parser::Node& node = ast[id];
+        beginScope();
+        uint8_t value = declare(id, {}, false).reg;
+        into(node.a, value);
+        for (NodeId c = node.b; c != parser::none; c = ast[c].next)
+        {
+            hoist(ast[c].b);
+        }
+
+        // 先依次比较各个 case，再按顺序排列各段语句，没有 break 时落到下一段
+        JumpList matches;
+        NodeId fallback = parser::none;
+        for (NodeId c = node.b; c != parser::none; c = ast[c].next)
+        {
+            if (ast[c].a == parser::none)
+            {
+                fallback = c;
+                matches.push_back(0);
+                continue;
+            }
+            at(c);
+            uint8_t mark = fn->freeReg;
+            double number;
+            if (numberOf(ast[c].a, number) && constant(number) <= 0xFF)
+            {
+                matches.push_back(emitJump(Opcode::JEQK, 1, value, static_cast<uint8_t>(constant(number))));
+            }
+            else
+            {
+                uint8_t test = any(ast[c].a);
+                matches.push_back(emitJump(Opcode::JEQ, 1, value, test));
+            }
+            fn->freeReg = mark;
+        }
+        size_t otherwise = emitJump(Opcode::JMP);
+
+        fn->loops.push_back({ true, value, false, {}, {} });
+        size_t i = 0;
+        for (NodeId c = node.b; c != parser::none; c = ast[c].next, ++i)
+        {
+            if (c == fallback)
+            {
+                patch(otherwise, here());
+            }
+            else
+            {
+                patch(matches[i], here());
+            }
+            statements(ast[c].b);
+        }
+        if (fallback == parser::none)
+        {
+            patch(otherwise, here());
+        }
+        endLoop();
+        endScope();
+    }
+
+    void Compiler::jumpOut(NodeId id, bool isBreak)
+    {
+        for (auto it = fn->loops.rbegin(); it != fn->loops.rend(); ++it)
+        {
+            if (isBreak || !it->isSwitch)
+            {
+                (isBreak ? it->breaks : it->continues).push_back(emitJump(Opcode::JMP));
+                return;
+            }
+        }
+        error(id, isBreak ? "'break' outside of a loop or switch" : "'continue' outside of a loop");
+    }
+
+    bool Compiler::writesEarly(const parser::Node& node)
+    {
+        switch (node.kind)
+        {
+        case NodeKind::Conditional:
+        case NodeKind::Object:
+        case NodeKind::Array:
+            return true;
+        case NodeKind::Binary:
+            return node.op == TokenType::OP_LOGIC_AND || node.op == TokenType::OP_LOGIC_OR;
+        default:
+            return false;
+        }
+    }
+
+    uint8_t Compiler::any(NodeId id)
+    {
+        const parser::Node& node = ast[id];
+        if (node.kind == NodeKind::Identifier)
+        {
+            int local = findLocal(*fn, nameOf(id));
+            if (local >= 0)
+            {
+                return fn->locals[local].reg;
+            }
+        }
+        uint8_t r = reserve();
+        into(id, r);
+        return r;
+    }
+
+    void Compiler::effect(NodeId id)
+    {
+        uint8_t mark = fn->freeReg;
+        const parser::Node& node = ast[id];
+        if (node.kind == NodeKind::Assign)
+        {
+            assignment(id, -1);
+        }
+        else if (node.kind == NodeKind::Identifier)
+        {
+            resolve(id, nameOf(id));
+        }
+        else
+        {
+            into(id, reserve());
+        }
+        fn->freeReg = mark;
+    }
+
+    void Compiler::into(NodeId id, uint8_t dst)
+    {
+        const parser::Node& node = ast[id];
+        uint8_t mark = fn->freeReg;
+        at(id);
+        nest(id);
+        switch (node.kind)
+        {
+        case NodeKind::Number:
+        case NodeKind::Unary:
+        {
+            double number;
+            if (numberOf(id, number))
+            {
+                if (number == std::trunc(number) && number >= INT16_MIN && number <= INT16_MAX && !(number == 0 && std::signbit(number)))
+                {
+                    emit(encodeBx(Opcode::LOADINT, dst, static_cast<uint16_t>(static_cast<int16_t>(number))));
+                }
+                else
+                {
+                    uint32_t k = constant(number);
+                    if (k > 0xFFFF)
+                    {
+                        error(id, "Too many constants in function");
+                    }
+                    emit(encodeBx(Opcode::LOADK, dst, static_cast<uint16_t>(k)));
+                }
+                break;
+            }
+            if (node.kind == NodeKind::Number)
+            {
+                error(id, "BigInt and rational literals are not supported by the compiler yet");
+            }
+            Opcode op = Opcode::NEG;
+            switch (node.op)
+            {
+            case TokenType::OP_MINUS: op = Opcode::NEG; break;
+            case TokenType::OP_ADD: op = Opcode::TONUMBER; break;
+            case TokenType::OP_LOGIC_NEGATE: op = Opcode::NOT; break;
+            default: op = Opcode::BNOT; break;
+            }
+            emit(encode(op, dst, any(node.a)));
+            break;
+        }
+        case NodeKind::String:
+        {
+            uint32_t k = constant(nameOf(id));
+            if (k > 0xFFFF)
+            {
+                error(id, "Too many constants in function");
+            }
+            emit(encodeBx(Opcode::LOADK, dst, static_cast<uint16_t>(k)));
+            break;
+        }
+        case NodeKind::Literal:
+            if (tokenType(id) == TokenType::KEYWORD_NONE)
+            {
+                emit(encode(Opcode::LOADNONE, dst, 1));
+            }
+            else
+            {
+                emit(encode(Opcode::LOADBOOL, dst, tokenType(id) == TokenType::KEYWORD_TRUE));
+            }
+            break;
+        case NodeKind::Identifier:
+        {
+            Variable v = resolve(id, nameOf(id));
+            if (v.where == Where::Local)
+            {
+                if (v.index != dst)
+                {
+                    emit(encode(Opcode::MOVE, dst, static_cast<uint8_t>(v.index)));
+                }
+            }
+            else if (v.where == Where::Capture)
+            {
+                emit(encode(Opcode::GETUPVAL, dst, static_cast<uint8_t>(v.index)));
+            }
+            else
+            {
+                emit(encodeBx(Opcode::GETGLOBAL, dst, static_cast<uint16_t>(v.index)));
+            }
+            break;
+        }
+        case NodeKind::Template:
+        {
+            // 各段依次放进连续的寄存器，一条指令算出总长度并拼接
+            unsigned count = 0;
+            for (NodeId p = node.a; p != parser::none; p = ast[p].next)
+            {
+                ++count;
+            }
+            if (count > 0xFF)
+            {
+                error(id, "Template string has too many parts");
+            }
+            uint8_t base = reserve(count);
+            uint8_t r = base;
+            for (NodeId p = node.a; p != parser::none; p = ast[p].next)
+            {
+                into(p, r++);
+            }
+            at(id);
+            emit(encode(Opcode::CONCAT, dst, base, static_cast<uint8_t>(count)));
+            break;
+        }
+        case NodeKind::Array:
+        {
+            // 每批最多 64 个元素先放进连续的寄存器，再一起放进数组
+            constexpr unsigned batch = 64;
+            bool created = false;
+            NodeId e = node.a;
+            do
+            {
+                uint8_t base = fn->freeReg;
+                unsigned count = 0;
+                for (; e != parser::none && count < batch; e = ast[e].next, ++count)
+                {
+                    if (ast[e].kind == NodeKind::Spread)
+                    {
+                        error(e, "Spread elements are not supported by the compiler yet");
+                    }
+                    into(e, reserve());
+                }
+                at(id);
+                emit(encode(created ? Opcode::APPEND : Opcode::NEWARRAY, dst, base, static_cast<uint8_t>(count)));
+                created = true;
+                fn->freeReg = mark;
+            } while (e != parser::none);
+            break;
+        }
+        case NodeKind::Object:
+            emit(encode(Opcode::NEWTABLE, dst));
+            for (NodeId p = node.a; p != parser::none; p = ast[p].next)
+            {
+                if (ast[p].kind == NodeKind::Spread)
+                {
+                    error(p, "Spread properties are not supported by the compiler yet");
+                }
+                std::string_view key = nameOf(p);
+                uint8_t value;
+                if (ast[p].a == parser::none)
+                {
+                    // { x } 即 { x: x }
+                    value = reserve();
+                    Variable v = resolve(p, key);
+                    if (v.where == Where::Local)
+                    {
+                        value = static_cast<uint8_t>(v.index);
+                    }
+                    else if (v.where == Where::Capture)
+                    {
+                        emit(encode(Opcode::GETUPVAL, value, static_cast<uint8_t>(v.index)));
+                    }
+                    else
+                    {
+                        emit(encodeBx(Opcode::GETGLOBAL, value, static_cast<uint16_t>(v.index)));
+                    }
+                }
+                else
+                {
+                    value = any(ast[p].a);
+                }
+                uint32_t k = constant(key);
+                at(p);
+                if (k <= 0xFF)
+                {
+                    emit(encode(Opcode::SETFIELD, dst, static_cast<uint8_t>(k), value));
+                }
+                else
+                {
+                    uint8_t r = reserve();
+                    emit(encodeBx(Opcode::LOADK, r, static_cast<uint16_t>(k)));
+                    emit(encode(Opcode::SETINDEX, dst, r, value));
+                }
+                fn->freeReg = mark;
+            }
+            break;
+        case NodeKind::Binary:
+            binary(id, dst);
+            break;
+        case NodeKind::Assign:
+            assignment(id, dst);
+            break;
+        case NodeKind::Conditional:
+        {
+            JumpList otherwise;
+            branch(node.a, false, otherwise);
+            into(node.b, dst);
+            size_t end = emitJump(Opcode::JMP);
+            patchHere(otherwise);
+            into(node.c, dst);
+            patch(end, here());
+            break;
+        }
+        case NodeKind::Call:
+            call(id, dst);
+            break;
+        case NodeKind::Member:
+        {
+            uint8_t object = any(node.a);
+            uint32_t k = constant(nameOf(id));
+            at(id);
+            if (k <= 0xFF)
+            {
+                emit(encode(Opcode::GETFIELD, dst, object, static_cast<uint8_t>(k)));
+            }
+            else
+            {
+                uint8_t r = reserve();
+                emit(encodeBx(Opcode::LOADK, r, static_cast<uint16_t>(k)));
+                emit(encode(Opcode::GETINDEX, dst, object, r));
+            }
+            break;
+        }
+        case NodeKind::Index:
+        {
+            uint8_t object = any(node.a);
+            uint8_t key = any(node.b);
+            at(id);
+            emit(encode(Opcode::GETINDEX, dst, object, key));
+            break;
+        }
+        case NodeKind::Arrow:
+            function(id, dst, {});
+            break;
+        case NodeKind::Yield:
+            error(id, "Generators are not supported by the compiler yet");
+        case NodeKind::Spread:
+            error(id, "Spread is only allowed in array literals and arguments");
+        default:
+            error(id, std::string("Unexpected ") + parser::Ast::nameOf(node.kind));
+        }
+        fn->freeReg = mark;
+        --depth;
+    }
+
+    void Compiler::binary(NodeId id, uint8_t dst)
+    {
+        const parser::Node& node = ast[id];
+        TokenType op = node.op;
+
+        if (op == TokenType::OP_LOGIC_AND || op == TokenType::OP_LOGIC_OR)
+        {
+            into(node.a, dst);
+            size_t end = emitJump(Opcode::TEST, dst, 0, op == TokenType::OP_LOGIC_OR);
+            into(node.b, dst);
+            patch(end, here());
+            return;
+        }
+        if (op == TokenType::OP_DOT_DOT || op == TokenType::OP_DOT_DOT_DOT)
+        {
+            error(id, "Ranges are only supported as the iterable of for-of");
+        }
+        if (isComparison(op) || op == TokenType::KEYWORD_IN)
+        {
+            uint8_t left = any(node.a);
+            uint8_t right = any(node.b);
+            at(id);
+            switch (op)
+            {
+            case TokenType::OP_EQUAL: emit(encode(Opcode::EQ, dst, left, right)); break;
+            case TokenType::OP_NOT_EQUAL: emit(encode(Opcode::NE, dst, left, right)); break;
+            case TokenType::OP_LESS_THAN: emit(encode(Opcode::LT, dst, left, right)); break;
+            case TokenType::OP_LESS_EQUAL: emit(encode(Opcode::LE, dst, left, right)); break;
+            case TokenType::OP_GREATER_THAN: emit(encode(Opcode::LT, dst, right, left)); break;
+            case TokenType::OP_GREATER_EQUAL: emit(encode(Opcode::LE, dst, right, left)); break;
+            default: emit(encode(Opcode::IN, dst, left, right)); break;
+            }
+            return;
+        }
+
+        // a + b + c + ... 是向左延伸的长链，沿左侧逐个计算，不做递归
+        std::vector<NodeId> chain{ id };
+        while (true)
+        {
+            const parser::Node& left = ast[ast[chain.back()].a];
+            if (left.kind != NodeKind::Binary || arithmeticOf(left.op) == Opcode::Count)
+            {
+                break;
+            }
+            chain.push_back(ast[chain.back()].a);
+        }
+        // 写入局部变量时先在临时寄存器中累加，右侧可能还要读它
+        uint8_t acc = dst >= localsTop() ? dst : reserve();
+        uint8_t mark = fn->freeReg;
+        uint8_t left = any(ast[chain.back()].a);
+        for (size_t i = chain.size(); i-- > 0;)
+        {
+            const parser::Node& n = ast[chain[i]];
+            Opcode arithmetic = arithmeticOf(n.op);
+            if (arithmetic == Opcode::Count)
+            {
+                error(chain[i], std::string("Unsupported operator '") + std::string(lexer::spellingOf(n.op)) + "'");
+            }
+            double number;
+            Opcode k = withConstant(arithmetic);
+            if (k != Opcode::Count && numberOf(n.b, number) && constant(number) <= 0xFF)
+            {
+                uint32_t c = constant(number);
+                at(chain[i]);
+                emit(encode(k, acc, left, static_cast<uint8_t>(c)));
+            }
+            else
+            {
+                uint8_t right = any(n.b);
+                at(chain[i]);
+                emit(encode(arithmetic, acc, left, right));
+            }
+            fn->freeReg = mark;
+            left = acc;
+        }
+        if (acc != dst)
+        {
+            emit(encode(Opcode::MOVE, dst, acc));
+        }
+    }
+
+    void Compiler::assignment(NodeId id, int dst)
+    {
+        const parser::Node& node = ast[id];
+        const parser::Node& target = ast[node.a];
+        Opcode arithmetic = node.op == TokenType::OP_ASSIGN ? Opcode::Count : arithmeticOf(node.op);
+        if (node.op != TokenType::OP_ASSIGN && arithmetic == Opcode::Count)
+        {
+            error(id, std::string("Unsupported operator '") + std::string(lexer::spellingOf(node.op)) + "'");
+        }
+
+        // 复合赋值：在 value 上就地运算，右侧为数字常量时用 K 形式
+        auto combine = [&](uint8_t value) {
+            double number;
+            Opcode k = withConstant(arithmetic);
+            if (k != Opcode::Count && numberOf(node.b, number) && constant(number) <= 0xFF)
+            {
+                uint32_t c = constant(number);
+                at(id);
+                emit(encode(k, value, value, static_cast<uint8_t>(c)));
+            }
+            else
+            {
+                uint8_t mark = fn->freeReg;
+                uint8_t right = any(node.b);
+                at(id);
+                emit(encode(arithmetic, value, value, right));
+                fn->freeReg = mark;
+            }
+        };
+
+        uint8_t result;
+        if (target.kind == NodeKind::Identifier)
+        {
+            std::string_view name = nameOf(node.a);
+            Variable v = resolve(node.a, name);
+            if (v.where == Where::Global)
+            {
+                error(node.a, "Cannot assign to built-in '" + std::string(name) + "'");
+            }
+            if (v.isConst)
+            {
+                error(node.a, "Assignment to constant '" + std::string(name) + "'");
+            }
+            if (v.where == Where::Local)
+            {
+                uint8_t reg = static_cast<uint8_t>(v.index);
+                if (arithmetic != Opcode::Count)
+                {
+                    combine(reg);
+                }
+                else if (ast[node.b].kind == NodeKind::Arrow)
+                {
+                    function(node.b, reg, name);
+                }
+                else if (writesEarly(ast[node.b]))
+                {
+                    uint8_t t = reserve();
+                    into(node.b, t);
+                    emit(encode(Opcode::MOVE, reg, t));
+                }
+                else
+                {
+                    into(node.b, reg);
+                }
+                result = reg;
+            }
+            else
+            {
+                result = dst >= 0 ? static_cast<uint8_t>(dst) : reserve();
+                if (arithmetic != Opcode::Count)
+                {
+                    emit(encode(Opcode::GETUPVAL, result, static_cast<uint8_t>(v.index)));
+                    combine(result);
+                }
+                else
+                {
+                    into(node.b, result);
+                }
+                at(id);
+                emit(encode(Opcode::SETUPVAL, result, static_cast<uint8_t>(v.index)));
+            }
+        }
+        else
+        {
+            uint8_t object = any(target.a);
+            uint8_t key;
+            bool field = target.kind == NodeKind::Member;
+            uint32_t k = field ? constant(nameOf(node.a)) : 0;
+            if (field && k <= 0xFF)
+            {
+                key = static_cast<uint8_t>(k);
+            }
+            else if (field)
+            {
+                key = reserve();
+                emit(encodeBx(Opcode::LOADK, key, static_cast<uint16_t>(k)));
+                field = false;
+            }
+            else
+            {
+                key = any(target.b);
+            }
+
+            if (arithmetic != Opcode::Count)
+            {
+                result = reserve();
+                emit(encode(field ? Opcode::GETFIELD : Opcode::GETINDEX, result, object, key));
+                combine(result);
+            }
+            else
+            {
+                result = any(node.b);
+            }
+            at(id);
+            emit(encode(field ? Opcode::SETFIELD : Opcode::SETINDEX, object, key, result));
+        }
+
+        if (dst >= 0 && result != dst)
+        {
+            emit(encode(Opcode::MOVE, static_cast<uint8_t>(dst), result));
+        }
+    }
+
+    void Compiler::call(NodeId id, uint8_t dst)
+    {
+        const parser::Node& node = ast[id];
+        // 被调用的值和实参放在连续的寄存器中；dst 是最上面的临时寄存器时直接用它
+        uint8_t base = dst + 1 == fn->freeReg && dst >= localsTop() ? dst : reserve();
+        into(node.a, base);
+        unsigned count = 0;
+        for (NodeId arg = node.b; arg != parser::none; arg = ast[arg].next, ++count)
+        {
+            if (ast[arg].kind == NodeKind::Spread)
+            {
+                error(arg, "Spread arguments are not supported by the compiler yet");
+            }
+            if (count == 0xFF)
+            {
+                error(arg, "Too many arguments");
+            }
+            into(arg, reserve());
+        }
+        at(id);
+        emit(encode(Opcode::CALL, base, static_cast<uint8_t>(count)));
+        if (base != dst)
+        {
+            emit(encode(Opcode::MOVE, dst, base));
+        }
+    }
+
+    void Compiler::function(NodeId id, uint8_t dst, std::string_view name)
+    {
+        const parser::Node& node = ast[id];
+        auto proto = std::make_unique<Proto>();
+        proto->name = name.empty() ? "<anonymous>" : std::string(name);
+
+        Function f(fn, proto.get());
+        fn = &f;
+        beginScope();
+        for (NodeId p = node.a; p != parser::none; p = ast[p].next)
+        {
+            declare(p, nameOf(p), false);
+            if (ast[p].op == TokenType::OP_DOT_DOT_DOT)
+            {
+                proto->rest = true;
+            }
+            else
+            {
+                ++proto->params;
+            }
+        }
+        // 没有传入或传入 none 的参数取默认值
+        for (NodeId p = node.a; p != parser::none; p = ast[p].next)
+        {
+            if (ast[p].a != parser::none)
+            {
+                at(p);
+                uint8_t reg = fn->locals[findLocal(*fn, nameOf(p))].reg;
+                size_t skip = emitJump(Opcode::TESTNONE, reg, 0, 0);
+                into(ast[p].a, reg);
+                patch(skip, here());
+            }
+        }
+
+        if (ast[node.b].kind == NodeKind::Block)
+        {
+            hoist(ast[node.b].a);
+            statements(ast[node.b].a);
+            emit(encode(Opcode::RETURN, 0, 0));
+        }
+        else
+        {
+            uint8_t r = any(node.b);
+            emit(encode(Opcode::RETURN, r, 1));
+        }
+        fn = f.enclosing;
+
+        std::vector<std::unique_ptr<Proto>>& protos = fn->proto->protos;
+        if (protos.size() > 0xFFFF)
+        {
+            error(id, "Too many functions");
+        }
+        protos.push_back(std::move(proto));
+        at(id);
+        emit(encodeBx(Opcode::CLOSURE, dst, static_cast<uint16_t>(protos.size() - 1)));
+    }
+
+    void Compiler::branch(NodeId id, bool when, JumpList& out)
+    {
+        const parser::Node& node = ast[id];
+        uint8_t mark = fn->freeReg;
+        at(id);
+        nest(id);
+        struct Leave
+        {
+            unsigned& depth;
+            ~Leave() { --depth; }
+        } leave{ depth };
+
+        if (node.kind == NodeKind::Unary && node.op == TokenType::OP_LOGIC_NEGATE)
+        {
+            branch(node.a, !when, out);
+            return;
+        }
+        if (node.kind == NodeKind::Literal && tokenType(id) != TokenType::KEYWORD_NONE)
+        {
+            if ((tokenType(id) == TokenType::KEYWORD_TRUE) == when)
+            {
+                out.push_back(emitJump(Opcode::JMP));
+            }
+            return;
+        }
+        if (node.kind == NodeKind::Binary && (node.op == TokenType::OP_LOGIC_AND || node.op == TokenType::OP_LOGIC_OR))
+        {
+            // a && b 为假：a 为假或 b 为假；为真：a 为真且 b 为真，|| 与之对称
+            bool conjunction = node.op == TokenType::OP_LOGIC_AND;
+            if (when != conjunction)
+            {
+                branch(node.a, when, out);
+                branch(node.b, when, out);
+            }
+            else
+            {
+                JumpList skip;
+                branch(node.a, !when, skip);
+                branch(node.b, when, out);
+                patchHere(skip);
+            }
+            return;
+        }
+        if (node.kind == NodeKind::Binary && isComparison(node.op))
+        {
+            TokenType op = node.op;
+            NodeId left = node.a;
+            NodeId right = node.b;
+            double number;
+            bool constantLeft = numberOf(left, number) && !numberOf(right, number);
+            if (constantLeft)
+            {
+                std::swap(left, right);
+                op = mirrored(op);
+            }
+            // != 是 == 取反
+            uint8_t flag = op == TokenType::OP_NOT_EQUAL ? !when : when;
+
+            if (numberOf(right, number) && constant(number) <= 0xFF)
+            {
+                uint8_t k = static_cast<uint8_t>(constant(number));
+                uint8_t r = any(left);
+                Opcode jump = Opcode::JEQK;
+                switch (op)
+                {
+                case TokenType::OP_LESS_THAN: jump = Opcode::JLTK; break;
+                case TokenType::OP_LESS_EQUAL: jump = Opcode::JLEK; break;
+                case TokenType::OP_GREATER_THAN: jump = Opcode::JGTK; break;
+                case TokenType::OP_GREATER_EQUAL: jump = Opcode::JGEK; break;
+                default: break;
+                }
+                at(id);
+                out.push_back(emitJump(jump, flag, r, k));
+            }
+            else
+            {
+                uint8_t a = any(left);
+                uint8_t b = any(right);
+                at(id);
+                switch (op)
+                {
+                case TokenType::OP_LESS_THAN: out.push_back(emitJump(Opcode::JLT, flag, a, b)); break;
+                case TokenType::OP_GREATER_THAN: out.push_back(emitJump(Opcode::JLT, flag, b, a)); break;
+                case TokenType::OP_LESS_EQUAL: out.push_back(emitJump(Opcode::JLE, flag, a, b)); break;
+                case TokenType::OP_GREATER_EQUAL: out.push_back(emitJump(Opcode::JLE, flag, b, a)); break;
+                default: out.push_back(emitJump(Opcode::JEQ, flag, a, b)); break;
+                }
+            }
+            fn->freeReg = mark;
+            return;
+        }
+
+        uint8_t r = any(id);
+        out.push_back(emitJump(Opcode::TEST, r, 0, when));
+        fn->freeReg = mark;
+    }
+}
+}
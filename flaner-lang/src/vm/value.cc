@@ -0,0 +1,111 @@
+#include <value.hh>
+#include <bytecode.hh>
+#include <fmt/format.h>
+#include <cmath>
+#include <iterator>
+
+namespace flaner
+{
+namespace vm
+{
+    bool equals(const Value& a, const Value& b)
+    {
+        if (a.type != b.type)
+        {
+            return false;
+        }
+        switch (a.type)
+        {
+        case Type::None:
+            return true;
+        case Type::Bool:
+            return a.boolean == b.boolean;
+        case Type::Number:
+            return a.number == b.number;
+        case Type::String:
+            return a.object == b.object
+                || static_cast<String*>(a.object)->value == static_cast<String*>(b.object)->value;
+        default:
+            return a.object == b.object;
+        }
+    }
+
+    const char* typeName(Type type)
+    {
+        static const char* const names[] = {
+            "none", "bool", "number", "string", "array", "table", "function", "function", "upvalue",
+        };
+        return names[static_cast<size_t>(type)];
+    }
+
+    void appendTo(std::string& out, const Value& v)
+    {
+        switch (v.type)
+        {
+        case Type::None:
+            out += "none";
+            break;
+        case Type::Bool:
+            out += v.boolean ? "true" : "false";
+            break;
+        case Type::Number:
+            // 整数值不带小数点；其余用能够原样读回的最短写法
+            if (std::abs(v.number) < 1e15 && v.number == std::trunc(v.number))
+            {
+                out += fmt::format_int(static_cast<long long>(v.number)).c_str();
+            }
+            else
+            {
+                fmt::format_to(std::back_inserter(out), "{}", v.number);
+            }
+            break;
+        case Type::String:
+            out += static_cast<String*>(v.object)->value;
+            break;
+        case Type::Array:
+        {
+            const auto& items = static_cast<Array*>(v.object)->items;
+            out += '[';
+            for (size_t i = 0; i < items.size(); ++i)
+            {
+                out += i ? ", " : "";
+                // 数组中的数组只写出长度，避免自身引用时无限展开
+                if (items[i].type == Type::Array)
+                {
+                    fmt::format_to(std::back_inserter(out), "[array({})]", static_cast<Array*>(items[i].object)->items.size());
+                }
+                else
+                {
+                    appendTo(out, items[i]);
+                }
+            }
+            out += ']';
+            break;
+        }
+        case Type::Table:
+            fmt::format_to(std::back_inserter(out), "[table({})]", static_cast<Table*>(v.object)->entries.size());
+            break;
+        case Type::Function:
+            out += "[function ";
+            out += static_cast<Closure*>(v.object)->proto->name;
+            out += ']';
+            break;
+        case Type::Native:
+            out += "[native ";
+            out += static_cast<Native*>(v.object)->name;
+            out += ']';
+            break;
+        default:
+            out += "[upvalue]";
+            break;
+        }
+    }
+
+    std::string toString(const Value& v)
+    {
+        std::string out;
+        appendTo(out, v);
+        return out;
+    }
+}
+}
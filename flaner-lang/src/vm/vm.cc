@@ -0,0 +1,1015 @@
+#include <vm.hh>
+#include <stats.hh>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// GCC 和 Clang 支持取标签地址，每条指令的末尾直接跳到下一条指令的处理代码，
+// 间接跳转分散在各处，比集中在一个 switch 上更容易预测
+#if defined(__GNUC__) && !defined(FLANER_VM_SWITCH)
+#define FLANER_VM_THREADED 1
+#else
+#define FLANER_VM_THREADED 0
+#endif
+
+namespace flaner
+{
+namespace vm
+{
+    namespace
+    {
+        // 位运算把 double 截断成 64 位整数，超出范围和 NaN 时为 0
+        inline int64_t toInteger(double d)
+        {
+            return d >= -9223372036854775808.0 && d < 9223372036854775808.0 ? static_cast<int64_t>(d) : 0;
+        }
+
+        inline double shiftLeft(double x, double y)
+        {
+            return static_cast<double>(static_cast<int64_t>(static_cast<uint64_t>(toInteger(x)) << (toInteger(y) & 63)));
+        }
+
+        inline double shiftRight(double x, double y)
+        {
+            return static_cast<double>(toInteger(x) >> (toInteger(y) & 63));
+        }
+
+        // 两侧都是 2^53 以内的整数时用整数取余，fmod 要慢得多
+        inline bool bothIntegers(double x, double y)
+        {
+            constexpr double limit = 9007199254740992.0;
+            return x > -limit && x < limit && y > -limit && y < limit && y != 0
+                && x == static_cast<double>(static_cast<int64_t>(x)) && y == static_cast<double>(static_cast<int64_t>(y));
+        }
+
+        // % 的结果与被除数同号
+        inline double modulo(double x, double y)
+        {
+            if (bothIntegers(x, y))
+            {
+                int64_t r = static_cast<int64_t>(x) % static_cast<int64_t>(y);
+                // 保留 -0 % y 等为 -0 的情形
+                return r == 0 && x < 0 ? -0.0 : static_cast<double>(r);
+            }
+            return std::fmod(x, y);
+        }
+
+        // %% 的结果与除数同号
+        inline double quote(double x, double y)
+        {
+            double r = modulo(x, y);
+            return r != 0 && (r < 0) != (y < 0) ? r + y : r;
+        }
+
+        inline double power(double x, double y)
+        {
+            return y == 2 ? x * x : std::pow(x, y);
+        }
+
+        const char* symbolOf(Opcode op)
+        {
+            static const char* const symbols[] = {
+                "+", "-", "*", "/", "//", "%", "%%", "**", "<<", ">>", "&", "|", "^",
+            };
+            return op >= Opcode::ADD && op <= Opcode::BXOR ? symbols[static_cast<int>(op) - static_cast<int>(Opcode::ADD)] : nameOf(op);
+        }
+
+        Value print(VM&, Value* args, size_t count)
+        {
+            std::string out;
+            for (size_t i = 0; i < count; ++i)
+            {
+                out += i ? " " : "";
+                appendTo(out, args[i]);
+            }
+            out += '\n';
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            return Value();
+        }
+
+        Value len(VM& vm, Value* args, size_t count)
+        {
+            if (count > 0)
+            {
+                switch (args[0].type)
+                {
+                case Type::String:
+                    return Value::fromNumber(static_cast<double>(static_cast<String*>(args[0].object)->value.size()));
+                case Type::Array:
+                    return Value::fromNumber(static_cast<double>(static_cast<Array*>(args[0].object)->items.size()));
+                case Type::Table:
+                    return Value::fromNumber(static_cast<double>(static_cast<Table*>(args[0].object)->entries.size()));
+                default:
+                    break;
+                }
+            }
+            vm.error(std::string("len() expects a string, array or table, got ") + (count ? typeName(args[0].type) : "nothing"));
+        }
+
+        Value str(VM& vm, Value* args, size_t count)
+        {
+            return Value::fromObject(vm.newString(count ? toString(args[0]) : std::string()));
+        }
+
+        Value clock(VM&, Value*, size_t)
+        {
+            static const auto start = std::chrono::steady_clock::now();
+            return Value::fromNumber(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        Value push(VM& vm, Value* args, size_t count)
+        {
+            if (count == 0 || args[0].type != Type::Array)
+            {
+                vm.error(std::string("push() expects an array, got ") + (count ? typeName(args[0].type) : "nothing"));
+            }
+            auto& items = static_cast<Array*>(args[0].object)->items;
+            items.insert(items.end(), args + 1, args + count);
+            return Value::fromNumber(static_cast<double>(items.size()));
+        }
+    }
+
+    VM::VM()
+        : stack(new Value[stackSize]), openUpvalues(nullptr),
+        objects(nullptr), allocated(0), threshold(initialThreshold)
+    {
+        frames.reserve(maxFrames);
+        define("print", print);
+        define("len", len);
+        define("str", str);
+        define("clock", clock);
+        define("push", push);
+    }
+
+    VM::~VM()
+    {
+        while (objects)
+        {
+            Object* next = objects->next;
+            delete objects;
+            objects = next;
+        }
+    }
+
+    void VM::define(const char* name, NativeFunction function)
+    {
+        names.emplace_back(name);
+        globals.push_back(Value::fromObject(allocate<Native>(0, name, function)));
+    }
+
+    String* VM::newString(std::string value)
+    {
+        size_t extra = value.capacity();
+        return allocate<String>(extra, std::move(value));
+    }
+
+    Array* VM::newArray()
+    {
+        return allocate<Array>(0);
+    }
+
+    void VM::error(const std::string& info) const
+    {
+        size_t line = 0;
+        if (!frames.empty())
+        {
+            const Frame& frame = frames.back();
+            const Proto& proto = *frame.closure->proto;
+            size_t at = static_cast<size_t>(frame.pc - proto.code.data());
+            line = at > 0 && at <= proto.lines.size() ? proto.lines[at - 1] : 0;
+        }
+        throw RuntimeError("RuntimeError: " + info, line);
+    }
+
+    Value VM::run(const Program& program)
+    {
+        FLANER_STATS(lexer::stats::PhaseTimer timer(lexer::stats::Phase::Run);)
+        frames.clear();
+        openUpvalues = nullptr;
+        collectIfNeeded();
+
+        // 顶层代码的函数放在 stack[0]，和被调用的函数一样，base[-1] 是函数本身
+        const Proto* main = program.main.get();
+        Closure* closure = allocate<Closure>(0, main);
+        stack[0] = Value::fromObject(closure);
+        Value* base = stack.get() + 1;
+        std::fill(base, base + main->registers, Value());
+        frames.push_back({ closure, main->code.data(), base });
+        return execute();
+    }
+
+    Upvalue* VM::capture(Value* slot)
+    {
+        Upvalue** link = &openUpvalues;
+        while (*link && (*link)->location > slot)
+        {
+            link = &(*link)->nextOpen;
+        }
+        if (*link && (*link)->location == slot)
+        {
+            return *link;
+        }
+        Upvalue* upvalue = allocate<Upvalue>(0, slot);
+        upvalue->nextOpen = *link;
+        *link = upvalue;
+        return upvalue;
+    }
+
+    void VM::close(Value* level)
+    {
+        while (openUpvalues && openUpvalues->location >= level)
+        {
+            Upvalue* upvalue = openUpvalues;
+            upvalue->closed = *upvalue->location;
+            upvalue->location = &upvalue->closed;
+            openUpvalues = upvalue->nextOpen;
+            upvalue->nextOpen = nullptr;
+        }
+    }
+
+    size_t VM::sizeOf(const Object* object)
+    {
+        switch (object->type)
+        {
+        case Type::String:
+            return sizeof(String) + static_cast<const String*>(object)->value.capacity();
+        case Type::Array:
+            return sizeof(Array) + static_cast<const Array*>(object)->items.capacity() * sizeof(Value);
+        case Type::Table:
+            return sizeof(Table) + static_cast<const Table*>(object)->entries.capacity() * (sizeof(std::pair<String*, Value>) + 32);
+        case Type::Function:
+            return sizeof(Closure) + static_cast<const Closure*>(object)->upvalues.capacity() * sizeof(Upvalue*);
+        case Type::Native:
+            return sizeof(Native);
+        default:
+            return sizeof(Upvalue);
+        }
+    }
+
+    void VM::mark(Object* object)
+    {
+        if (object && !object->marked)
+        {
+            object->marked = true;
+            gray.push_back(object);
+        }
+    }
+
+    void VM::collect()
+    {
+        for (const Value& v : globals)
+        {
+            mark(v);
+        }
+        if (!frames.empty())
+        {
+            const Frame& top = frames.back();
+            for (Value* v = stack.get(); v < top.base + top.closure->proto->registers; ++v)
+            {
+                mark(*v);
+            }
+        }
+        for (const Frame& frame : frames)
+        {
+            mark(frame.closure);
+        }
+        for (Upvalue* u = openUpvalues; u; u = u->nextOpen)
+        {
+            mark(u);
+        }
+
+        while (!gray.empty())
+        {
+            Object* object = gray.back();
+            gray.pop_back();
+            switch (object->type)
+            {
+            case Type::Array:
+                for (const Value& v : static_cast<Array*>(object)->items)
+                {
+                    mark(v);
+                }
+                break;
+            case Type::Table:
+                for (const auto& [key, value] : static_cast<Table*>(object)->entries)
+                {
+                    mark(key);
+                    mark(value);
+                }
+                break;
+            case Type::Function:
+                for (Upvalue* u : static_cast<Closure*>(object)->upvalues)
+                {
+                    mark(u);
+                }
+                break;
+            case Type::Upvalue:
+                mark(static_cast<Upvalue*>(object)->closed);
+                break;
+            default:
+                break;
+            }
+        }
+
+        // 常量表中的字符串不在链表中，标记后一直保持，不影响回收
+        size_t live = 0;
+        Object** link = &objects;
+        while (*link)
+        {
+            Object* object = *link;
+            if (object->marked)
+            {
+                object->marked = false;
+                live += sizeOf(object);
+                link = &object->next;
+            }
+            else
+            {
+                *link = object->next;
+                delete object;
+            }
+        }
+        allocated = live;
+        threshold = std::max(initialThreshold, live * 2);
+    }
+
+    bool VM::less(const Value& b, const Value& c, bool orEqual) const
+    {
+        if (b.isNumber() && c.isNumber())
+        {
+            return orEqual ? b.number <= c.number : b.number < c.number;
+        }
+        if (b.isString() && c.isString())
+        {
+            int order = static_cast<String*>(b.object)->value.compare(static_cast<String*>(c.object)->value);
+            return orEqual ? order <= 0 : order < 0;
+        }
+        error(std::string("Cannot compare ") + typeName(b.type) + " and " + typeName(c.type));
+    }
+
+    void VM::arithmetic(Opcode op, Value& dst, const Value& b, const Value& c)
+    {
+        if (op == Opcode::ADD && (b.isString() || c.isString()))
+        {
+            std::string text;
+            appendTo(text, b);
+            appendTo(text, c);
+            collectIfNeeded();
+            dst = Value::fromObject(newString(std::move(text)));
+            return;
+        }
+        error(std::string("Cannot apply '") + symbolOf(op) + "' to " + typeName(b.type) + " and " + typeName(c.type));
+    }
+
+    Value VM::execute()
+    {
+        Frame* frame = &frames.back();
+        const Instruction* pc = frame->pc;
+        Value* base = frame->base;
+        const Value* k = frame->closure->proto->constants.data();
+        Instruction i;
+
+        // 可能报错或回收之前写回 pc，报错时据此找到行号
+#define VM_SAVE() (frame->pc = pc)
+#define VM_ERROR(info) do { VM_SAVE(); error(info); } while (false)
+#define RA base[argA(i)]
+#define RB base[argB(i)]
+#define RC base[argC(i)]
+#define KB k[argB(i)]
+#define KC k[argC(i)]
+
+#if FLANER_VM_THREADED
+        static void* const labels[] = {
+#define FLANER_OPCODE_LABEL(name) &&op_##name,
+            FLANER_OPCODES(FLANER_OPCODE_LABEL)
+#undef FLANER_OPCODE_LABEL
+        };
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() do { i = *pc++; goto *labels[i & 0xFF]; } while (false)
+        VM_NEXT();
+#else
+#define VM_CASE(name) case Opcode::name:
+#define VM_NEXT() continue
+        for (;;)
+        {
+        i = *pc++;
+        switch (opcodeOf(i))
+        {
+#endif
+
+// 跳转偏移紧跟在指令之后
+#define VM_JUMP(condition) \
+        if (condition) \
+        { \
+            pc += 1 + static_cast<int32_t>(*pc); \
+        } \
+        else \
+        { \
+            ++pc; \
+        } \
+        VM_NEXT();
+
+// 两个操作数都是数字时就地计算，否则交给 arithmetic()
+#define VM_ARITHMETIC(name, expr) \
+        VM_CASE(name) \
+        { \
+            const Value& vb = RB; \
+            const Value& vc = RC; \
+            if (vb.isNumber() && vc.isNumber()) \
+            { \
+                double x = vb.number, y = vc.number; \
+                RA = Value::fromNumber(expr); \
+            } \
+            else \
+            { \
+                VM_SAVE(); \
+                arithmetic(Opcode::name, RA, vb, vc); \
+            } \
+            VM_NEXT(); \
+        }
+
+// 右操作数是常量表中的数字
+#define VM_ARITHMETIC_K(name, op, expr) \
+        VM_CASE(name) \
+        { \
+            const Value& vb = RB; \
+            if (vb.isNumber()) \
+            { \
+                double x = vb.number, y = KC.number; \
+                RA = Value::fromNumber(expr); \
+            } \
+            else \
+            { \
+                VM_SAVE(); \
+                arithmetic(Opcode::op, RA, vb, KC); \
+            } \
+            VM_NEXT(); \
+        }
+
+        VM_CASE(MOVE)
+        {
+            RA = RB;
+            VM_NEXT();
+        }
+        VM_CASE(LOADK)
+        {
+            RA = k[argBx(i)];
+            VM_NEXT();
+        }
+        VM_CASE(LOADINT)
+        {
+            RA = Value::fromNumber(argSBx(i));
+            VM_NEXT();
+        }
+        VM_CASE(LOADBOOL)
+        {
+            RA = Value::fromBool(argB(i) != 0);
+            VM_NEXT();
+        }
+        VM_CASE(LOADNONE)
+        {
+            std::fill(&RA, &RA + argB(i), Value());
+            VM_NEXT();
+        }
+        VM_CASE(GETUPVAL)
+        {
+            RA = *frame->closure->upvalues[argB(i)]->location;
+            VM_NEXT();
+        }
+        VM_CASE(SETUPVAL)
+        {
+            *frame->closure->upvalues[argB(i)]->location = RA;
+            VM_NEXT();
+        }
+        VM_CASE(GETGLOBAL)
+        {
+            RA = globals[argBx(i)];
+            VM_NEXT();
+        }
+        VM_CASE(NEWARRAY)
+        {
+            VM_SAVE();
+            collectIfNeeded();
+            Array* array = newArray();
+            array->items.assign(&RB, &RB + argC(i));
+            RA = Value::fromObject(array);
+            VM_NEXT();
+        }
+        VM_CASE(APPEND)
+        {
+            auto& items = static_cast<Array*>(RA.object)->items;
+            items.insert(items.end(), &RB, &RB + argC(i));
+            VM_NEXT();
+        }
+        VM_CASE(NEWTABLE)
+        {
+            VM_SAVE();
+            collectIfNeeded();
+            RA = Value::fromObject(allocate<Table>(0));
+            VM_NEXT();
+        }
+        VM_CASE(GETFIELD)
+        {
+            const Value& object = RB;
+            const std::string& key = static_cast<String*>(KC.object)->value;
+            if (object.type == Type::Table)
+            {
+                Value* v = static_cast<Table*>(object.object)->find(key);
+                RA = v ? *v : Value();
+            }
+            else if (object.type == Type::Array && key == "length")
+            {
+                RA = Value::fromNumber(static_cast<double>(static_cast<Array*>(object.object)->items.size()));
+            }
+            else if (object.type == Type::String && key == "length")
+            {
+                RA = Value::fromNumber(static_cast<double>(static_cast<String*>(object.object)->value.size()));
+            }
+            else
+            {
+                VM_ERROR("Cannot read field '" + key + "' of " + typeName(object.type));
+            }
+            VM_NEXT();
+        }
+        VM_CASE(SETFIELD)
+        {
+            if (RA.type != Type::Table)
+            {
+                VM_ERROR("Cannot set field '" + static_cast<String*>(KB.object)->value + "' of " + typeName(RA.type));
+            }
+            static_cast<Table*>(RA.object)->set(static_cast<String*>(KB.object), RC);
+            VM_NEXT();
+        }
+        VM_CASE(GETINDEX)
+        {
+            const Value& object = RB;
+            const Value& key = RC;
+            if (object.type == Type::Array && key.isNumber())
+            {
+                const auto& items = static_cast<Array*>(object.object)->items;
+                double index = key.number;
+                RA = index >= 0 && index < static_cast<double>(items.size()) ? items[static_cast<size_t>(index)] : Value();
+            }
+            else if (object.type == Type::Table && key.isString())
+            {
+                Value* v = static_cast<Table*>(object.object)->find(static_cast<String*>(key.object)->value);
+                RA = v ? *v : Value();
+            }
+            else if (object.type == Type::String && key.isNumber())
+            {
+                const std::string& text = static_cast<String*>(object.object)->value;
+                double index = key.number;
+                if (index >= 0 && index < static_cast<double>(text.size()))
+                {
+                    VM_SAVE();
+                    collectIfNeeded();
+                    RA = Value::fromObject(newString(std::string(1, text[static_cast<size_t>(index)])));
+                }
+                else
+                {
+                    RA = Value();
+                }
+            }
+            else
+            {
+                VM_ERROR(std::string("Cannot index ") + typeName(object.type) + " with " + typeName(key.type));
+            }
+            VM_NEXT();
+        }
+        VM_CASE(SETINDEX)
+        {
+            const Value& key = RB;
+            if (RA.type == Type::Array && key.isNumber())
+            {
+                // 下标等于长度时追加
+                auto& items = static_cast<Array*>(RA.object)->items;
+                double index = key.number;
+                if (index >= 0 && index < static_cast<double>(items.size()) && index == std::trunc(index))
+                {
+                    items[static_cast<size_t>(index)] = RC;
+                }
+                else if (index == static_cast<double>(items.size()))
+                {
+                    items.push_back(RC);
+                }
+                else
+                {
+                    VM_ERROR("Array index out of range");
+                }
+            }
+            else if (RA.type == Type::Table && key.isString())
+            {
+                static_cast<Table*>(RA.object)->set(static_cast<String*>(key.object), RC);
+            }
+            else
+            {
+                VM_ERROR(std::string("Cannot index ") + typeName(RA.type) + " with " + typeName(key.type));
+            }
+            VM_NEXT();
+        }
+
+        VM_ARITHMETIC(ADD, x + y)
+        VM_ARITHMETIC(SUB, x - y)
+        VM_ARITHMETIC(MUL, x * y)
+        VM_ARITHMETIC(DIV, x / y)
+        VM_ARITHMETIC(INTDIV, std::floor(x / y))
+        VM_ARITHMETIC(MOD, modulo(x, y))
+        VM_ARITHMETIC(QUOTE, quote(x, y))
+        VM_ARITHMETIC(POW, power(x, y))
+        VM_ARITHMETIC(SHL, shiftLeft(x, y))
+        VM_ARITHMETIC(SHR, shiftRight(x, y))
+        VM_ARITHMETIC(BAND, static_cast<double>(toInteger(x) & toInteger(y)))
+        VM_ARITHMETIC(BOR, static_cast<double>(toInteger(x) | toInteger(y)))
+        VM_ARITHMETIC(BXOR, static_cast<double>(toInteger(x) ^ toInteger(y)))
+        VM_ARITHMETIC_K(ADDK, ADD, x + y)
+        VM_ARITHMETIC_K(SUBK, SUB, x - y)
+        VM_ARITHMETIC_K(MULK, MUL, x * y)
+        VM_ARITHMETIC_K(DIVK, DIV, x / y)
+        VM_ARITHMETIC_K(INTDIVK, INTDIV, std::floor(x / y))
+        VM_ARITHMETIC_K(MODK, MOD, modulo(x, y))
+        VM_ARITHMETIC_K(QUOTEK, QUOTE, quote(x, y))
+        VM_ARITHMETIC_K(POWK, POW, power(x, y))
+        VM_ARITHMETIC_K(SHLK, SHL, shiftLeft(x, y))
+        VM_ARITHMETIC_K(SHRK, SHR, shiftRight(x, y))
+
+        VM_CASE(NEG)
+        {
+            if (!RB.isNumber())
+            {
+                VM_ERROR(std::string("Cannot negate ") + typeName(RB.type));
+            }
+            RA = Value::fromNumber(-RB.number);
+            VM_NEXT();
+        }
+        VM_CASE(NOT)
+        {
+            RA = Value::fromBool(!truthy(RB));
+            VM_NEXT();
+        }
+        VM_CASE(BNOT)
+        {
+            if (!RB.isNumber())
+            {
+                VM_ERROR(std::string("Cannot apply '~' to ") + typeName(RB.type));
+            }
+            RA = Value::fromNumber(static_cast<double>(~toInteger(RB.number)));
+            VM_NEXT();
+        }
+        VM_CASE(TONUMBER)
+        {
+            // 字符串整个是数字时取它的值，否则为 NaN
+            const Value& v = RB;
+            if (v.isNumber())
+            {
+                RA = v;
+            }
+            else if (v.type == Type::Bool)
+            {
+                RA = Value::fromNumber(v.boolean ? 1 : 0);
+            }
+            else if (v.isString())
+            {
+                const std::string& text = static_cast<String*>(v.object)->value;
+                char* end = nullptr;
+                double n = std::strtod(text.c_str(), &end);
+                RA = Value::fromNumber(!text.empty() && end == text.c_str() + text.size() ? n : std::nan(""));
+            }
+            else
+            {
+                VM_ERROR(std::string("Cannot convert ") + typeName(v.type) + " to number");
+            }
+            VM_NEXT();
+        }
+        VM_CASE(EQ)
+        {
+            RA = Value::fromBool(equals(RB, RC));
+            VM_NEXT();
+        }
+        VM_CASE(NE)
+        {
+            RA = Value::fromBool(!equals(RB, RC));
+            VM_NEXT();
+        }
+        VM_CASE(LT)
+        {
+            VM_SAVE();
+            RA = Value::fromBool(less(RB, RC, false));
+            VM_NEXT();
+        }
+        VM_CASE(LE)
+        {
+            VM_SAVE();
+            RA = Value::fromBool(less(RB, RC, true));
+            VM_NEXT();
+        }
+        VM_CASE(IN)
+        {
+            // 表中是否有这个键，数组中是否有这个元素，字符串中是否有这个子串
+            const Value& item = RB;
+            const Value& where = RC;
+            bool found = false;
+            if (where.type == Type::Table && item.isString())
+            {
+                found = static_cast<Table*>(where.object)->find(static_cast<String*>(item.object)->value) != nullptr;
+            }
+            else if (where.type == Type::Array)
+            {
+                const auto& items = static_cast<Array*>(where.object)->items;
+                found = std::any_of(items.begin(), items.end(), [&](const Value& v) { return equals(v, item); });
+            }
+            else if (where.isString() && item.isString())
+            {
+                found = static_cast<String*>(where.object)->value.find(static_cast<String*>(item.object)->value) != std::string::npos;
+            }
+            else
+            {
+                VM_ERROR(std::string("Cannot apply 'in' to ") + typeName(item.type) + " and " + typeName(where.type));
+            }
+            RA = Value::fromBool(found);
+            VM_NEXT();
+        }
+        VM_CASE(CONCAT)
+        {
+            std::string text;
+            for (Value* v = &RB; v < &RB + argC(i); ++v)
+            {
+                appendTo(text, *v);
+            }
+            VM_SAVE();
+            collectIfNeeded();
+            RA = Value::fromObject(newString(std::move(text)));
+            VM_NEXT();
+        }
+
+        VM_CASE(JMP)
+        {
+            VM_JUMP(true)
+        }
+        VM_CASE(TEST)
+        {
+            VM_JUMP(truthy(RA) == (argC(i) != 0))
+        }
+        VM_CASE(TESTNONE)
+        {
+            VM_JUMP(RA.isNone() == (argC(i) != 0))
+        }
+        VM_CASE(JEQ)
+        {
+            const Value& vb = RB;
+            const Value& vc = RC;
+            bool result = vb.isNumber() && vc.isNumber() ? vb.number == vc.number : equals(vb, vc);
+            VM_JUMP(result == (argA(i) != 0))
+        }
+        VM_CASE(JLT)
+        {
+            const Value& vb = RB;
+            const Value& vc = RC;
+            bool result;
+            if (vb.isNumber() && vc.isNumber())
+            {
+                result = vb.number < vc.number;
+            }
+            else
+            {
+                VM_SAVE();
+                result = less(vb, vc, false);
+            }
+            VM_JUMP(result == (argA(i) != 0))
+        }
+        VM_CASE(JLE)
+        {
+            const Value& vb = RB;
+            const Value& vc = RC;
+            bool result;
+            if (vb.isNumber() && vc.isNumber())
+            {
+                result = vb.number <= vc.number;
+            }
+            else
+            {
+                VM_SAVE();
+                result = less(vb, vc, true);
+            }
+            VM_JUMP(result == (argA(i) != 0))
+        }
+        VM_CASE(JEQK)
+        {
+            const Value& vb = RB;
+            VM_JUMP((vb.isNumber() && vb.number == KC.number) == (argA(i) != 0))
+        }
+
+// 与常量比较，左侧不是数字时报错
+#define VM_COMPARE_K(name, op) \
+        VM_CASE(name) \
+        { \
+            const Value& vb = RB; \
+            if (!vb.isNumber()) \
+            { \
+                VM_SAVE(); \
+                less(vb, KC, false); \
+            } \
+            VM_JUMP((vb.number op KC.number) == (argA(i) != 0)) \
+        }
+
+        VM_COMPARE_K(JLTK, <)
+        VM_COMPARE_K(JLEK, <=)
+        VM_COMPARE_K(JGTK, >)
+        VM_COMPARE_K(JGEK, >=)
+
+        VM_CASE(FORPREP)
+        {
+            Value* r = &RA;
+            if (!r[0].isNumber() || !r[1].isNumber())
+            {
+                VM_ERROR(std::string("Range bounds must be numbers, got ") + typeName(r[0].type) + " and " + typeName(r[1].type));
+            }
+            bool empty = argC(i) ? r[0].number > r[1].number : r[0].number >= r[1].number;
+            if (!empty)
+            {
+                r[2] = r[0];
+            }
+            VM_JUMP(empty)
+        }
+        VM_CASE(FORLOOP)
+        {
+            Value* r = &RA;
+            double next = r[0].number + 1;
+            bool more = argC(i) ? next <= r[1].number : next < r[1].number;
+            if (more)
+            {
+                r[0].number = next;
+                r[2] = r[0];
+            }
+            VM_JUMP(more)
+        }
+        VM_CASE(ITER)
+        {
+            Value* r = &RA;
+            size_t index = static_cast<size_t>(r[1].number);
+            bool keys = argC(i) != 0;
+            bool done = false;
+            switch (r[0].type)
+            {
+            case Type::Array:
+            {
+                const auto& items = static_cast<Array*>(r[0].object)->items;
+                done = index >= items.size();
+                if (!done)
+                {
+                    r[2] = keys ? r[1] : items[index];
+                }
+                break;
+            }
+            case Type::Table:
+            {
+                const auto& entries = static_cast<Table*>(r[0].object)->entries;
+                done = index >= entries.size();
+                if (!done)
+                {
+                    r[2] = keys ? Value::fromObject(entries[index].first) : entries[index].second;
+                }
+                break;
+            }
+            case Type::String:
+            {
+                const std::string& text = static_cast<String*>(r[0].object)->value;
+                done = index >= text.size();
+                if (!done && keys)
+                {
+                    r[2] = r[1];
+                }
+                else if (!done)
+                {
+                    VM_SAVE();
+                    collectIfNeeded();
+                    r[2] = Value::fromObject(newString(std::string(1, text[index])));
+                }
+                break;
+            }
+            default:
+                VM_ERROR(std::string("Cannot iterate over ") + typeName(r[0].type));
+            }
+            if (!done)
+            {
+                r[1].number += 1;
+            }
+            VM_JUMP(done)
+        }
+
+        VM_CASE(CLOSURE)
+        {
+            VM_SAVE();
+            collectIfNeeded();
+            const Proto* proto = frame->closure->proto->protos[argBx(i)].get();
+            Closure* closure = allocate<Closure>(proto->captures.size() * sizeof(Upvalue*), proto);
+            closure->upvalues.reserve(proto->captures.size());
+            for (const Proto::Capture& c : proto->captures)
+            {
+                closure->upvalues.push_back(c.local ? capture(base + c.index) : frame->closure->upvalues[c.index]);
+            }
+            RA = Value::fromObject(closure);
+            VM_NEXT();
+        }
+        VM_CASE(CLOSE)
+        {
+            close(&RA);
+            VM_NEXT();
+        }
+        VM_CASE(CALL)
+        {
+            Value* callee = &RA;
+            Value* args = callee + 1;
+            uint32_t count = argB(i);
+            VM_SAVE();
+            if (callee->type == Type::Function)
+            {
+                Closure* closure = static_cast<Closure*>(callee->object);
+                const Proto* proto = closure->proto;
+                if (frames.size() >= maxFrames || args + proto->registers > stack.get() + stackSize)
+                {
+                    error("Stack overflow");
+                }
+
+                // 缺少的参数为 none，多出的参数放进剩余参数的数组或丢弃
+                uint32_t filled = std::min<uint32_t>(count, proto->params);
+                uint32_t first = proto->params;
+                if (proto->rest)
+                {
+                    collectIfNeeded();
+                    Array* rest = newArray();
+                    if (count > proto->params)
+                    {
+                        rest->items.assign(args + proto->params, args + count);
+                    }
+                    args[proto->params] = Value::fromObject(rest);
+                    first += 1;
+                }
+                std::fill(args + filled, args + proto->params, Value());
+                if (first < proto->registers)
+                {
+                    std::fill(args + first, args + proto->registers, Value());
+                }
+
+                frames.push_back({ closure, proto->code.data(), args });
+                frame = &frames.back();
+                pc = frame->pc;
+                base = args;
+                k = proto->constants.data();
+            }
+            else if (callee->type == Type::Native)
+            {
+                collectIfNeeded();
+                *callee = static_cast<Native*>(callee->object)->function(*this, args, count);
+            }
+            else
+            {
+                error(std::string("Cannot call ") + typeName(callee->type));
+            }
+            VM_NEXT();
+        }
+        VM_CASE(RETURN)
+        {
+            Value result = argB(i) ? RA : Value();
+            close(base);
+            frames.pop_back();
+            if (frames.empty())
+            {
+                return result;
+            }
+            base[-1] = result;
+            frame = &frames.back();
+            pc = frame->pc;
+            base = frame->base;
+            k = frame->closure->proto->constants.data();
+            VM_NEXT();
+        }
+        VM_CASE(THROW)
+        {
+            VM_ERROR(toString(RA));
+        }
+
+#if !FLANER_VM_THREADED
+        default:
+            VM_ERROR("Invalid instruction");
+        }
+        }
+#endif
+
+#undef VM_COMPARE_K
+#undef VM_ARITHMETIC_K
+#undef VM_ARITHMETIC
+#undef VM_JUMP
+#undef VM_NEXT
+#undef VM_CASE
+#undef KC
+#undef KB
+#undef RC
+#undef RB
+#undef RA
+#undef VM_ERROR
+#undef VM_SAVE
+    }
+}
+}